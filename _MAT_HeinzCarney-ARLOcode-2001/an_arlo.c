@@ -1,14 +1,108 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "mex.h"
+#include "filters.h" /*/ DEC_MAXFACTOR */
 
 extern void _main();
 /*********************/
 extern int matan2_nonlinear_human(double tdres,double cf, double spont,int model,
 		                   const double *in, double *out, int length);
+extern int an_arlo(double tdres, double cf, double spont, int model, int species, int ifspike,
+		   const double *in, double *out, int length);
+extern int an_arlo_taps(double tdres, double cf, double spont, int model, int species, int ifspike,
+		   const double *in, double *sout, double *bmout, double *tauout, double *ihcout,
+		   double *ppiout, int length);
+extern int an_arlo_sens(double tdres, double cf, double spont, int model, int species, int ifspike,
+		   const double *in, const double *din, int nder, double *out, double *dout, int length);
+extern int an_arlo_decim(double tdres, double cf, double spont, int model, int species, int ifspike,
+		   int decim, int ifdecout, const double *in, double *out, int length);
 extern int matan2_new(double tdres, double cf, double spont, int model, int species,
 				   const double *in, double *out, int length);
+extern void clearAuditoryNerveCache(void);
+typedef struct __ANStream TANStream;
+extern TANStream* an_arlo_create(double tdres, double cf, double spont, int model, int species, int ifspike);
+extern void an_arlo_process(TANStream *h, const double *in, double *out, int length);
+extern void an_arlo_reset(TANStream *h);
+extern void an_arlo_destroy(TANStream *h);
+
+/*********************/
+/* Streaming handles, h = index+1; they live until destroyed or the mex file is cleared,
+   as do the fibers of the cache (initAuditoryNerveCached) */
+#define MAXSTREAMS 1024
+static TANStream *streams[MAXSTREAMS];
+static int ifatexit = 0;
+
+static void destroyStreams(void)
+{
+      int i;
+      for(i=0; i<MAXSTREAMS; i++)
+        if(streams[i]!=NULL) { an_arlo_destroy(streams[i]); streams[i] = NULL; };
+      clearAuditoryNerveCache();
+}
+
+static TANStream* getStream(const mxArray *a)
+{
+      int h;
+      if(mxGetM(a)*mxGetN(a)<1) mexErrMsgTxt("Invalid handle.");
+      h = (int)(mxGetScalar(a));
+      if((h<1)||(h>MAXSTREAMS)||(streams[h-1]==NULL)) mexErrMsgTxt("Invalid handle.");
+return(streams[h-1]);
+}
+
+/*
+ * h = an_arlo('create',[tdres,cf,spont,model,species,ifspike]);
+ * sout = an_arlo('process',h,input);   consecutive chunks of the stimulus
+ * an_arlo('reset',h);                  start a new stimulus
+ * an_arlo('destroy',h);
+ * an_arlo('clearcache');               free the cached fibers
+ */
+static void mexStream(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+      char cmd[16];
+      double *para;
+      int i;
+      TANStream *h;
+
+      mxGetString(prhs[0],cmd,sizeof(cmd));
+      if(strcmp(cmd,"create")==0)
+      {
+        if((nrhs!=2)||(mxGetM(prhs[1])*mxGetN(prhs[1])<6))
+          mexErrMsgTxt("h = an_arlo('create',[tdres,cf,spont,model,species,ifspike]);");
+        para = mxGetPr(prhs[1]);
+        if((mxGetM(prhs[1])*mxGetN(prhs[1])>=7)&&(para[6]>1))
+          mexErrMsgTxt("The streaming handle runs at full rate (decim = 1).");
+        for(i=0; (i<MAXSTREAMS)&&(streams[i]!=NULL); i++);
+        if(i==MAXSTREAMS) mexErrMsgTxt("Too many handles.");
+        streams[i] = an_arlo_create(para[0],para[1],para[2],(int)(para[3]),(int)(para[4]),(int)(para[5]));
+        if(streams[i]==NULL) mexErrMsgTxt("Out of memory.");
+        plhs[0] = mxCreateDoubleScalar(i+1);
+      }
+      else if(strcmp(cmd,"process")==0)
+      {
+        if(nrhs!=3) mexErrMsgTxt("sout = an_arlo('process',h,input);");
+        h = getStream(prhs[1]);
+        plhs[0] = mxCreateDoubleMatrix(mxGetM(prhs[2]),mxGetN(prhs[2]), mxREAL);
+        an_arlo_process(h,mxGetPr(prhs[2]),mxGetPr(plhs[0]),mxGetM(prhs[2])*mxGetN(prhs[2]));
+      }
+      else if(strcmp(cmd,"reset")==0)
+      {
+        if(nrhs!=2) mexErrMsgTxt("an_arlo('reset',h);");
+        an_arlo_reset(getStream(prhs[1]));
+      }
+      else if(strcmp(cmd,"destroy")==0)
+      {
+        if(nrhs!=2) mexErrMsgTxt("an_arlo('destroy',h);");
+        h = getStream(prhs[1]);
+        streams[(int)(mxGetScalar(prhs[1]))-1] = NULL;
+        an_arlo_destroy(h);
+      }
+      else if(strcmp(cmd,"clearcache")==0)
+        clearAuditoryNerveCache();
+      else
+        mexErrMsgTxt("The command is one of 'create', 'process', 'reset', 'destroy' or 'clearcache'.");
+}
 
 /* The gateway routine */
 void mexFunction( int nlhs, mxArray *plhs[],
@@ -16,22 +110,35 @@ void mexFunction( int nlhs, mxArray *plhs[],
 {
       int error;
       double *para,*in,*out;
+      double *taps[4];
+      double *din,*dout;
+      int     nder;
       double tdres,cf,spont;
       int model;
       int species;
       int ifspike;
+      int decim,ifdecout;
       double  x;
       int     length,mrows,ncols;
+      int     i;
       /*  Check for proper number of arguments. */
       /* NOTE: You do not need an else statement when using
            mexErrMsgTxt within an if statement. It will never
            get to the else statement if mexErrMsgTxt is executed.
            (mexErrMsgTxt breaks you out of the MEX-file.) 
        */
-      if(nrhs!=2) 
-        mexErrMsgTxt("sout = an_arlo([tdres,cf,spont,model, species,ifspike],input);");
-      if(nlhs!=1) 
-        mexErrMsgTxt("One output required.");
+      if(!ifatexit) { mexAtExit(destroyStreams); ifatexit = 1; };
+      if((nrhs>0)&&mxIsChar(prhs[0]))
+      {
+        mexStream(nlhs,plhs,nrhs,prhs);
+        return;
+      };
+      if((nrhs!=2)&&(nrhs!=3)) 
+        mexErrMsgTxt("[sout(,bm,tau,ihc,ppi)] = an_arlo([tdres,cf,spont,model, species,ifspike(,decim,ifdecout)],input);\n[sout,dsout] = an_arlo(para,input,dinput);");
+      if((nlhs<1)||(nlhs>5)) 
+        mexErrMsgTxt("One to five outputs: [sout,bm,tau,ihc,ppi].");
+      if((nrhs==3)&&(nlhs>2))
+        mexErrMsgTxt("With dinput, the outputs are [sout,dsout].");
 
       /*  Get the input parameter. */
       if((mxGetM(prhs[0])*mxGetN(prhs[0]))<6)
@@ -43,6 +150,16 @@ void mexFunction( int nlhs, mxArray *plhs[],
       model = (int)(para[3]);
       species = (int)(para[4]);
       ifspike = (int)(para[5]);
+      /* multirate : IHC-PPI and synapse at tdres*decim, sout at that rate if ifdecout */
+      decim = 1; ifdecout = 0;
+      if((mxGetM(prhs[0])*mxGetN(prhs[0]))>=7) decim = (int)(para[6]);
+      if((mxGetM(prhs[0])*mxGetN(prhs[0]))>=8) ifdecout = (int)(para[7]);
+      if(decim<1) decim = 1;
+      if(decim>DEC_MAXFACTOR)
+        mexErrMsgTxt("The decimation factor decim can be 32 (DEC_MAXFACTOR) at most.");
+      if(decim==1) ifdecout = 0;
+      if((decim>1)&&((nlhs>1)||(nrhs==3)))
+        mexErrMsgTxt("bm, tau, ihc, ppi and dsout are only returned at full rate (decim = 1).");
       
       /*  Create a pointer to the input matrix in. */
       in = mxGetPr(prhs[1]);
@@ -50,15 +167,63 @@ void mexFunction( int nlhs, mxArray *plhs[],
       /*  Get the dimensions of the matrix input in. */
       mrows = mxGetM(prhs[1]);
       ncols = mxGetN(prhs[1]);
+      length = mrows*ncols;
       /*  Set the output pointer to the output matrix. */
-      plhs[0] = mxCreateDoubleMatrix(mrows,ncols, mxREAL);
+      if(!ifdecout)
+        plhs[0] = mxCreateDoubleMatrix(mrows,ncols, mxREAL);
+      else if(mrows==1)
+        plhs[0] = mxCreateDoubleMatrix(1,(length+decim-1)/decim, mxREAL);
+      else
+        plhs[0] = mxCreateDoubleMatrix((length+decim-1)/decim,1, mxREAL);
 
       /*  Create a C pointer to a copy of the output matrix. */
       out = mxGetPr(plhs[0]);
-      length = mrows*ncols;
+
+      /*  Sensitivity: dinput is length x nder (the derivatives of input with respect to
+          nder stimulus parameters), or [] for the input scale (dinput = input) */
+      if(nrhs==3)
+      {
+        if(mxGetM(prhs[2])*mxGetN(prhs[2])==0)
+        {
+          din = in;
+          nder = 1;
+        }
+        else
+        {
+          if((length<1)||(((int)(mxGetM(prhs[2])*mxGetN(prhs[2])))%length!=0))
+            mexErrMsgTxt("dinput must be length(input) x (number of parameters).");
+          din = mxGetPr(prhs[2]);
+          nder = (mxGetM(prhs[2])*mxGetN(prhs[2]))/length;
+        };
+        if(mxGetM(prhs[2])*mxGetN(prhs[2])==0)
+          plhs[1] = mxCreateDoubleMatrix(mrows,ncols, mxREAL);
+        else
+          plhs[1] = mxCreateDoubleMatrix(length,nder, mxREAL);
+        dout = mxGetPr(plhs[1]);
+        error = an_arlo_sens(tdres,cf,spont,model,species,ifspike,in,din,nder,out,dout,length);
+        if(nlhs<2) mxDestroyArray(plhs[1]);
+        if(error) mexErrMsgTxt("Error in calling the function.");
+        return;
+      };
+
+      /*  The intermediate signals, same shape as sout, from the same pass */
+      for(i=0; i<4; i++)
+      {
+        taps[i] = NULL;
+        if(i+1<nlhs)
+        {
+          plhs[i+1] = mxCreateDoubleMatrix(mrows,ncols, mxREAL);
+          taps[i] = mxGetPr(plhs[i+1]);
+        };
+      };
 
       /*  Call the C subroutine. */
-      error = an_arlo(tdres,cf,spont,model,species,ifspike,in,out,length);
+      if(decim>1)
+        error = an_arlo_decim(tdres,cf,spont,model,species,ifspike,decim,ifdecout,in,out,length);
+      else if(nlhs>1)
+        error = an_arlo_taps(tdres,cf,spont,model,species,ifspike,in,out,taps[0],taps[1],taps[2],taps[3],length);
+      else
+        error = an_arlo(tdres,cf,spont,model,species,ifspike,in,out,length);
       if(error) mexErrMsgTxt("Error in calling the function.");
 }
 
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "mex.h"
+#include "anbatch.h"
+
+extern void _main();
+/*********************/
+#define NJOBCOL 6
+
+/* progress on the MATLAB command window, called from the MATLAB thread only */
+static void showprogress(void *arg, int done, int njobs)
+{
+  mexPrintf("an_arlo_batch: %d of %d jobs\n",done,njobs);
+  mexEvalString("drawnow;");
+}
+
+/* The gateway routine */
+void mexFunction( int nlhs, mxArray *plhs[],
+                  int nrhs, const mxArray *prhs[])
+{
+      int error;
+      double *para,*table,*rate,*sout,*grid;
+      const double *vec[NJOBCOL];
+      int nvec[NJOBCOL];
+      static const double dflt[NJOBCOL] = {0,0,0,0,1,0}; /*/ empty stim or level: 1 and 0 dB */
+      TANBatch b;
+      TANJob *jobs;
+      int nthreads,ifprogress;
+      int npara,njobs,j,k;
+      /*  The fibers of the cache live until the mex file is cleared */
+      mexAtExit(clearAuditoryNerveCache);
+      /*  Check for proper number of arguments. */
+      if(nrhs!=3)
+        mexErrMsgTxt("[rate,sout,jobs] = an_arlo_batch([tdres,ifspike(,nthreads,ifprogress)],jobs,stimuli);");
+      if(nlhs>3)
+        mexErrMsgTxt("At most three outputs.");
+
+      /*  Get the input parameter. */
+      npara = mxGetM(prhs[0])*mxGetN(prhs[0]);
+      if(npara<2)
+	mexErrMsgTxt("The first input para contains [tdres,ifspike(,nthreads,ifprogress)]");
+      para = mxGetPr(prhs[0]);
+      b.tdres = para[0];
+      b.ifspike = (int)(para[1]);
+      nthreads = (npara>2) ? (int)(para[2]) : 0;
+      ifprogress = (npara>3) ? (int)(para[3]) : 0;
+
+      /*  Stimuli, one per column (pascals) */
+      b.stim = mxGetPr(prhs[2]);
+      b.length = mxGetM(prhs[2]);
+      b.nstim = mxGetN(prhs[2]);
+      if(b.length==1) { b.length = b.nstim; b.nstim = 1; };
+
+      /*  Jobs: a table with the columns [cf,spont,model,species,stim,level] (stim 1..nstim),
+	  or a cell {cf,spont,model,species,stim,level} of vectors for the cross product */
+      if(mxIsCell(prhs[1]))
+      {
+	if(mxGetNumberOfElements(prhs[1])!=NJOBCOL)
+	  mexErrMsgTxt("The cell of jobs contains {cf,spont,model,species,stim,level}");
+	for(k=0; k<NJOBCOL; k++)
+	{
+	  const mxArray *v = mxGetCell(prhs[1],k);
+	  if((v==NULL)||(mxGetNumberOfElements(v)==0))
+	  {
+	    if(k<4) mexErrMsgTxt("cf, spont, model and species cannot be empty");
+	    vec[k] = dflt+k; nvec[k] = 1;
+	  }
+	  else { vec[k] = mxGetPr(v); nvec[k] = mxGetNumberOfElements(v); };
+	};
+	njobs = anbatch_grid(vec[0],nvec[0],vec[1],nvec[1],vec[2],nvec[2],vec[3],nvec[3],
+			     vec[4],nvec[4],vec[5],nvec[5],NULL);
+	jobs = (TANJob*)mxCalloc((njobs>0) ? njobs : 1,sizeof(TANJob));
+	anbatch_grid(vec[0],nvec[0],vec[1],nvec[1],vec[2],nvec[2],vec[3],nvec[3],
+		     vec[4],nvec[4],vec[5],nvec[5],jobs);
+	for(j=0; j<njobs; j++) jobs[j].stim -= 1;
+      }
+      else
+      {
+	if(mxGetN(prhs[1])!=NJOBCOL)
+	  mexErrMsgTxt("The table of jobs has the columns [cf,spont,model,species,stim,level]");
+	njobs = mxGetM(prhs[1]);
+	table = mxGetPr(prhs[1]);
+	jobs = (TANJob*)mxCalloc((njobs>0) ? njobs : 1,sizeof(TANJob));
+	for(j=0; j<njobs; j++)
+	{
+	  jobs[j].cf = table[j];
+	  jobs[j].spont = table[j+njobs];
+	  jobs[j].model = (int)(table[j+2*njobs]);
+	  jobs[j].species = (int)(table[j+3*njobs]);
+	  jobs[j].stim = (int)(table[j+4*njobs])-1;
+	  jobs[j].level = table[j+5*njobs];
+	};
+      };
+      b.jobs = jobs;
+      b.njobs = njobs;
+
+      /*  Output slabs: mean rate njobs x 1, sout length x njobs */
+      plhs[0] = mxCreateDoubleMatrix(njobs,1, mxREAL);
+      rate = mxGetPr(plhs[0]);
+      b.rate = rate;
+      if(nlhs>1)
+      {
+	plhs[1] = mxCreateDoubleMatrix(b.length,njobs, mxREAL);
+	sout = mxGetPr(plhs[1]);
+	b.sout = sout;
+      }
+      else b.sout = NULL;
+
+      /*  Call the C subroutine. */
+      error = anbatch_run(&b,nthreads,ifprogress ? showprogress : NULL,NULL);
+      if(error==-2) mexErrMsgTxt("Invalid job: model 1..5, species 0, 1 or 9, cf>0, stim 1..number of stimuli.");
+      if(error) mexErrMsgTxt("Out of memory.");
+
+      /*  The jobs that were run, as a table */
+      if(nlhs>2)
+      {
+	plhs[2] = mxCreateDoubleMatrix(njobs,NJOBCOL, mxREAL);
+	grid = mxGetPr(plhs[2]);
+	for(j=0; j<njobs; j++)
+	{
+	  grid[j] = jobs[j].cf;
+	  grid[j+njobs] = jobs[j].spont;
+	  grid[j+2*njobs] = jobs[j].model;
+	  grid[j+3*njobs] = jobs[j].species;
+	  grid[j+4*njobs] = jobs[j].stim+1;
+	  grid[j+5*njobs] = jobs[j].level;
+	};
+      };
+      mxFree(jobs);
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "mex.h"
+
+extern void _main();
+/*********************/
+extern int an_arlo_pop(double tdres, double spont, int model, int species, int ifspike,
+		       const double *cf, int nfibers, const double *in, double *out, int length);
+extern int an_arlo_popF(double tdres, double spont, int model, int species, int ifspike,
+			const double *cf, int nfibers, const double *in, double *out, int length);
+extern int cochlea_cflist(int species, double cf, double cflo, double cfhi, double delx,
+			  int nfibers, double *cflist);
+
+/* The gateway routine */
+void mexFunction( int nlhs, mxArray *plhs[],
+                  int nrhs, const mxArray *prhs[])
+{
+      int error;
+      double *para,*in,*out,*cf;
+      mxArray *cfarray;
+      double tdres,spont;
+      int model;
+      int species;
+      int ifspike;
+      int ifsingle;
+      int nfibers;
+      int length;
+      /*  Check for proper number of arguments. */
+      if(nrhs!=3) 
+        mexErrMsgTxt("[sout,cf] = an_arlo_pop([tdres,spont,model,species,ifspike(,fibers,cf,cflo,cfhi,delx,ifsingle)],cf,input);");
+      if(nlhs>2) 
+        mexErrMsgTxt("At most two outputs.");
+
+      /*  Get the input parameter. */
+      if((mxGetM(prhs[0])*mxGetN(prhs[0]))<5)
+	mexErrMsgTxt("The first input para contains [tdres,spont,model,species,ifspike]");
+      para = mxGetPr(prhs[0]);
+      tdres = para[0];
+      spont = para[1];
+      model = (int)(para[2]);
+      species = (int)(para[3]);
+      ifspike = (int)(para[4]);
+      ifsingle = ((mxGetM(prhs[0])*mxGetN(prhs[0]))>10) ? (int)(para[10]) : 0;
+
+      /*  The CFs are either given, or spaced along the basilar membrane as in runmodel */
+      nfibers = mxGetM(prhs[1])*mxGetN(prhs[1]);
+      if(nfibers>0)
+      {
+	cfarray = mxCreateDoubleMatrix(nfibers,1, mxREAL);
+	cf = mxGetPr(cfarray);
+	memcpy(cf,mxGetPr(prhs[1]),sizeof(double)*nfibers);
+      }
+      else
+      {
+	if((mxGetM(prhs[0])*mxGetN(prhs[0]))<10)
+	  mexErrMsgTxt("With empty cf, the first input para contains [tdres,spont,model,species,ifspike,fibers,cf,cflo,cfhi,delx]");
+	nfibers = (int)(para[5]);
+	if(nfibers<1) mexErrMsgTxt("fibers should be at least 1");
+	cfarray = mxCreateDoubleMatrix(nfibers,1, mxREAL);
+	cf = mxGetPr(cfarray);
+	cochlea_cflist(species,para[6],para[7],para[8],para[9],nfibers,cf);
+      };
+
+      /*  Create a pointer to the input matrix in. */
+      in = mxGetPr(prhs[2]);
+      length = mxGetM(prhs[2])*mxGetN(prhs[2]);
+
+      /*  Output is CF x time */
+      plhs[0] = mxCreateDoubleMatrix(nfibers,length, mxREAL);
+      out = mxGetPr(plhs[0]);
+
+      /*  Call the C subroutine. */
+      if(ifsingle)
+	error = an_arlo_popF(tdres,spont,model,species,ifspike,cf,nfibers,in,out,length);
+      else
+	error = an_arlo_pop(tdres,spont,model,species,ifspike,cf,nfibers,in,out,length);
+      if(nlhs>1) plhs[1] = cfarray;
+      else mxDestroyArray(cfarray);
+      if(error) mexErrMsgTxt("Error in calling the function.");
+}
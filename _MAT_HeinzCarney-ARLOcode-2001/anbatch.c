@@ -0,0 +1,130 @@
+/*
+ * Batch of independent fibers, see anbatch.h
+ *
+ * initAuditoryNerve only writes into its TAuditoryNerve, so every thread has its own
+ * fiber and nothing is shared but the (read-only) jobs and stimuli and the output
+ * slabs, of which every job writes its own part.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "anbatch.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define ANBATCH_CHUNK 4
+
+static int validjob(const TANBatch *b, const TANJob *job)
+{
+  if((job->model<1)||(job->model>5)) return(0);
+  if((job->species!=0)&&(job->species!=1)&&(job->species!=9)) return(0);
+  if((job->stim<0)||(job->stim>=b->nstim)) return(0);
+  if(!(job->cf>0)) return(0);
+return(1);
+}
+
+static int samefiber(const TANJob *a, const TANJob *b)
+{
+  return((a->cf==b->cf)&&(a->spont==b->spont)&&(a->model==b->model)&&(a->species==b->species));
+}
+
+int anbatch_run(const TANBatch *b, int nthreads, TANBatchProgress progress, void *arg)
+{
+  int j,failed,done;
+  time_t last;
+
+  for(j=0; j<b->njobs; j++)
+    if(!validjob(b,b->jobs+j)) return(-2);
+  if((b->njobs<1)||(b->length<1))
+  {
+    if(progress!=NULL) progress(arg,0,b->njobs);
+    return(0);
+  };
+#ifdef _OPENMP
+  if(nthreads<1) nthreads = omp_get_num_procs();
+  if(nthreads>b->njobs) nthreads = b->njobs;
+#endif
+
+  failed = 0;
+  done = 0;
+  last = time(NULL);
+#pragma omp parallel num_threads(nthreads) reduction(|:failed)
+  {
+    TAuditoryNerve anf,proto;
+    const TANJob *job,*protojob = NULL;
+    double *buf,*out,gain,sum;
+    const double *in;
+    int jj,i,master = 1;
+#ifdef _OPENMP
+    master = (omp_get_thread_num()==0);
+#endif
+    /*/ scaled stimulus and sout (when not kept) of this thread */
+    buf = (double*)malloc(sizeof(double)*2*b->length);
+    if(buf==NULL) failed = 1;
+#pragma omp for schedule(dynamic,ANBATCH_CHUNK)
+    for(jj=0; jj<b->njobs; jj++)
+    {
+      if(buf==NULL) continue;
+      job = b->jobs+jj;
+      if((protojob!=NULL)&&samefiber(job,protojob)) anf = proto;
+      else
+      {
+        anf.ifspike = b->ifspike;
+        initAuditoryNerveCached(&anf,job->model,job->species,b->tdres,job->cf,job->spont);
+        proto = anf;
+        protojob = job;
+      };
+      in = b->stim+(size_t)job->stim*b->length;
+      if(job->level!=0)
+      {
+        gain = pow(10.0,job->level/20.0);
+        for(i=0; i<b->length; i++) buf[i] = gain*in[i];
+        in = buf;
+      };
+      out = (b->sout!=NULL) ? b->sout+(size_t)jj*b->length : buf+b->length;
+      runAN2(&anf,in,out,b->length);
+      if(b->rate!=NULL)
+      {
+        sum = 0;
+        for(i=0; i<b->length; i++) sum += out[i];
+        b->rate[jj] = sum/b->length;
+      };
+#pragma omp atomic
+      done++;
+      if(master&&(progress!=NULL)&&(time(NULL)>last))
+      {
+        last = time(NULL);
+        progress(arg,done,b->njobs);
+      };
+    };
+    free(buf);
+  };
+  if(failed) return(-1);
+  if(progress!=NULL) progress(arg,b->njobs,b->njobs);
+return(0);
+}
+
+int anbatch_grid(const double *cf, int ncf, const double *spont, int nspont,
+                 const double *model, int nmodel, const double *species, int nspecies,
+                 const double *stim, int nstim, const double *level, int nlevel, TANJob *jobs)
+{
+  int ic,isp,im,is,ik,il,n = 0;
+  if(jobs==NULL) return(ncf*nspont*nmodel*nspecies*nstim*nlevel);
+  for(is=0; is<nspecies; is++)
+  for(im=0; im<nmodel; im++)
+  for(isp=0; isp<nspont; isp++)
+  for(ic=0; ic<ncf; ic++)
+  for(il=0; il<nlevel; il++)
+  for(ik=0; ik<nstim; ik++)
+  {
+    jobs[n].cf = cf[ic];
+    jobs[n].spont = spont[isp];
+    jobs[n].model = (int)model[im];
+    jobs[n].species = (int)species[is];
+    jobs[n].stim = (int)stim[ik];
+    jobs[n].level = level[il];
+    n++;
+  };
+return(n);
+}
@@ -0,0 +1,51 @@
+#ifndef _ANBATCH_H
+#define _ANBATCH_H
+#include "cmpa.h"
+
+/*/############################################################################## */
+/* Batch of independent fibers (rate-level functions, CF sweeps, ...)
+ *
+ * Every job is one an_arlo() call: a fiber (cf, spont, model, species) and one of the
+ * stimuli, scaled by level dB. The jobs run in parallel when compiled with OpenMP,
+ * each thread takes the next few jobs as it gets free (dynamic schedule), so short and
+ * long jobs balance over the threads. A thread keeps its fiber right after the init
+ * and copies it back when the next job has the same fiber (the jobs of a fiber should
+ * be next to each other, as anbatch_grid orders them), other fibers come from the
+ * fiber cache (initAuditoryNerveCached).
+ * Every job gives the same sout as an_arlo(), bit for bit, with any number of threads.
+ */
+typedef struct __ANJob TANJob;
+struct __ANJob {
+  double cf,spont;
+  int model,species;
+  int stim;      /* stimulus, 0..nstim-1 */
+  double level;  /* gain in dB, the stimulus is multiplied by 10^(level/20) */
+};
+
+typedef struct __ANBatch TANBatch;
+struct __ANBatch {
+  double tdres;
+  int ifspike;
+  const double *stim;   /* length x nstim, stimulus k at stim+k*length */
+  int nstim,length;
+  const TANJob *jobs;
+  int njobs;
+  double *sout;         /* length x njobs, sout of job j at sout+j*length, or NULL */
+  double *rate;         /* mean sout of every job, or NULL */
+};
+
+/* progress is called by the calling thread about once a second and at the end */
+typedef void (*TANBatchProgress)(void *arg, int done, int njobs);
+
+/* Run all the jobs on nthreads threads (0: all processors; without OpenMP always 1).
+ * Returns 0, -1 if out of memory, -2 if a job is invalid (then nothing is run) */
+int anbatch_run(const TANBatch *b, int nthreads, TANBatchProgress progress, void *arg);
+
+/* Cross product of the parameter vectors, the stimulus varies fastest, then the level,
+ * cf, spont, model and species (the jobs of a fiber are next to each other).
+ * jobs must hold ncf*nspont*nmodel*nspecies*nstim*nlevel elements (or be NULL to get
+ * the count). Returns the number of jobs */
+int anbatch_grid(const double *cf, int ncf, const double *spont, int nspont,
+                 const double *model, int nmodel, const double *species, int nspecies,
+                 const double *stim, int nstim, const double *level, int nlevel, TANJob *jobs);
+#endif
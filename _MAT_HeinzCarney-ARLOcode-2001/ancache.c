@@ -0,0 +1,125 @@
+/*
+ * Cache of initialized fibers, see initAuditoryNerveCached in cmpa.h
+ *
+ * The fibers are kept right after initAuditoryNerve in a hash table keyed by
+ * (model,species,tdres,cf,spont,ifspike), compared bit for bit. A fiber holds no
+ * pointers into itself or to other memory (only to functions, and tautap is NULL
+ * after the init), so a copy of the stored fiber is a fiber in its initial state.
+ * The table is guarded by one lock (an OpenMP critical section), held for the
+ * lookup and the copy; initAuditoryNerve itself runs outside of it.
+ * When ANCACHE_MAXFIBERS are stored, the table is emptied and starts over.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "cmpa.h"
+
+#define ANCACHE_BUCKETS 1024  /*/ power of 2 */
+#define ANCACHE_MAXFIBERS 4096
+
+typedef struct __ANCacheKey TANCacheKey;
+struct __ANCacheKey {
+  double tdres,cf,spont;
+  int model,species,ifspike;
+};
+
+typedef struct __ANCacheEntry TANCacheEntry;
+struct __ANCacheEntry {
+  TANCacheKey key;
+  TAuditoryNerve anf;
+  TANCacheEntry *next;
+};
+
+static TANCacheEntry *ancache[ANCACHE_BUCKETS];
+static long ancache_n = 0, ancache_hits = 0, ancache_misses = 0;
+
+/*/ FNV-1a over the bytes of the key (the key is zeroed first, so the padding is 0) */
+static unsigned int hashkey(const TANCacheKey *key)
+{
+  const unsigned char *c = (const unsigned char*)key;
+  unsigned int h = 2166136261U;
+  size_t i;
+  for(i=0; i<sizeof(TANCacheKey); i++) h = (h^c[i])*16777619U;
+return(h&(ANCACHE_BUCKETS-1));
+}
+
+static void emptycache(void)
+{
+  int i;
+  TANCacheEntry *e,*next;
+  for(i=0; i<ANCACHE_BUCKETS; i++)
+  {
+    for(e=ancache[i]; e!=NULL; e=next)
+    {
+      next = e->next;
+      free(e);
+    };
+    ancache[i] = NULL;
+  };
+  ancache_n = 0;
+}
+
+void initAuditoryNerveCached(TAuditoryNerve *p,int model, int species, double tdres, double cf, double spont)
+{
+  TANCacheKey key;
+  TANCacheEntry *e,*ne;
+  unsigned int h;
+  int found = 0;
+
+  memset(&key,0,sizeof(key));
+  key.tdres = tdres; key.cf = cf; key.spont = spont;
+  key.model = model; key.species = species; key.ifspike = p->ifspike;
+  h = hashkey(&key);
+#pragma omp critical(ancache)
+  {
+    for(e=ancache[h]; e!=NULL; e=e->next)
+      if(memcmp(&(e->key),&key,sizeof(key))==0)
+      {
+        memcpy(p,&(e->anf),sizeof(TAuditoryNerve));
+        ancache_hits++;
+        found = 1;
+        break;
+      };
+    if(!found) ancache_misses++;
+  };
+  if(found) return;
+
+  initAuditoryNerve(p,model,species,tdres,cf,spont);
+  ne = (TANCacheEntry*)malloc(sizeof(TANCacheEntry));
+  if(ne==NULL) return; /*/ not cached, p is initialized anyway */
+  memcpy(&(ne->key),&key,sizeof(key));
+  memcpy(&(ne->anf),p,sizeof(TAuditoryNerve));
+#pragma omp critical(ancache)
+  {
+    /*/ another thread may have stored the same fiber meanwhile */
+    for(e=ancache[h]; e!=NULL; e=e->next)
+      if(memcmp(&(e->key),&key,sizeof(key))==0) break;
+    if(e==NULL)
+    {
+      if(ancache_n>=ANCACHE_MAXFIBERS) emptycache();
+      ne->next = ancache[h];
+      ancache[h] = ne;
+      ancache_n++;
+      ne = NULL;
+    };
+  };
+  free(ne);
+}
+
+void clearAuditoryNerveCache(void)
+{
+#pragma omp critical(ancache)
+  {
+    emptycache();
+    ancache_hits = ancache_misses = 0;
+  };
+}
+
+void getAuditoryNerveCacheStats(long *nfibers, long *hits, long *misses)
+{
+#pragma omp critical(ancache)
+  {
+    *nfibers = ancache_n;
+    *hits = ancache_hits;
+    *misses = ancache_misses;
+  };
+}
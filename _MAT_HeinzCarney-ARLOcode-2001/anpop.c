@@ -0,0 +1,96 @@
+/*
+ * Population of auditory nerve fibers, see anpop.h
+ *
+ * The fibers are initialized one by one with initAuditoryNerve, so all the
+ * species/model dependent parameters come from cmpa.c, and then the state and
+ * the per-fiber parameters are gathered into arrays. The processing runs the
+ * same arithmetic as runAN2, but sample by sample with the fiber loop innermost.
+ * As in runGammaToneBatch, the frequency-shift phasors are advanced by rotation.
+ * The code is in anpop_impl.h, compiled here in double and in single precision.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "anpop.h"
+
+static int sizeGammaToneBank(int order) { return(9+2*(order+1)); }
+
+/*/ In silence the filter states decay below the smallest normal float within a few thousand
+//// samples, and arithmetic on denormals is very slow; the float population runs with
+//// denormals flushed to zero (SSE control register: flush-to-zero 0x8000, denormals-are-zero 0x40) */
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP>=1))
+#include <xmmintrin.h>
+#define ANPOP_FTZ_ENTER unsigned int csr = _mm_getcsr(); _mm_setcsr(csr|0x8040);
+#define ANPOP_FTZ_LEAVE _mm_setcsr(csr);
+#else
+#define ANPOP_FTZ_ENTER
+#define ANPOP_FTZ_LEAVE
+#endif
+
+/*/ double : TANPopulation */
+#define ANPOP_REAL double
+#define ANPOP_NAME(x) x
+#define ANPOP_LOG log
+#define ANPOP_EXP exp
+#define ANPOP_POW pow
+#define ANPOP_FABS fabs
+#define ANPOP_PPIMAX 400
+#define ANPOP_ENTER
+#define ANPOP_LEAVE
+#include "anpop_impl.h"
+#undef ANPOP_REAL
+#undef ANPOP_NAME
+#undef ANPOP_LOG
+#undef ANPOP_EXP
+#undef ANPOP_POW
+#undef ANPOP_FABS
+#undef ANPOP_PPIMAX
+#undef ANPOP_ENTER
+#undef ANPOP_LEAVE
+
+/*/ float : TANPopulationF */
+#define ANPOP_REAL float
+#define ANPOP_NAME(x) x##F
+#define ANPOP_LOG logf
+#define ANPOP_EXP expf
+#define ANPOP_POW powf
+#define ANPOP_FABS fabsf
+#define ANPOP_PPIMAX 30
+#define ANPOP_ENTER ANPOP_FTZ_ENTER
+#define ANPOP_LEAVE ANPOP_FTZ_LEAVE
+#include "anpop_impl.h"
+#undef ANPOP_REAL
+#undef ANPOP_NAME
+#undef ANPOP_LOG
+#undef ANPOP_EXP
+#undef ANPOP_POW
+#undef ANPOP_FABS
+#undef ANPOP_PPIMAX
+#undef ANPOP_ENTER
+#undef ANPOP_LEAVE
+
+/*/ ---------------------------------------------------------------------------- */
+int cochlea_cflist(int species, double cf, double cflo, double cfhi, double delx,
+                   int nfibers, double *cflist)
+{
+  int i;
+  double x0,offset;
+  if(nfibers<1) return(-1);
+  if((cflo>0)&&(cfhi>0))
+  {
+    x0 = cochlea_f2x(species,cflo);
+    if(nfibers>1) delx = (cochlea_f2x(species,cfhi)-x0)/(nfibers-1);
+    for(i=0; i<nfibers; i++) cflist[i] = cochlea_x2f(species,x0+i*delx);
+    cflist[0] = cflo;
+    if(nfibers>1) cflist[nfibers-1] = cfhi;
+  }
+  else
+  {
+    x0 = cochlea_f2x(species,cf);
+    for(i=0; i<nfibers; i++)
+    {
+      offset = (i-(nfibers-1)/2.0)*delx;
+      cflist[i] = (offset==0) ? cf : cochlea_x2f(species,x0+offset);
+    };
+  };
+  return(0);
+}
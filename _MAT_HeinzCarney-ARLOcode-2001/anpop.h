@@ -0,0 +1,43 @@
+#ifndef _ANPOP_H
+#define _ANPOP_H
+#include "cmpa.h"
+
+/*/############################################################################## */
+/* Population of auditory nerve fibers
+ *
+ * All fibers of a population share tdres, model, species, spont and ifspike and
+ * differ only in cf. The state of every stage is kept as structure-of-arrays
+ * (one contiguous array per state variable, indexed by fiber), so that
+ * the inner loop of each stage runs over fibers and can be vectorized by the
+ * compiler (compile with -O3 -mavx2 or -mavx512f to get 4 or 8 fibers per
+ * instruction). The output of anpop_run is fiber-major: out[i+nfibers*n] is
+ * the synapse output of fiber i at sample n, i.e. a CF x time matrix in MATLAB.
+ *
+ * Every fiber gives the same sout as an_arlo() with the same parameters, to rounding
+ * (the linear models 3 and 4 bit for bit); the feedback model (2) amplifies that
+ * rounding at CFs well above a loud tone, as it does any change of the stimulus, so
+ * there only its mean rate is the same. test_pop.c checks this.
+ *
+ * TANPopulationF (getANPopulationF, anpop_runF, freeANPopulationF) is the same model
+ * in single precision, twice as many fibers per instruction. The parameters are computed
+ * in double and the synapse runs in double; see test_float.c for its accuracy.
+ */
+#define ANPOP_REAL double
+#define ANPOP_NAME(x) x
+#include "anpop_types.h"
+#undef ANPOP_REAL
+#undef ANPOP_NAME
+
+#define ANPOP_REAL float
+#define ANPOP_NAME(x) x##F
+#include "anpop_types.h"
+#undef ANPOP_REAL
+#undef ANPOP_NAME
+
+/* CFs equally spaced along the basilar membrane (cochlea_f2x)
+   if cflo>0 and cfhi>0, nfibers CFs from cflo to cfhi,
+   otherwise nfibers CFs centered at cf and delx mm apart.
+   cflist must hold nfibers elements */
+int cochlea_cflist(int species, double cf, double cflo, double cfhi, double delx,
+                   int nfibers, double *cflist);
+#endif
@@ -0,0 +1,437 @@
+/*
+ * Implementation of the fiber population, included twice by anpop.c (see anpop_types.h).
+ * Besides ANPOP_REAL and ANPOP_NAME, the includer defines ANPOP_LOG, ANPOP_EXP, ANPOP_POW
+ * and ANPOP_FABS for ANPOP_REAL, and ANPOP_PPIMAX, above which log(1+exp(x)) is taken as x
+ * (400 as in runIHCPPI2 for double, exp overflows a float above 88), and ANPOP_ENTER and
+ * ANPOP_LEAVE, run at the start (after the declarations) and at the end of anpop_run. Constants go through R() so that the float version is
+ * not promoted to double. No include guard on purpose.
+ */
+#define R(x) ((ANPOP_REAL)(x))
+
+/*/ ---------------------------------------------------------------------------- */
+static ANPOP_REAL* ANPOP_NAME(takeArray)(ANPOP_REAL **mem, int n)
+{
+  ANPOP_REAL *p = *mem;
+  int i;
+  for(i=0; i<n; i++) p[i] = 0;
+  *mem += n;
+  return(p);
+}
+
+static void ANPOP_NAME(initGammaToneBank)(ANPOP_NAME(TGammaToneBank) *g, ANPOP_REAL **mem, int n, int order)
+{
+  int j;
+  g->n = n;
+  g->Order = order;
+  g->nrot = 0;
+  g->zr = ANPOP_NAME(takeArray)(mem,n);
+  g->zi = ANPOP_NAME(takeArray)(mem,n);
+  g->dzr = ANPOP_NAME(takeArray)(mem,n);
+  g->dzi = ANPOP_NAME(takeArray)(mem,n);
+  g->F_shift = ANPOP_NAME(takeArray)(mem,n);
+  g->tau = ANPOP_NAME(takeArray)(mem,n);
+  g->gain = ANPOP_NAME(takeArray)(mem,n);
+  g->c1LP = ANPOP_NAME(takeArray)(mem,n);
+  g->c2LP = ANPOP_NAME(takeArray)(mem,n);
+  for(j=0; j<=order; j++)
+  {
+    g->gtfx[j] = ANPOP_NAME(takeArray)(mem,n);
+    g->gtfy[j] = ANPOP_NAME(takeArray)(mem,n);
+  };
+}
+
+/*/ copy the parameters and the state of a gammatone filter into slot i of the bank */
+static void ANPOP_NAME(setGammaToneBank)(ANPOP_NAME(TGammaToneBank) *g, int i, const TGammaTone *gt)
+{
+  int j;
+  g->tdres = gt->tdres;
+  g->zr[i] = R(gt->c_phase.x);
+  g->zi[i] = R(gt->c_phase.y);
+  g->dzr[i] = R(gt->c_delta.x);
+  g->dzi[i] = R(gt->c_delta.y);
+  g->F_shift[i] = R(gt->F_shift);
+  g->tau[i] = R(gt->tau);
+  g->gain[i] = R(gt->gain);
+  g->c1LP[i] = R(gt->c1LP);
+  g->c2LP[i] = R(gt->c2LP);
+  for(j=0; j<=g->Order; j++)
+  {
+    g->gtfx[j][i] = R(gt->gtf[j].x);
+    g->gtfy[j][i] = R(gt->gtf[j].y);
+  };
+}
+
+static void ANPOP_NAME(initLowPassBank)(ANPOP_NAME(TLowPassBank) *lp, ANPOP_REAL **mem, int n, const TLowPass *proto)
+{
+  int j;
+  lp->n = n;
+  lp->Order = proto->Order;
+  lp->gain = R(proto->gain);
+  lp->c1LP = R(proto->c1LP);
+  lp->c2LP = R(proto->c2LP);
+  for(j=0; j<=lp->Order; j++) lp->hc[j] = ANPOP_NAME(takeArray)(mem,n);
+}
+
+/*/ ---------------------------------------------------------------------------- */
+ANPOP_NAME(TANPopulation)* ANPOP_NAME(getANPopulation)(int model, int species, double tdres, double spont,
+                               int ifspike, const double *cf, int nfibers)
+{
+  ANPOP_NAME(TANPopulation) *p;
+  TAuditoryNerve *anf;
+  ANPOP_REAL *mem;
+  double *dmem;
+  int i,j,nmem;
+
+  if(nfibers<1) return(NULL);
+  p = (ANPOP_NAME(TANPopulation)*)calloc(1,sizeof(ANPOP_NAME(TANPopulation)));
+  anf = (TAuditoryNerve*)malloc(sizeof(TAuditoryNerve));
+  if((p==NULL)||(anf==NULL)) { free(p); free(anf); return(NULL); };
+
+  p->nfibers = nfibers;
+  p->tdres = tdres;
+  p->spont = spont;
+  p->model = model;
+  p->species = species;
+  p->ifspike = ifspike;
+
+  /*/ the first fiber fixes the order of the filters and the shared parameters */
+  anf->ifspike = ifspike;
+  initAuditoryNerve(anf,model,species,tdres,cf[0],spont);
+  p->bmmodel = anf->bm.bmmodel;
+  p->ohcnl = anf->bm.ohc.hcnl;
+  p->ihcnl = anf->ihc.hcnl;
+
+  nmem = 6 + sizeGammaToneBank(anf->bm.bmfilter.Order) + sizeGammaToneBank(anf->bm.gfagain.Order)
+    + sizeGammaToneBank(anf->bm.wbfilter.Order) + (anf->bm.ohc.hclp.Order+1) + 2
+    + (anf->ihc.hclp.Order+1) + 2 + 11;
+  p->mem = (ANPOP_REAL*)malloc(sizeof(ANPOP_REAL)*nmem*nfibers);
+  p->dmem = (double*)malloc(sizeof(double)*9*nfibers);
+  if((p->mem==NULL)||(p->dmem==NULL)) { free(p->mem); free(p->dmem); free(p); free(anf); return(NULL); };
+  mem = p->mem;
+  dmem = p->dmem;
+  for(j=0; j<9*nfibers; j++) dmem[j] = 0.0;
+
+  p->cf = dmem; dmem += nfibers;
+  p->tau = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->TauMax = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->TauMin = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->A = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->B = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->lingain = ANPOP_NAME(takeArray)(&mem,nfibers);
+  ANPOP_NAME(initGammaToneBank)(&(p->bmfilter),&mem,nfibers,anf->bm.bmfilter.Order);
+  ANPOP_NAME(initGammaToneBank)(&(p->gfagain),&mem,nfibers,anf->bm.gfagain.Order);
+  ANPOP_NAME(initGammaToneBank)(&(p->wbfilter),&mem,nfibers,anf->bm.wbfilter.Order);
+  ANPOP_NAME(initLowPassBank)(&(p->ohclp),&mem,nfibers,&(anf->bm.ohc.hclp));
+  p->minR = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->s0 = ANPOP_NAME(takeArray)(&mem,nfibers);
+  ANPOP_NAME(initLowPassBank)(&(p->ihclp),&mem,nfibers,&(anf->ihc.hclp));
+  p->p1 = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->p2 = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->PL = dmem; dmem += nfibers;
+  p->PG = dmem; dmem += nfibers;
+  p->CG = dmem; dmem += nfibers;
+  p->VI = dmem; dmem += nfibers;
+  p->VL = dmem; dmem += nfibers;
+  p->CIlast = dmem; dmem += nfibers;
+  p->CLlast = dmem; dmem += nfibers;
+  p->PPIlast = dmem; dmem += nfibers;
+  p->cr = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->ci = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->wbcr = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->wbci = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->x = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->y = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->ctl = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->f0 = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->f1 = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->f2 = ANPOP_NAME(takeArray)(&mem,nfibers);
+  p->f3 = ANPOP_NAME(takeArray)(&mem,nfibers);
+
+  for(i=0; i<nfibers; i++)
+  {
+    if(i>0)
+    {
+      anf->ifspike = ifspike;
+      initAuditoryNerve(anf,model,species,tdres,cf[i],spont);
+    };
+    p->cf[i] = cf[i];
+    p->tau[i] = R(anf->bm.tau);
+    p->TauMax[i] = R(anf->bm.TauMax);
+    p->TauMin[i] = R(anf->bm.TauMin);
+    p->A[i] = R(anf->bm.A);
+    p->B[i] = R(anf->bm.B);
+    p->lingain[i] = R(pow((anf->bm.TauMin/anf->bm.TauMax),anf->bm.bmfilter.Order));
+    ANPOP_NAME(setGammaToneBank)(&(p->bmfilter),i,&(anf->bm.bmfilter));
+    ANPOP_NAME(setGammaToneBank)(&(p->gfagain),i,&(anf->bm.gfagain));
+    ANPOP_NAME(setGammaToneBank)(&(p->wbfilter),i,&(anf->bm.wbfilter));
+    p->minR[i] = R(anf->bm.afterohc.minR);
+    p->s0[i] = R(anf->bm.afterohc.s0);
+    p->p1[i] = R(anf->ihcppi.p1);
+    p->p2[i] = R(anf->ihcppi.p2);
+    p->PL[i] = anf->syn.PL;
+    p->PG[i] = anf->syn.PG;
+    p->CG[i] = anf->syn.CG;
+    p->VI[i] = anf->syn.VI;
+    p->VL[i] = anf->syn.VL;
+    p->CIlast[i] = anf->syn.CIlast;
+    p->CLlast[i] = anf->syn.CLlast;
+    p->PPIlast[i] = anf->syn.PPIlast;
+  };
+  free(anf);
+  return(p);
+}
+
+void ANPOP_NAME(freeANPopulation)(ANPOP_NAME(TANPopulation) *p)
+{
+  if(p==NULL) return;
+  free(p->mem);
+  free(p->dmem);
+  free(p);
+}
+
+/*/ ---------------------------------------------------------------------------- */
+/* advance the frequency-shift phasor of every filter by one rotation and return it,
+   the phasors are put back on the unit circle every GT_BLOCK samples */
+static void ANPOP_NAME(runGammaToneBankPhase)(ANPOP_NAME(TGammaToneBank) *g, ANPOP_REAL *cr, ANPOP_REAL *ci)
+{
+  register int i;
+  const int n = g->n;
+  ANPOP_REAL *zr = g->zr;
+  ANPOP_REAL *zi = g->zi;
+  const ANPOP_REAL *dzr = g->dzr;
+  const ANPOP_REAL *dzi = g->dzi;
+  ANPOP_REAL r;
+  for(i=0; i<n; i++)
+  {
+    cr[i] = zr[i]*dzr[i]-zi[i]*dzi[i];
+    ci[i] = zi[i]*dzr[i]+zr[i]*dzi[i];
+    zr[i] = cr[i];
+    zi[i] = ci[i];
+  };
+  if(++g->nrot<GT_BLOCK) return;
+  g->nrot = 0;
+  for(i=0; i<n; i++)
+  {
+    r = (R(3.0)-(zr[i]*zr[i]+zi[i]*zi[i]))*R(0.5);
+    zr[i] *= r;
+    zi[i] *= r;
+  };
+}
+
+/* one sample through every filter of the bank, same arithmetic as runGammaTone2,
+   (cr,ci) is the frequency-shift phasor of each filter, in and out can be the same */
+static void ANPOP_NAME(runGammaToneBank)(ANPOP_NAME(TGammaToneBank) *g, const ANPOP_REAL *cr, const ANPOP_REAL *ci,
+                             const ANPOP_REAL *in, ANPOP_REAL *out,
+                             ANPOP_REAL *nx, ANPOP_REAL *ny, ANPOP_REAL *ox, ANPOP_REAL *oy)
+{
+  register int i,j;
+  const int n = g->n;
+  const ANPOP_REAL *gain = g->gain;
+  const ANPOP_REAL *c1LP = g->c1LP;
+  const ANPOP_REAL *c2LP = g->c2LP;
+  ANPOP_REAL *gx,*gy;
+  ANPOP_REAL x,tx,ty;
+
+  gx = g->gtfx[0];
+  gy = g->gtfy[0];
+  for(i=0; i<n; i++)
+  { /*/ FREQUENCY SHIFT */
+    x = gain[i]*in[i];
+    nx[i] = cr[i]*x;
+    ny[i] = ci[i]*x;
+    ox[i] = gx[i];
+    oy[i] = gy[i];
+    gx[i] = nx[i];
+    gy[i] = ny[i];
+  };
+  for(j=1; j<=g->Order; j++) /*/ IIR Bilinear transformation LPF */
+  {
+    gx = g->gtfx[j];
+    gy = g->gtfy[j];
+    for(i=0; i<n; i++)
+    {
+      tx = gx[i]*c1LP[i] + (nx[i]+ox[i])*c2LP[i];
+      ty = gy[i]*c1LP[i] + (ny[i]+oy[i])*c2LP[i];
+      ox[i] = gx[i];
+      oy[i] = gy[i];
+      gx[i] = nx[i] = tx;
+      gy[i] = ny[i] = ty;
+    };
+  };
+  for(i=0; i<n; i++) /*/ FREQ SHIFT BACK UP, real part */
+    out[i] = cr[i]*nx[i] + ci[i]*ny[i];
+}
+
+static void ANPOP_NAME(setGammaToneBankTau)(ANPOP_NAME(TGammaToneBank) *g, const ANPOP_REAL *tau)
+{
+  register int i;
+  const int n = g->n;
+  const ANPOP_REAL tdres2 = R(2.0/g->tdres);
+  ANPOP_REAL dtmp;
+  for(i=0; i<n; i++)
+  {
+    g->tau[i] = tau[i];
+    dtmp = tau[i]*tdres2;
+    g->c1LP[i] = (dtmp-1)/(dtmp+1);
+    g->c2LP[i] = R(1.0)/(dtmp+1);
+  };
+}
+
+/* one sample through every low-pass filter of the bank, same arithmetic as runLowPass2 */
+static void ANPOP_NAME(runLowPassBank)(ANPOP_NAME(TLowPassBank) *lp, const ANPOP_REAL *in, ANPOP_REAL *out,
+                                       ANPOP_REAL *nx, ANPOP_REAL *ox)
+{
+  register int i,j;
+  const int n = lp->n;
+  const ANPOP_REAL c1LP = lp->c1LP;
+  const ANPOP_REAL c2LP = lp->c2LP;
+  const ANPOP_REAL gain = lp->gain;
+  ANPOP_REAL *hc,t;
+
+  hc = lp->hc[0];
+  for(i=0; i<n; i++)
+  {
+    ox[i] = hc[i];
+    hc[i] = nx[i] = in[i]*gain;
+  };
+  for(j=1; j<=lp->Order; j++)
+  {
+    hc = lp->hc[j];
+    for(i=0; i<n; i++)
+    {
+      t = c1LP*hc[i] + c2LP*(nx[i]+ox[i]);
+      ox[i] = hc[i];
+      hc[i] = nx[i] = t;
+    };
+  };
+  for(i=0; i<n; i++) out[i] = nx[i];
+}
+
+/* OHC Boltzman function, see runBoltzman2 */
+static void ANPOP_NAME(runBoltzmanBank)(const TNonLinear *p, const ANPOP_REAL *in, ANPOP_REAL *out, const int n)
+{
+  register int i;
+  const ANPOP_REAL Acp = R(p->Acp), Bcp = R(p->Bcp), Ccp = R(p->Ccp);
+  const ANPOP_REAL x0 = R(p->x0), s0 = R(p->s0), x1 = R(p->x1), s1 = R(p->s1);
+  const ANPOP_REAL shift = R(p->shift);
+  ANPOP_REAL x,xx;
+  for(i=0; i<n; i++)
+  {
+    x = in[i];
+    xx = Bcp*ANPOP_LOG(1+Acp*ANPOP_POW(ANPOP_FABS(x),Ccp));
+    if(x<0) xx = -xx;
+    out[i] = (R(1.0)/(R(1.0)+ANPOP_EXP(-(xx-x0)/s0)*(R(1.0)+ANPOP_EXP(-(xx-x1)/s1)))-shift)/(1-shift);
+  };
+}
+
+/* the control signal sets tau of the tuning filter through the AfterOHC nonlinearity,
+   and the gain of the tuning filter follows tau */
+static void ANPOP_NAME(runControlPath)(ANPOP_NAME(TANPopulation) *p, const ANPOP_REAL *ctl)
+{
+  register int i;
+  const int n = p->nfibers;
+  const ANPOP_REAL order = R(p->bmfilter.Order);
+  ANPOP_REAL *f0 = p->f0;
+
+  ANPOP_NAME(runBoltzmanBank)(&(p->ohcnl),ctl,f0,n);
+  ANPOP_NAME(runLowPassBank)(&(p->ohclp),f0,f0,p->f1,p->f2);
+  for(i=0; i<n; i++)
+    p->tau[i] = p->TauMax[i]*(p->minR[i]+(1-p->minR[i])*ANPOP_EXP(-ANPOP_FABS(f0[i])/p->s0[i]));
+  ANPOP_NAME(setGammaToneBankTau)(&(p->bmfilter),p->tau);
+  for(i=0; i<n; i++)
+    p->y[i] *= ANPOP_POW((p->tau[i]/p->TauMax[i]),order);
+}
+
+void ANPOP_NAME(anpop_run)(ANPOP_NAME(TANPopulation) *p, const double *in, double *out, const int length)
+{
+  register int i,k;
+  const int n = p->nfibers;
+  ANPOP_REAL *x = p->x;
+  ANPOP_REAL *y = p->y;
+  ANPOP_REAL *ctl = p->ctl;
+  double *o;
+  ANPOP_REAL taunow,dtmp,temp,tempA,xin;
+  double CInow;
+  const TNonLinear *ihcnl = &(p->ihcnl);
+  const ANPOP_REAL A0 = R(ihcnl->A0), B = R(ihcnl->B), C = R(ihcnl->C), D = R(ihcnl->D);
+  const ANPOP_REAL wborder = R(p->wbfilter.Order/2.0);
+  const double tdres = p->tdres;
+  ANPOP_ENTER
+
+  for(k=0; k<length; k++)
+  {
+    o = out+(long)k*n;
+    xin = R(in[k]);
+    for(i=0; i<n; i++) x[i] = xin;
+    /*
+     * Basilar membrane
+     * bmfilter and gfagain are both shifted by cf and start with phase 0,
+     * so they share one phasor
+     */
+    ANPOP_NAME(runGammaToneBankPhase)(&(p->bmfilter),p->cr,p->ci);
+    ANPOP_NAME(runGammaToneBank)(&(p->bmfilter),p->cr,p->ci,x,y,p->f0,p->f1,p->f2,p->f3);
+    switch(p->bmmodel){
+    default:
+    case Sharp_Linear:
+    case Broad_Linear:
+      break;
+    case Broad_Linear_High:
+      for(i=0; i<n; i++) y[i] *= p->lingain[i];
+      break;
+    case FeedBack_NL:
+      for(i=0; i<n; i++) ctl[i] = y[i];
+      ANPOP_NAME(runControlPath)(p,ctl);
+      break;
+    case FeedForward_NL:
+      ANPOP_NAME(runGammaToneBankPhase)(&(p->wbfilter),p->wbcr,p->wbci);
+      ANPOP_NAME(runGammaToneBank)(&(p->wbfilter),p->wbcr,p->wbci,x,ctl,p->f0,p->f1,p->f2,p->f3);
+      for(i=0; i<n; i++)
+      { /*/ scale the tau of the wide band filter and normalize its gain as 0dB at CF */
+        taunow = p->A[i]*p->tau[i]*p->tau[i]-p->B[i]*p->tau[i];
+        p->f0[i] = taunow;
+        dtmp = taunow*R(TWOPI)*(p->wbfilter.F_shift[i]-p->bmfilter.F_shift[i]);
+        p->wbfilter.gain[i] = ANPOP_POW((1+dtmp*dtmp),wborder);
+      };
+      ANPOP_NAME(setGammaToneBankTau)(&(p->wbfilter),p->f0);
+      ANPOP_NAME(runControlPath)(p,ctl);
+      break;
+    };
+    ANPOP_NAME(runGammaToneBank)(&(p->gfagain),p->cr,p->ci,y,y,p->f0,p->f1,p->f2,p->f3);
+    /*
+     * Inner hair cell
+     */
+    for(i=0; i<n; i++)
+    {
+      temp = y[i];
+      if(temp>=0)
+        tempA = A0;
+      else
+      {
+        dtmp = ANPOP_POW(-temp,C);
+        tempA = -A0*(dtmp+D)/(3*dtmp+D);
+      };
+      y[i] = tempA*ANPOP_LOG(ANPOP_FABS(temp)*B+1);
+    };
+    ANPOP_NAME(runLowPassBank)(&(p->ihclp),y,y,p->f0,p->f1);
+    /*
+     * IHC-PPI soft-rectifier and synapse
+     */
+    for(i=0; i<n; i++)
+    {
+      temp = p->p2[i]*y[i];
+      if(temp<ANPOP_PPIMAX) y[i] = p->p1[i]*ANPOP_LOG(1+ANPOP_EXP(temp));
+      else y[i] = p->p1[i]*temp;
+    };
+    for(i=0; i<n; i++)
+    {
+      CInow = p->CIlast[i] + (tdres/p->VI[i])*((-p->PPIlast[i]*p->CIlast[i])+p->PL[i]*(p->CLlast[i]-p->CIlast[i]));
+      p->CLlast[i] = p->CLlast[i] + (tdres/p->VL[i])*(-p->PL[i]*(p->CLlast[i]-p->CIlast[i])+p->PG[i]*(p->CG[i]-p->CLlast[i]));
+      p->CIlast[i] = CInow;
+      p->PPIlast[i] = y[i];
+      o[i] = CInow*y[i];
+    };
+  };
+  ANPOP_LEAVE
+}
+
+#undef R
@@ -0,0 +1,69 @@
+/*
+ * Types of the fiber population, included twice by anpop.h:
+ * with ANPOP_REAL double and ANPOP_NAME(x) x for TANPopulation,
+ * with ANPOP_REAL float and ANPOP_NAME(x) x##F for TANPopulationF.
+ * No include guard on purpose.
+ */
+
+typedef struct ANPOP_NAME(__GammaToneBank) ANPOP_NAME(TGammaToneBank);
+typedef struct ANPOP_NAME(__LowPassBank) ANPOP_NAME(TLowPassBank);
+typedef struct ANPOP_NAME(__ANPopulation) ANPOP_NAME(TANPopulation);
+
+/** Bank of gammatone filters of the same order, one per fiber
+    gtfx[j][i],gtfy[j][i] is the state gtf[j] of the filter of fiber i
+ */
+struct ANPOP_NAME(__GammaToneBank){
+  int n,Order;
+  double tdres;
+  int nrot;                 /*/ rotations since the phasors were last renormalized */
+  ANPOP_REAL *zr,*zi,*dzr,*dzi; /*/ phasor exp(i*phase) and its step exp(i*delta_phase) */
+  ANPOP_REAL *F_shift;
+  ANPOP_REAL *tau,*gain,*c1LP,*c2LP;
+  ANPOP_REAL *gtfx[MAX_ORDER+1],*gtfy[MAX_ORDER+1];
+};
+
+/** Bank of low-pass filters with the same coefficients, one per fiber
+    hc[j][i] is the state hc[j] of the filter of fiber i
+ */
+struct ANPOP_NAME(__LowPassBank){
+  int n,Order;
+  ANPOP_REAL gain,c1LP,c2LP;
+  ANPOP_REAL *hc[MAX_ORDER+1];
+};
+
+struct ANPOP_NAME(__ANPopulation){
+  int nfibers;
+  double tdres,spont;
+  int model,species,ifspike;
+  int bmmodel;
+  double *cf;
+  /*/ Basilar membrane */
+  ANPOP_REAL *tau,*TauMax,*TauMin,*A,*B;
+  ANPOP_REAL *lingain;          /*/ (TauMin/TauMax)^order for Broad_Linear_High */
+  ANPOP_NAME(TGammaToneBank) bmfilter,gfagain,wbfilter;
+  /*/ Control path : OHC and AfterOHC nonlinearity */
+  TNonLinear ohcnl;         /*/ Boltzman parameters are the same for all the fibers */
+  ANPOP_NAME(TLowPassBank) ohclp;
+  ANPOP_REAL *minR,*s0;
+  /*/ Inner hair cell, IHC-PPI */
+  TNonLinear ihcnl;
+  ANPOP_NAME(TLowPassBank) ihclp;
+  ANPOP_REAL *p1,*p2;
+  /*/ Synapse, always in double: at tdres=2e-6 the Euler steps of CL (~2000) near its steady
+  //// state are about one ulp of a float, so in float CL stops short of its steady state */
+  double *PL,*PG,*CG,*VI,*VL;
+  double *CIlast,*CLlast,*PPIlast;
+  /*/ Work space, nfibers each */
+  ANPOP_REAL *cr,*ci,*wbcr,*wbci,*x,*y,*ctl;
+  ANPOP_REAL *f0,*f1,*f2,*f3;
+  ANPOP_REAL *mem;
+  double *dmem;
+};
+
+/* Create a population, return NULL if out of memory */
+ANPOP_NAME(TANPopulation)* ANPOP_NAME(getANPopulation)(int model, int species, double tdres, double spont,
+                               int ifspike, const double *cf, int nfibers);
+void ANPOP_NAME(freeANPopulation)(ANPOP_NAME(TANPopulation) *p);
+/* Run length samples, out is nfibers x length (fiber index running fastest).
+   The state is kept, so a long stimulus can be fed in consecutive pieces */
+void ANPOP_NAME(anpop_run)(ANPOP_NAME(TANPopulation) *p, const double *in, double *out, const int length);
@@ -0,0 +1,405 @@
+/*
+ * Forward-mode sensitivity of the fiber (runAN2Sens, see cmpa.h)
+ *
+ * Next to its value, every signal of the model carries its derivatives with respect
+ * to nder parameters of the stimulus (dual numbers): the stimulus derivatives din go
+ * through the tuning filter, the wide band filter, the OHC Boltzman function and
+ * low-pass, the AfterOHC nonlinearity (which sets tau, and so the coefficients and the
+ * gain of the tuning filter), gfagain, the IHC nonlinearity and low-pass, the IHC-PPI
+ * and the synapse, by the chain rule, in the same pass as the values.
+ *
+ * The basilar membrane is written out as in bmkernel.c, one sample at a time: the value
+ * of the cascade first, then for every parameter the derivative of the cascade, which
+ * needs the filter state before and after the sample. The other stages run their usual
+ * run2 on the values, and the derivatives are done stage by stage on the whole buffer.
+ * Non-differentiable points (|x| at 0 in the OHC and AfterOHC) take the derivative 0.
+ * The derivative of the state before the call is taken as 0, the state itself does
+ * not depend on the stimulus parameters.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "cmpa.h"
+
+/*/ derivative of the basilar membrane state with respect to one parameter */
+typedef struct {
+  COMPLEX g[MAX_ORDER+1],w[MAX_ORDER+1],a[MAX_ORDER+1]; /*/ tuning, wide band filter, gfagain */
+  double hc[MAX_ORDER+1]; /*/ OHC low-pass */
+  double tau,c1,c2; /*/ tuning filter */
+  double wc1,wc2,wgain; /*/ wide band filter */
+} TBMDual;
+
+static double ipow(double x, int n)
+{
+  double y = 1.0;
+  int i;
+  for(i=0; i<n; i++) y *= x;
+  return(y);
+}
+
+/*/ one sample of a gammatone cascade: gn gets the state after the sample, g is not changed */
+static void gtvalue(const COMPLEX *g, COMPLEX *gn, double nx, double ny, double c1, double c2, int order)
+{
+  int j;
+  gn[0].x = nx; gn[0].y = ny;
+  for(j=1; j<=order; j++)
+  {
+    gn[j].x = g[j].x*c1 + (gn[j-1].x+g[j-1].x)*c2;
+    gn[j].y = g[j].y*c1 + (gn[j-1].y+g[j-1].y)*c2;
+  };
+}
+
+/*/ its derivative: dg is the derivative of the state, updated in place, (dnx,dny) of the input,
+//// dc1 and dc2 of the coefficients; g and gn are the state before and after the sample */
+static void gtdual(const COMPLEX *g, const COMPLEX *gn, COMPLEX *dg, double dnx, double dny,
+                   double c1, double c2, double dc1, double dc2, int order)
+{
+  int j;
+  double ox,oy,tx,ty;
+  ox = dg[0].x; oy = dg[0].y;
+  dg[0].x = dnx; dg[0].y = dny;
+  for(j=1; j<=order; j++)
+  {
+    tx = dg[j].x*c1 + g[j].x*dc1 + (dg[j-1].x+ox)*c2 + (gn[j-1].x+g[j-1].x)*dc2;
+    ty = dg[j].y*c1 + g[j].y*dc1 + (dg[j-1].y+oy)*c2 + (gn[j-1].y+g[j-1].y)*dc2;
+    ox = dg[j].x; oy = dg[j].y;
+    dg[j].x = tx; dg[j].y = ty;
+  };
+}
+
+/*/ derivatives of the coefficients c1 = (T-1)/(T+1), c2 = 1/(T+1), T = 2*tau/tdres */
+static void coefdual(double tau, double dtau, double tdres, double *dc1, double *dc2)
+{
+  double T = tau*2.0/tdres;
+  double dT = dtau*2.0/tdres;
+  *dc1 = 2.0*dT/((T+1)*(T+1));
+  *dc2 = -dT/((T+1)*(T+1));
+}
+
+static void bmdual(TBasilarMembrane *bm, const double *in, const double *din, double *out, double *dout,
+                   const int length, const int nder, TBMDual *d, double *dv, double *dw)
+{
+  int i,j,k,kend,iend,nrot;
+  TGammaTone *bf = &(bm->bmfilter);
+  TGammaTone *wf = &(bm->wbfilter);
+  TGammaTone *gf = &(bm->gfagain);
+  TLowPass *lp = &(bm->ohc.hclp);
+  const TNonLinear *nl = &(bm->ohc.hcnl);
+  const TNonLinear *ao = &(bm->afterohc);
+  const int bmmodel = bm->bmmodel;
+  const int order = bf->Order;
+  const int worder = wf->Order;
+  const int gorder = gf->Order;
+  const int lporder = lp->Order;
+  COMPLEX g[MAX_ORDER+1],w[MAX_ORDER+1],a[MAX_ORDER+1];
+  COMPLEX gn[MAX_ORDER+1];
+  COMPLEX z,wz,c;
+  double hc[MAX_ORDER+1];
+  double x,x1,xx,ctl,nx,ox,tx,dtmp,dx,absx,pw,e,e0,e1,den,gc;
+  double slope,dn,dox,dtx,dtaunow;
+  const COMPLEX dz = bf->c_delta;
+  const double gain = bf->gain;
+  double c1 = bf->c1LP;
+  double c2 = bf->c2LP;
+  const double again = gf->gain;
+  const double ac1 = gf->c1LP;
+  const double ac2 = gf->c2LP;
+  const COMPLEX wdz = wf->c_delta;
+  double wgain = wf->gain;
+  double wc1 = wf->c1LP;
+  double wc2 = wf->c2LP;
+  double taunow = wf->tau;
+  const double wdf = TWOPI*(wf->F_shift-bf->F_shift);
+  double tau = bm->tau;
+  const double tdres = bm->tdres;
+  const double TauMax = bm->TauMax;
+  const double A = bm->A;
+  const double B = bm->B;
+  const double lingain = ipow(bm->TauMin/bm->TauMax,order);
+  const double lpc1 = lp->c1LP;
+  const double lpc2 = lp->c2LP;
+  const double lpgain = lp->gain;
+  const double shift = nl->shift;
+  const double minR = ao->minR;
+  const double aoTauMax = ao->TauMax;
+
+  z = bf->c_phase;
+  wz = wf->c_phase;
+  for(j=0; j<=order; j++) g[j] = bf->gtf[j];
+  for(j=0; j<=gorder; j++) a[j] = gf->gtf[j];
+  for(j=0; j<=worder; j++) w[j] = wf->gtf[j];
+  for(j=0; j<=lporder; j++) hc[j] = lp->hc[j];
+
+  nrot = bf->nrot;
+  for(kend=0; kend<length; kend=iend)
+  {
+  iend = (length-kend<GT_BLOCK-nrot) ? length : kend+GT_BLOCK-nrot;
+  for(i=kend; i<iend; i++)
+  {
+    x = in[i];
+    /*/ tuning filter */
+    CMULT(c,z,dz);
+    z = c;
+    x1 = gain*x;
+    gtvalue(g,gn,z.x*x1,z.y*x1,c1,c2,order);
+    for(k=0; k<nder; k++)
+    {
+      dx = gain*din[i+length*k];
+      gtdual(g,gn,d[k].g,z.x*dx,z.y*dx,c1,c2,d[k].c1,d[k].c2,order);
+      dv[k] = z.x*d[k].g[order].x + z.y*d[k].g[order].y;
+    };
+    for(j=0; j<=order; j++) g[j] = gn[j];
+    x1 = z.x*g[order].x + z.y*g[order].y;
+
+    if(bmmodel&NonLinear_ALL)
+    {
+      if(bmmodel==FeedForward_NL)
+      { /*/ the wide-band pass is the control signal */
+        CMULT(c,wz,wdz);
+        wz = c;
+        xx = wgain*x;
+        gtvalue(w,gn,wz.x*xx,wz.y*xx,wc1,wc2,worder);
+        for(k=0; k<nder; k++)
+        {
+          dx = d[k].wgain*x + wgain*din[i+length*k];
+          gtdual(w,gn,d[k].w,wz.x*dx,wz.y*dx,wc1,wc2,d[k].wc1,d[k].wc2,worder);
+          dw[k] = wz.x*d[k].w[worder].x + wz.y*d[k].w[worder].y;
+        };
+        for(j=0; j<=worder; j++) w[j] = gn[j];
+        ctl = wz.x*w[worder].x + wz.y*w[worder].y;
+        /*/ scale the tau of the wide band filter, normalize its gain as 0dB at CF */
+        dtmp = 2*A*tau-B;
+        taunow = A*tau*tau-B*tau;
+        tx = taunow*2.0/tdres;
+        wc1 = (tx-1)/(tx+1);
+        wc2 = 1.0/(tx+1);
+        tx = taunow*wdf;
+        wgain = pow(1+tx*tx,worder/2.0);
+        for(k=0; k<nder; k++)
+        {
+          dtaunow = dtmp*d[k].tau;
+          coefdual(taunow,dtaunow,tdres,&(d[k].wc1),&(d[k].wc2));
+          d[k].wgain = wgain*worder*tx/(1+tx*tx)*wdf*dtaunow;
+        };
+      }
+      else
+      { /*/ FeedBack_NL : the output of the tuning filter is the control signal */
+        ctl = x1;
+        for(k=0; k<nder; k++) dw[k] = dv[k];
+      };
+
+      /*/ OHC : Boltzman function and low-pass */
+      absx = fabs(ctl);
+      pw = pow(absx,nl->Ccp);
+      xx = nl->Bcp*log(1+nl->Acp*pw);
+      if(ctl<0) xx = -xx;
+      slope = (absx>0) ? nl->Bcp*nl->Acp*nl->Ccp*pw/absx/(1+nl->Acp*pw) : 0.0;
+      e0 = exp(-(xx-nl->x0)/nl->s0);
+      e1 = exp(-(xx-nl->x1)/nl->s1);
+      den = 1.0+e0*(1.0+e1);
+      slope *= lpgain/(1-shift)*(e0*(1.0+e1)/nl->s0+e0*e1/nl->s1)/(den*den);
+      ox = hc[0];
+      nx = hc[0] = lpgain*((1.0/(1.0+exp(-(xx-nl->x0)/nl->s0)*(1.0+exp(-(xx-nl->x1)/nl->s1)))-shift)/(1-shift));
+      for(j=1; j<=lporder; j++)
+      {
+        tx = lpc1*hc[j] + lpc2*(nx+ox);
+        ox = hc[j];
+        hc[j] = nx = tx;
+      };
+      for(k=0; k<nder; k++)
+      {
+        dox = d[k].hc[0];
+        dn = d[k].hc[0] = slope*dw[k];
+        for(j=1; j<=lporder; j++)
+        {
+          dtx = lpc1*d[k].hc[j] + lpc2*(dn+dox);
+          dox = d[k].hc[j];
+          d[k].hc[j] = dn = dtx;
+        };
+      };
+      /*/ nonlinearity after OHC sets tau of the tuning filter */
+      e = exp(-fabs(nx)/ao->s0);
+      tau = aoTauMax*(minR+(1.0-minR)*e);
+      slope = (nx>0) ? -aoTauMax*(1.0-minR)*e/ao->s0 : ((nx<0) ? aoTauMax*(1.0-minR)*e/ao->s0 : 0.0);
+      dtmp = tau*2.0/tdres;
+      c1 = (dtmp-1)/(dtmp+1);
+      c2 = 1.0/(dtmp+1);
+      /*/ Gain Control of the tuning filter */
+      gc = ipow(tau/TauMax,order);
+      dtmp = order*ipow(tau/TauMax,order-1)/TauMax;
+      for(k=0; k<nder; k++)
+      {
+        d[k].tau = slope*d[k].hc[lporder];
+        coefdual(tau,d[k].tau,tdres,&(d[k].c1),&(d[k].c2));
+        dv[k] = dv[k]*gc + x1*dtmp*d[k].tau;
+      };
+      x1 *= gc;
+    }
+    else if(bmmodel==Broad_Linear_High)
+    {
+      x1 *= lingain;
+      for(k=0; k<nder; k++) dv[k] *= lingain;
+    };
+
+    /*/ gfagain, same phasor as the tuning filter */
+    x1 *= again;
+    gtvalue(a,gn,z.x*x1,z.y*x1,ac1,ac2,gorder);
+    for(k=0; k<nder; k++)
+    {
+      dx = again*dv[k];
+      gtdual(a,gn,d[k].a,z.x*dx,z.y*dx,ac1,ac2,0.0,0.0,gorder);
+      dout[i+length*k] = z.x*d[k].a[gorder].x + z.y*d[k].a[gorder].y;
+    };
+    for(j=0; j<=gorder; j++) a[j] = gn[j];
+    out[i] = z.x*a[gorder].x + z.y*a[gorder].y;
+  };
+  nrot += iend-kend;
+  if(nrot==GT_BLOCK)
+  {
+    CRENORM(z);
+    if(bmmodel==FeedForward_NL) CRENORM(wz);
+    nrot = 0;
+  };
+  };
+
+  bf->c_phase = gf->c_phase = z;
+  bf->nrot = gf->nrot = nrot;
+  GTPHASE_ADVANCE(bf,length);
+  GTPHASE_ADVANCE(gf,length);
+  for(j=0; j<=order; j++) bf->gtf[j] = bf->gtfl[j] = g[j];
+  for(j=0; j<=gorder; j++) gf->gtf[j] = gf->gtfl[j] = a[j];
+  if(bmmodel&NonLinear_ALL)
+  {
+    bm->tau = tau;
+    bf->tau = tau;
+    bf->c1LP = c1;
+    bf->c2LP = c2;
+    for(j=0; j<=lporder; j++) lp->hc[j] = lp->hcl[j] = hc[j];
+  };
+  if(bmmodel==FeedForward_NL)
+  {
+    wf->c_phase = wz;
+    wf->nrot = nrot;
+    GTPHASE_ADVANCE(wf,length);
+    wf->tau = taunow;
+    wf->c1LP = wc1;
+    wf->c2LP = wc2;
+    wf->gain = wgain;
+    for(j=0; j<=worder; j++) wf->gtf[j] = wf->gtfl[j] = w[j];
+  };
+}
+
+/*/ runsyn_dynamic with the derivatives, dsyn holds dCI, dCL and dPPI of the last sample per parameter */
+static void syndual(Tsynapse *pthis, const double *in, double *out, double *dout,
+                    const int length, const int nder, double *dsyn)
+{
+  int i,k;
+  double PPIlast,PL,PG,CIlast,CLlast,CG,VI,VL;
+  double tdres;
+  double CInow,CLnow,dCI,dCL,dPPI;
+  double *ds;
+
+  tdres = pthis->tdres;
+  PL = pthis->PL;
+  PG = pthis->PG;
+  CG = pthis->CG;
+  VI = pthis->VI;
+  VL = pthis->VL;
+  CIlast = pthis->CIlast;
+  CLlast = pthis->CLlast;
+  PPIlast = pthis->PPIlast;
+
+  for(i = 0; i<length;i++){
+    CInow = CIlast + (tdres/VI)*((-PPIlast*CIlast)+PL*(CLlast - CIlast));
+    CLnow = CLlast + (tdres/VL)*(-PL*(CLlast-CIlast)+PG*(CG - CLlast));
+    for(k=0; k<nder; k++)
+    {
+      ds = dsyn+3*k;
+      dCI = ds[0] + (tdres/VI)*(-(ds[2]*CIlast+PPIlast*ds[0])+PL*(ds[1]-ds[0]));
+      dCL = ds[1] + (tdres/VL)*(-PL*(ds[1]-ds[0])-PG*ds[1]);
+      dPPI = dout[i+length*k];
+      dout[i+length*k] = dCI*in[i]+CInow*dPPI;
+      ds[0] = dCI; ds[1] = dCL; ds[2] = dPPI;
+    };
+    PPIlast = in[i];
+    CIlast = CInow;
+    CLlast = CLnow;
+    out[i] = CInow*PPIlast;
+  };
+
+  pthis->CIlast = CIlast;
+  pthis->CLlast = CLlast;
+  pthis->PPIlast = PPIlast;
+}
+
+int runAN2Sens(TAuditoryNerve *p, const double *in, const double *din, double *out, double *dout,
+               const int length, const int nder)
+{
+  int i,j,k;
+  TBMDual *d;
+  double *dv,*dw,*dsyn;
+  double x,u,du,tempA,slope,temp;
+  TLowPass lp;
+  const TNonLinear *nl = &(p->ihc.hcnl);
+  const TNonLinear *ppi = &(p->ihcppi);
+
+  if(p->syn.run2!=runsyn_dynamic) return(-1); /*/ full rate only */
+  if(nder<1)
+  {
+    runAN2(p,in,out,length);
+    return(0);
+  };
+  d = (TBMDual*)calloc(nder,sizeof(TBMDual));
+  dv = (double*)calloc(5*nder,sizeof(double));
+  if((d==NULL)||(dv==NULL))
+  {
+    if(d!=NULL) free(d);
+    if(dv!=NULL) free(dv);
+    return(-1);
+  };
+  dw = dv+nder;
+  dsyn = dv+2*nder;
+
+  /*/ basilar membrane */
+  bmdual(&(p->bm),in,din,out,dout,length,nder,d,dv,dw);
+
+  /*/ IHC nonlinearity (runIHCNL): the derivatives at the BM output, then the values */
+  for(i=0; i<length; i++)
+  {
+    x = out[i];
+    if(x>=0)
+      slope = nl->A0*nl->B/(1.0+nl->B*x);
+    else
+    {
+      u = -x;
+      du = pow(u,nl->C);
+      tempA = -nl->A0*(du+nl->D)/(3*du+nl->D);
+      slope = -(2*nl->A0*nl->D/((3*du+nl->D)*(3*du+nl->D))*nl->C*du/u*log(1.0+nl->B*u)
+                +tempA*nl->B/(1.0+nl->B*u));
+    };
+    for(k=0; k<nder; k++) dout[i+length*k] *= slope;
+  };
+  /*/ the IHC low-pass is linear, the derivatives go through a copy starting from rest */
+  lp = p->ihc.hclp;
+  p->ihc.run2(&(p->ihc),out,out,length);
+  for(k=0; k<nder; k++)
+  {
+    for(j=0; j<=lp.Order; j++) lp.hc[j] = lp.hcl[j] = 0.0;
+    lp.run2(&lp,dout+length*k,dout+length*k,length);
+  };
+
+  /*/ IHC-PPI (runIHCPPI2) */
+  for(i=0; i<length; i++)
+  {
+    temp = ppi->p2*out[i];
+    slope = (temp<400) ? ppi->p1*ppi->p2/(1.0+exp(-temp)) : ppi->p1*ppi->p2;
+    for(k=0; k<nder; k++) dout[i+length*k] *= slope;
+  };
+  p->ihcppi.run2(&(p->ihcppi),out,out,length);
+
+  /*/ synapse */
+  syndual(&(p->syn),out,out,dout,length,nder,dsyn);
+
+  free(d);
+  free(dv);
+return(0);
+}
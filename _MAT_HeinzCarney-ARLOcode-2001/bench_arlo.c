@@ -0,0 +1,277 @@
+/*
+ * Per-stage benchmark of the ARLO model (no MATLAB needed).
+ *
+ * For every species, model, CF, tdres and stimulus length of the sweep, a tone at CF
+ * is run through the model once to get the input of every stage, and then each stage
+ * is timed on its own input:
+ *   bm          bm.run2 (the bmkernel.c kernels, or run2BasilarMembrane with -DBM_GENERIC)
+ *   bm_generic  run2BasilarMembrane
+ *   ihc         runHairCell2 (IHC nonlinearity and low-pass)
+ *   ppi         runIHCPPI2
+ *   syn         runsyn_dynamic
+ *   sg          SGmodel2, 'trials' repetitions, counted as length*trials samples
+ *   an          runAN2, the whole fiber
+ * Each stage is run 'reps' times from a freshly initialized state (the initialization
+ * is not timed) and the fastest run is reported.
+ *
+ * The output is CSV, one line per stage and configuration:
+ *   stage,species,model,cf,tdres,length,ns_per_sample,samples_per_sec
+ * Given a baseline (the CSV of an earlier run), every line is compared with the same
+ * stage and configuration of the baseline, and the run fails if a stage got slower
+ * by more than the threshold (a fraction, 0.1 = 10% more ns per sample).
+ *
+ * Build and run:
+ *   cc -O3 -fopenmp -o bench_arlo bench_arlo.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c spikes.c -lm
+ *   (add -fopenmp to time the parallel spike generator)
+ *   ./bench_arlo [-species 1] [-model 1,2,3,4,5] [-cf 500,2000,8000] [-tdres 1e-5,2e-6]
+ *                [-length 20000,200000] [-level 60] [-reps 5] [-trials 10]
+ *                [-o out.csv] [-baseline old.csv] [-threshold 0.1]
+ * Returns 0, or 1 if a stage regressed beyond the threshold.
+ */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cmpa.h"
+#include "spikes.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define MAXLIST 16
+#define MAXBASE 4096
+#define NSTAGE 7
+
+void run2BasilarMembrane(TBasilarMembrane *bm, const double *in, double *out, const int length);
+
+static const char *stagename[NSTAGE] = {"bm","bm_generic","ihc","ppi","syn","sg","an"};
+
+/*/ wall clock in sec */
+static double now(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER f,c;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&c);
+  return((double)c.QuadPart/(double)f.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return(ts.tv_sec+1e-9*ts.tv_nsec);
+#endif
+}
+
+/*/ comma separated list of numbers, returns the count */
+static int parselist(const char *s, double *list)
+{
+  int n = 0;
+  char *end;
+  while((*s)&&(n<MAXLIST))
+  {
+    list[n++] = strtod(s,&end);
+    if(end==s) return(n-1);
+    s = end;
+    if(*s==',') s++;
+  };
+  return(n);
+}
+
+typedef struct {
+  char stage[32];
+  int species,model,length;
+  double cf,tdres,nsps;
+} TBaseline;
+
+static int readbaseline(const char *fname, TBaseline *base)
+{
+  FILE *fp;
+  char line[256];
+  int n = 0;
+  double sps;
+  if((fp=fopen(fname,"r"))==NULL) return(-1);
+  while((n<MAXBASE)&&(fgets(line,sizeof(line),fp)!=NULL))
+  {
+    if(sscanf(line,"%31[^,],%d,%d,%lf,%lf,%d,%lf,%lf",base[n].stage,&base[n].species,
+              &base[n].model,&base[n].cf,&base[n].tdres,&base[n].length,&base[n].nsps,&sps)==8)
+      n++;
+  };
+  fclose(fp);
+  return(n);
+}
+
+static int samevalue(double a, double b) { return(fabs(a-b)<=1e-9*fabs(b)); }
+
+static const TBaseline *findbaseline(const TBaseline *base, int nbase, const char *stage,
+                                     int species, int model, double cf, double tdres, int length)
+{
+  int i;
+  for(i=0; i<nbase; i++)
+    if((strcmp(base[i].stage,stage)==0)&&(base[i].species==species)&&(base[i].model==model)
+       &&samevalue(cf,base[i].cf)&&samevalue(tdres,base[i].tdres)&&(base[i].length==length))
+      return(base+i);
+  return(NULL);
+}
+
+/*/ Time one pass of stage over length samples, from a fresh state */
+static double timestage(int stage, int model, int species, double tdres, double cf, int length,
+                        const double *stim, const double *bmout, const double *ihcout,
+                        const double *ppiout, const double *sout, double *out, int trials)
+{
+  TAuditoryNerve anf;
+  double t0,t1,*sptime,*trial;
+  anf.ifspike = 0;
+  initAuditoryNerve(&anf,model,species,tdres,cf,50.0);
+  t0 = now();
+  switch(stage)
+  {
+  case 0: anf.bm.run2(&(anf.bm),stim,out,length); break;
+  case 1: run2BasilarMembrane(&(anf.bm),stim,out,length); break;
+  case 2: anf.ihc.run2(&(anf.ihc),bmout,out,length); break;
+  case 3: anf.ihcppi.run2(&(anf.ihcppi),ihcout,out,length); break;
+  case 4: anf.syn.run2(&(anf.syn),ppiout,out,length); break;
+  case 5:
+    if(SGmodel2(tdres,sout,length,trials,12345,&sptime,&trial)>=0)
+    {
+      free(sptime); free(trial);
+    };
+    break;
+  case 6: anf.run2(&anf,stim,out,length); break;
+  };
+  t1 = now();
+  return(t1-t0);
+}
+
+int main(int argc, char *argv[])
+{
+  double species[MAXLIST],models[MAXLIST],cfs[MAXLIST],tdress[MAXLIST],lengths[MAXLIST];
+  int nspecies,nmodel,ncf,ntdres,nlength;
+  double level = 60, threshold = 0.1;
+  int reps = 5, trials = 10;
+  const char *outname = NULL, *basename = NULL;
+  TBaseline *base = NULL;
+  int nbase = 0;
+  FILE *fp = stdout;
+  int is,im,ic,it,il,stage,r,i,length,nregress;
+  double tdres,cf,amp,t,best,nsamples,nsps;
+  double *stim,*bmout,*ihcout,*ppiout,*sout,*out;
+  const TBaseline *b;
+  TAuditoryNerve anf;
+
+  species[0] = 1; nspecies = 1;
+  nmodel = parselist("1,2,3,4,5",models);
+  ncf = parselist("500,2000,8000",cfs);
+  ntdres = parselist("1e-5,2e-6",tdress);
+  nlength = parselist("20000,200000",lengths);
+  for(i=1; i<argc; i++)
+  {
+    if((argv[i][0]!='-')||(i+1>=argc))
+    {
+      fprintf(stderr,"usage: %s [-species list] [-model list] [-cf list] [-tdres list] [-length list]\n"
+              "       [-level dB] [-reps n] [-trials n] [-o out.csv] [-baseline old.csv] [-threshold frac]\n",argv[0]);
+      return(2);
+    };
+    if(strcmp(argv[i],"-species")==0) nspecies = parselist(argv[++i],species);
+    else if(strcmp(argv[i],"-model")==0) nmodel = parselist(argv[++i],models);
+    else if(strcmp(argv[i],"-cf")==0) ncf = parselist(argv[++i],cfs);
+    else if(strcmp(argv[i],"-tdres")==0) ntdres = parselist(argv[++i],tdress);
+    else if(strcmp(argv[i],"-length")==0) nlength = parselist(argv[++i],lengths);
+    else if(strcmp(argv[i],"-level")==0) level = atof(argv[++i]);
+    else if(strcmp(argv[i],"-reps")==0) reps = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-trials")==0) trials = atoi(argv[++i]);
+    else if(strcmp(argv[i],"-o")==0) outname = argv[++i];
+    else if(strcmp(argv[i],"-baseline")==0) basename = argv[++i];
+    else if(strcmp(argv[i],"-threshold")==0) threshold = atof(argv[++i]);
+    else { fprintf(stderr,"unknown option %s\n",argv[i]); return(2); };
+  };
+  if(reps<1) reps = 1;
+  if(trials<1) trials = 1;
+
+  if(basename!=NULL)
+  {
+    base = (TBaseline*)malloc(sizeof(TBaseline)*MAXBASE);
+    if((base==NULL)||((nbase=readbaseline(basename,base))<0))
+    {
+      fprintf(stderr,"cannot read the baseline %s\n",basename);
+      return(2);
+    };
+  };
+  if((outname!=NULL)&&((fp=fopen(outname,"w"))==NULL))
+  {
+    fprintf(stderr,"cannot write %s\n",outname);
+    return(2);
+  };
+
+  fprintf(fp,"stage,species,model,cf,tdres,length,ns_per_sample,samples_per_sec\n");
+  nregress = 0;
+  for(il=0; il<nlength; il++)
+  {
+    length = (int)lengths[il];
+    if(length<1) continue;
+    stim = (double*)malloc(sizeof(double)*length);
+    bmout = (double*)malloc(sizeof(double)*length);
+    ihcout = (double*)malloc(sizeof(double)*length);
+    ppiout = (double*)malloc(sizeof(double)*length);
+    sout = (double*)malloc(sizeof(double)*length);
+    out = (double*)malloc(sizeof(double)*length);
+    if((stim==NULL)||(bmout==NULL)||(ihcout==NULL)||(ppiout==NULL)||(sout==NULL)||(out==NULL))
+    {
+      fprintf(stderr,"out of memory, length %d\n",length);
+      return(2);
+    };
+    for(it=0; it<ntdres; it++)
+    for(ic=0; ic<ncf; ic++)
+    for(is=0; is<nspecies; is++)
+    for(im=0; im<nmodel; im++)
+    {
+      tdres = tdress[it];
+      cf = cfs[ic];
+      /*/ tone at cf, then the input of every stage */
+      amp = 20e-6*pow(10,level/20.0)*sqrt(2.0);
+      for(i=0; i<length; i++) stim[i] = amp*sin(TWOPI*cf*i*tdres);
+      anf.ifspike = 0;
+      initAuditoryNerve(&anf,(int)models[im],(int)species[is],tdres,cf,50.0);
+      anf.bm.run2(&(anf.bm),stim,bmout,length);
+      anf.ihc.run2(&(anf.ihc),bmout,ihcout,length);
+      anf.ihcppi.run2(&(anf.ihcppi),ihcout,ppiout,length);
+      anf.syn.run2(&(anf.syn),ppiout,sout,length);
+
+      for(stage=0; stage<NSTAGE; stage++)
+      {
+        best = 0;
+        for(r=0; r<reps; r++)
+        {
+          t = timestage(stage,(int)models[im],(int)species[is],tdres,cf,length,
+                        stim,bmout,ihcout,ppiout,sout,out,trials);
+          if((r==0)||(t<best)) best = t;
+        };
+        nsamples = (stage==5) ? (double)length*trials : (double)length;
+        if(best<=0) best = 1e-9;
+        nsps = 1e9*best/nsamples;
+        fprintf(fp,"%s,%d,%d,%g,%g,%d,%.4f,%.6g\n",stagename[stage],(int)species[is],
+                (int)models[im],cf,tdres,length,nsps,nsamples/best);
+        fflush(fp);
+        b = findbaseline(base,nbase,stagename[stage],(int)species[is],(int)models[im],cf,tdres,length);
+        if((b!=NULL)&&(nsps>b->nsps*(1+threshold)))
+        {
+          fprintf(stderr,"REGRESSION %s species %d model %d cf %g tdres %g length %d: "
+                  "%.4f ns/sample, baseline %.4f (+%.1f%%)\n",stagename[stage],(int)species[is],
+                  (int)models[im],cf,tdres,length,nsps,b->nsps,100*(nsps/b->nsps-1));
+          nregress++;
+        };
+      };
+    };
+    free(stim); free(bmout); free(ihcout); free(ppiout); free(sout); free(out);
+  };
+  if(fp!=stdout) fclose(fp);
+  if(base!=NULL)
+  {
+    free(base);
+    fprintf(stderr,"%d regressions beyond %.0f%%\n",nregress,100*threshold);
+  };
+  return((nregress>0) ? 1 : 0);
+}
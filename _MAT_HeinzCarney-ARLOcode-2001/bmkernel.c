@@ -0,0 +1,326 @@
+/*
+ * Specialized basilar membrane kernels
+ *
+ * run2BasilarMembrane calls the tuning filter, the wide band filter, the OHC and
+ * the AfterOHC nonlinearity through function pointers on every sample, switches
+ * on bmmodel and calls pow() for the gain of the tuning filter. Here the whole
+ * control path is written out in one loop (bmkernel), and the model type and the
+ * order of the tuning filter are compile-time constants of each instance, so the
+ * compiler drops the unused branches, unrolls the gammatone cascade and keeps the
+ * filter state in registers. The integer powers are done by multiplication.
+ * The frequency-shift phasors are advanced by complex multiplication and put back
+ * on the unit circle every GT_BLOCK samples; gfagain shares the phasor of the
+ * tuning filter and runs in the same loop.
+ *
+ * run2BasilarMembraneFast picks the instance for bm->bmmodel and bm->bmorder;
+ * if there is none, or any of the filters has been given another run function,
+ * it falls back to run2BasilarMembrane. The results agree with
+ * run2BasilarMembrane to rounding (see test_bmkernel.c).
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "cmpa.h"
+
+#if defined(_MSC_VER)
+#define BM_INLINE static __forceinline
+#elif defined(__GNUC__)
+#define BM_INLINE static __inline__ __attribute__((always_inline))
+#else
+#define BM_INLINE static
+#endif
+
+/*/ order of the wide band filter, gfagain and the OHC low-pass, as set in initBasilarMembrane */
+#define BM_WBORDER 3
+#define BM_GFORDER 1
+#define BM_OHCLPORDER 3
+
+double runGammaTone(TGammaTone *p, double x);
+void runGammaTone2(TGammaTone *p, const double *in, double *out, const int length);
+void setGammaToneTau(TGammaTone *p, double tau);
+double runLowPass(TLowPass *p, double x);
+void run2BasilarMembrane(TBasilarMembrane *bm, const double *in, double *out, const int length);
+
+/*/ x^n for small constant n */
+BM_INLINE double ipow(double x, const int n)
+{
+  double y = 1.0;
+  int i;
+  for(i=0; i<n; i++) y *= x;
+  return(y);
+}
+
+/*/ x^(n/2) for small constant n */
+BM_INLINE double ipowhalf(double x, const int n)
+{
+  if(n&1) return(ipow(x,n/2)*sqrt(x));
+  return(ipow(x,n/2));
+}
+
+BM_INLINE void bmkernel(TBasilarMembrane *bm, const double *in, double *out, const int length,
+                        const int bmmodel, const int order)
+{
+  register int i,j;
+  int k,iend,nrot;
+  TGammaTone *bf = &(bm->bmfilter);
+  TGammaTone *wf = &(bm->wbfilter);
+  TGammaTone *gf = &(bm->gfagain);
+  TLowPass *lp = &(bm->ohc.hclp);
+  const TNonLinear *nl = &(bm->ohc.hcnl);
+  const TNonLinear *ao = &(bm->afterohc);
+  COMPLEX g[MAX_ORDER+1],w[BM_WBORDER+1],a[BM_GFORDER+1];
+  COMPLEX z,wz,c;
+  double hc[BM_OHCLPORDER+1];
+  double x,x1,xx,ctl,nx,ny,ox,oy,tx,ty,dtmp;
+  /*/ tuning filter */
+  const COMPLEX dz = bf->c_delta;
+  const double gain = bf->gain;
+  double c1 = bf->c1LP;
+  double c2 = bf->c2LP;
+  /*/ gfagain */
+  const double again = gf->gain;
+  const double ac1 = gf->c1LP;
+  const double ac2 = gf->c2LP;
+  /*/ wide band filter */
+  const COMPLEX wdz = wf->c_delta;
+  double wgain = wf->gain;
+  double wc1 = wf->c1LP;
+  double wc2 = wf->c2LP;
+  double taunow = wf->tau;
+  const double wdf = TWOPI*(wf->F_shift-bf->F_shift);
+  /*/ control path */
+  double tau = bm->tau;
+  const double tdres = bm->tdres;
+  const double TauMax = bm->TauMax;
+  const double A = bm->A;
+  const double B = bm->B;
+  const double lingain = ipow(bm->TauMin/bm->TauMax,order);
+  const double lpc1 = lp->c1LP;
+  const double lpc2 = lp->c2LP;
+  const double lpgain = lp->gain;
+  const double shift = nl->shift;
+  const double minR = ao->minR;
+  const double aoTauMax = ao->TauMax;
+  double *tautap = bm->tautap;
+
+  z = bf->c_phase;
+  wz = wf->c_phase;
+  for(j=0; j<=order; j++) g[j] = bf->gtf[j];
+  for(j=0; j<=BM_GFORDER; j++) a[j] = gf->gtf[j];
+  for(j=0; j<=BM_WBORDER; j++) w[j] = wf->gtf[j];
+  for(j=0; j<=BM_OHCLPORDER; j++) hc[j] = lp->hc[j];
+
+  /*/ the blocks end where the phasor is renormalized, GT_BLOCK samples apart from the start */
+  nrot = bf->nrot;
+  for(k=0; k<length; k=iend)
+  {
+  iend = (length-k<GT_BLOCK-nrot) ? length : k+GT_BLOCK-nrot;
+  for(i=k; i<iend; i++)
+  {
+    x = in[i];
+    /*/ pass the signal through the tuning filter */
+    CMULT(c,z,dz);
+    z = c;
+    x1 = gain*x;
+    nx = z.x*x1;
+    ny = z.y*x1;
+    ox = g[0].x; oy = g[0].y;
+    g[0].x = nx; g[0].y = ny;
+    for(j=1; j<=order; j++)
+    {
+      tx = g[j].x*c1 + (nx+ox)*c2;
+      ty = g[j].y*c1 + (ny+oy)*c2;
+      ox = g[j].x; oy = g[j].y;
+      g[j].x = nx = tx;
+      g[j].y = ny = ty;
+    };
+    x1 = z.x*nx + z.y*ny;
+
+    if(bmmodel&NonLinear_ALL)
+    {
+      if(bmmodel==FeedForward_NL)
+      { /*/ the wide-band pass is the control signal */
+        CMULT(c,wz,wdz);
+        wz = c;
+        xx = wgain*x;
+        nx = wz.x*xx;
+        ny = wz.y*xx;
+        ox = w[0].x; oy = w[0].y;
+        w[0].x = nx; w[0].y = ny;
+        for(j=1; j<=BM_WBORDER; j++)
+        {
+          tx = w[j].x*wc1 + (nx+ox)*wc2;
+          ty = w[j].y*wc1 + (ny+oy)*wc2;
+          ox = w[j].x; oy = w[j].y;
+          w[j].x = nx = tx;
+          w[j].y = ny = ty;
+        };
+        ctl = wz.x*nx + wz.y*ny;
+        /*/ scale the tau of the wide band filter, normalize its gain as 0dB at CF */
+        taunow = A*tau*tau-B*tau;
+        dtmp = taunow*2.0/tdres;
+        wc1 = (dtmp-1)/(dtmp+1);
+        wc2 = 1.0/(dtmp+1);
+        dtmp = taunow*wdf;
+        wgain = ipowhalf(1+dtmp*dtmp,BM_WBORDER);
+      }
+      else /*/ FeedBack_NL : the output of the tuning filter is the control signal */
+        ctl = x1;
+
+      /*/ OHC : Boltzman function and low-pass */
+      xx = nl->Bcp*log(1+nl->Acp*pow(fabs(ctl),nl->Ccp));
+      if(ctl<0) xx = -xx;
+      ox = hc[0];
+      nx = hc[0] = lpgain*((1.0/(1.0+exp(-(xx-nl->x0)/nl->s0)*(1.0+exp(-(xx-nl->x1)/nl->s1)))-shift)/(1-shift));
+      for(j=1; j<=BM_OHCLPORDER; j++)
+      {
+        tx = lpc1*hc[j] + lpc2*(nx+ox);
+        ox = hc[j];
+        hc[j] = nx = tx;
+      };
+      /*/ nonlinearity after OHC sets tau of the tuning filter */
+      tau = aoTauMax*(minR+(1.0-minR)*exp(-fabs(nx)/ao->s0));
+      dtmp = tau*2.0/tdres;
+      c1 = (dtmp-1)/(dtmp+1);
+      c2 = 1.0/(dtmp+1);
+      /*/ Gain Control of the tuning filter */
+      x1 *= ipow(tau/TauMax,order);
+    }
+    else if(bmmodel==Broad_Linear_High)
+      x1 *= lingain;
+
+    /*/ gfagain, same phasor as the tuning filter */
+    x1 *= again;
+    nx = z.x*x1;
+    ny = z.y*x1;
+    ox = a[0].x; oy = a[0].y;
+    a[0].x = nx; a[0].y = ny;
+    for(j=1; j<=BM_GFORDER; j++)
+    {
+      tx = a[j].x*ac1 + (nx+ox)*ac2;
+      ty = a[j].y*ac1 + (ny+oy)*ac2;
+      ox = a[j].x; oy = a[j].y;
+      a[j].x = nx = tx;
+      a[j].y = ny = ty;
+    };
+    out[i] = z.x*nx + z.y*ny;
+    if(tautap!=NULL) tautap[i] = tau;
+  };
+  nrot += iend-k;
+  if(nrot==GT_BLOCK)
+  {
+    CRENORM(z);
+    if(bmmodel==FeedForward_NL) CRENORM(wz);
+    nrot = 0;
+  };
+  };
+
+  bf->c_phase = gf->c_phase = z;
+  bf->nrot = gf->nrot = nrot;
+  GTPHASE_ADVANCE(bf,length);
+  GTPHASE_ADVANCE(gf,length);
+  for(j=0; j<=order; j++) bf->gtf[j] = bf->gtfl[j] = g[j];
+  for(j=0; j<=BM_GFORDER; j++) gf->gtf[j] = gf->gtfl[j] = a[j];
+  if(bmmodel&NonLinear_ALL)
+  {
+    bm->tau = tau;
+    bf->tau = tau;
+    bf->c1LP = c1;
+    bf->c2LP = c2;
+    for(j=0; j<=BM_OHCLPORDER; j++) lp->hc[j] = lp->hcl[j] = hc[j];
+  };
+  if(bmmodel==FeedForward_NL)
+  {
+    wf->c_phase = wz;
+    wf->nrot = nrot;
+    GTPHASE_ADVANCE(wf,length);
+    wf->tau = taunow;
+    wf->c1LP = wc1;
+    wf->c2LP = wc2;
+    wf->gain = wgain;
+    for(j=0; j<=BM_WBORDER; j++) wf->gtf[j] = wf->gtfl[j] = w[j];
+  };
+}
+
+/*/ one instance per model type and order of the tuning filter */
+#define BM_INSTANCE(name,bmmodel,order) \
+static void name(TBasilarMembrane *bm, const double *in, double *out, const int length) \
+{ bmkernel(bm,in,out,length,bmmodel,order); }
+
+BM_INSTANCE(run2BM_FeedForward_NL_1,FeedForward_NL,1)
+BM_INSTANCE(run2BM_FeedForward_NL_2,FeedForward_NL,2)
+BM_INSTANCE(run2BM_FeedForward_NL_3,FeedForward_NL,3)
+BM_INSTANCE(run2BM_FeedForward_NL_4,FeedForward_NL,4)
+BM_INSTANCE(run2BM_FeedBack_NL_1,FeedBack_NL,1)
+BM_INSTANCE(run2BM_FeedBack_NL_2,FeedBack_NL,2)
+BM_INSTANCE(run2BM_FeedBack_NL_3,FeedBack_NL,3)
+BM_INSTANCE(run2BM_FeedBack_NL_4,FeedBack_NL,4)
+BM_INSTANCE(run2BM_Broad_Linear_High_1,Broad_Linear_High,1)
+BM_INSTANCE(run2BM_Broad_Linear_High_2,Broad_Linear_High,2)
+BM_INSTANCE(run2BM_Broad_Linear_High_3,Broad_Linear_High,3)
+BM_INSTANCE(run2BM_Broad_Linear_High_4,Broad_Linear_High,4)
+
+/*/ the linear models have no control path, the tuning filter and gfagain run as one batch */
+static void run2BM_Linear(TBasilarMembrane *bm, const double *in, double *out, const int length)
+{
+  TGammaTone *gt[2];
+  const double *gtin[2];
+  double *gtout[2];
+  int i;
+  gt[0] = &(bm->bmfilter); gtin[0] = in;  gtout[0] = out;
+  gt[1] = &(bm->gfagain);  gtin[1] = out; gtout[1] = out;
+  runGammaToneBatch(gt,2,gtin,gtout,length);
+  if(bm->tautap!=NULL) for(i=0; i<length; i++) bm->tautap[i] = bm->tau;
+}
+
+#define BM_MAXORDER 4
+typedef void (*TBMKernel)(TBasilarMembrane *bm, const double *in, double *out, const int length);
+static const struct { int bmmodel; TBMKernel run2[BM_MAXORDER]; } bmkernels[] = {
+  {FeedForward_NL,{run2BM_FeedForward_NL_1,run2BM_FeedForward_NL_2,run2BM_FeedForward_NL_3,run2BM_FeedForward_NL_4}},
+  {FeedBack_NL,{run2BM_FeedBack_NL_1,run2BM_FeedBack_NL_2,run2BM_FeedBack_NL_3,run2BM_FeedBack_NL_4}},
+  {Sharp_Linear,{run2BM_Linear,run2BM_Linear,run2BM_Linear,run2BM_Linear}},
+  {Broad_Linear,{run2BM_Linear,run2BM_Linear,run2BM_Linear,run2BM_Linear}},
+  {Broad_Linear_High,{run2BM_Broad_Linear_High_1,run2BM_Broad_Linear_High_2,run2BM_Broad_Linear_High_3,run2BM_Broad_Linear_High_4}}
+};
+
+/** Return the specialized kernel for this basilar membrane,
+    NULL if the generic run2BasilarMembrane has to be used
+ */
+static TBMKernel getBMKernel(const TBasilarMembrane *bm)
+{
+  int k;
+  const int order = bm->bmfilter.Order;
+  if((order<1)||(order>BM_MAXORDER)) return(NULL);
+  if((bm->bmfilter.run!=runGammaTone)||(bm->bmfilter.settau!=setGammaToneTau)) return(NULL);
+  /*/ gfagain runs in the same loop, on the phasor of the tuning filter */
+  if((bm->gfagain.run2!=runGammaTone2)||(bm->gfagain.Order!=BM_GFORDER)) return(NULL);
+  if((bm->gfagain.delta_phase!=bm->bmfilter.delta_phase)||(bm->gfagain.nrot!=bm->bmfilter.nrot)
+     ||(bm->gfagain.c_phase.x!=bm->bmfilter.c_phase.x)||(bm->gfagain.c_phase.y!=bm->bmfilter.c_phase.y))
+    return(NULL);
+  if(bm->bmmodel&NonLinear_ALL)
+  {
+    if((bm->ohc.run!=runHairCell)||(bm->ohc.hcnl.run!=runBoltzman)||(bm->afterohc.run!=runAfterOhcNL))
+      return(NULL);
+    if((bm->ohc.hclp.run!=runLowPass)||(bm->ohc.hclp.Order!=BM_OHCLPORDER)) return(NULL);
+  };
+  if(bm->bmmodel==FeedForward_NL)
+  {
+    if((bm->wbfilter.run!=runGammaTone)||(bm->wbfilter.settau!=setGammaToneTau)) return(NULL);
+    if(bm->wbfilter.Order!=BM_WBORDER) return(NULL);
+    /*/ both phasors are renormalized at the same samples */
+    if(bm->wbfilter.nrot!=bm->bmfilter.nrot) return(NULL);
+  };
+  for(k=0; k<(int)(sizeof(bmkernels)/sizeof(bmkernels[0])); k++)
+    if(bmkernels[k].bmmodel==bm->bmmodel) return(bmkernels[k].run2[order-1]);
+  return(NULL);
+}
+
+void run2BasilarMembraneFast(TBasilarMembrane *bm, const double *in, double *out, const int length)
+{
+  TBMKernel run2 = getBMKernel(bm);
+  if(run2==NULL)
+  {
+    run2BasilarMembrane(bm,in,out,length);
+    return;
+  };
+  run2(bm,in,out,length);
+}
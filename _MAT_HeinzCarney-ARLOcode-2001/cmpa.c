@@ -51,6 +51,8 @@ void initAuditoryNerve(TAuditoryNerve *p,int model, int species, double tdres, d
 
   p->run = runAN;
   p->run2 = runAN2;
+  p->decim = 1;
+  initDecimator(&(p->dec),1);
   /*
    * Init the basilar membrane
    * */
@@ -187,6 +189,87 @@ void runAN2(TAuditoryNerve *p,const double *in,double *out,const int length)
 return;
 }
 
+int runAN2Taps(TAuditoryNerve *p, const double *in, double *bmout, double *tauout,
+               double *ihcout, double *ppiout, double *sout, const int length)
+{
+  double *buf = NULL;
+  double *x,*y;
+  /*/ the stages without a tap run in place in one scratch buffer */
+  if((bmout==NULL)||(ihcout==NULL)||(ppiout==NULL)||(sout==NULL))
+  {
+    buf = (double*)malloc(sizeof(double)*((length>0) ? length : 1));
+    if(buf==NULL) return(-1);
+  };
+  x = (bmout!=NULL) ? bmout : buf;
+  p->bm.tautap = tauout;
+  p->bm.run2(&(p->bm),in,x,length);
+  p->bm.tautap = NULL;
+  y = (ihcout!=NULL) ? ihcout : buf;
+  p->ihc.run2(&(p->ihc),x,y,length);
+  x = (ppiout!=NULL) ? ppiout : buf;
+  p->ihcppi.run2(&(p->ihcppi),y,x,length);
+  y = (sout!=NULL) ? sout : buf;
+  p->syn.run2(&(p->syn),x,y,length);
+  if(buf!=NULL) free(buf);
+return(0);
+}
+
+/*
+ * Multirate mode
+ * The IHC output is low-pass filtered at 3.8-4.5kHz (7th order), so the IHC-PPI and the
+ * synapse, whose time constants are 1ms and longer, can run at a much lower rate.
+ * The synapse is integrated with the step tdres*decim (the Euler step of runsyn_dynamic).
+ * */
+void setAuditoryNerveDecimation(TAuditoryNerve *p, int decim)
+{
+  initDecimator(&(p->dec),decim);
+  p->decim = p->dec.factor;
+  p->syn.tdres = p->tdres*p->decim;
+  if(p->decim>1) p->syn.run2 = runsyn_dynamic_coarse;
+  else p->syn.run2 = runsyn_dynamic;
+return;
+}
+
+int runAN2Decimated(TAuditoryNerve *p, const double *in, double *out, const int length, int ifdecout)
+{
+  int m,n,M;
+  double *sout,*x;
+  M = p->decim;
+  if(M<=1)
+  {
+    runAN2(p,in,out,length);
+    return(length);
+  };
+  n = (length+M-1)/M;
+  sout = (double*)malloc(sizeof(double)*n);
+  if(sout==NULL) return(-1);
+  /*/ with ifdecout, out only has room for the n decimated samples */
+  x = out;
+  if(ifdecout) x = (double*)malloc(sizeof(double)*length);
+  if(x==NULL)
+  {
+    free(sout);
+    return(-1);
+  };
+
+  p->bm.run2(&(p->bm),in,x,length);
+  p->ihc.run2(&(p->ihc),x,x,length);
+  p->dec.run2(&(p->dec),x,sout,length);
+  p->ihcppi.run2(&(p->ihcppi),sout,sout,n);
+  p->syn.run2(&(p->syn),sout,sout,n);
+
+  if(ifdecout)
+  {
+    for(m=0; m<n; m++) out[m] = sout[m];
+    free(x); free(sout);
+    return(n);
+  };
+  /*/ band-limited interpolation back to tdres */
+  p->dec.interp2(&(p->dec),sout,out,length);
+  free(sout);
+return(length);
+}
+
 /* User Get_Tau, initGammaTone, initBoltzman*/
 void initBasilarMembrane(TBasilarMembrane* bm,int model, int species, double tdres, double cf)
 { /*
@@ -213,14 +296,20 @@ void initBasilarMembrane(TBasilarMembrane* bm,int model, int species, double tdr
   else if(model == 3) bmmodel = Sharp_Linear;
   else if(model == 4) bmmodel = Broad_Linear;
   else if(model == 5) bmmodel = Broad_Linear_High;
+  else bmmodel = Sharp_Linear; /* not a model number, run it linear */
   bm->bmmodel = bmmodel;
   bm->tdres = tdres;
+  bm->tautap = NULL;
 
   /*
    *  Determine taumax,taumin,order here
    */
   bm->run = runBasilarMembrane;
+#ifdef BM_GENERIC
   bm->run2 = run2BasilarMembrane;
+#else
+  bm->run2 = run2BasilarMembraneFast; /* falls back to run2BasilarMembrane if not specialized */
+#endif
 
   bm->bmorder = 3;
   Get_tau(species,cf,bm->bmorder,&taumax,&taumin,&taurange);
@@ -349,6 +438,7 @@ void run2BasilarMembrane(TBasilarMembrane *bm, const double *in, double *out, co
               	break;
 	  };
 	  out[i] = out1;
+	  if(bm->tautap!=NULL) bm->tautap[i] = bm->tau;
   };
   bm->gfagain.run2(&(bm->gfagain),out,out,length);
 
@@ -393,6 +483,7 @@ double Get_tau(int species, double cf,int order, double* _taumax,double* _taumin
       taumax =  1./(TWOPI*1.019*erbGM(cf));
       break;
     case 9:
+    default:
       /* Universal species from data fitting : From Xuedong Zhang,Ian (JASA 2001) */
       /* the Q10 determine the taumax(bandwidths at low level) Based on Cat*/
       Q10 = pow(10,0.4708*log10(cf/1e3)+0.4664);
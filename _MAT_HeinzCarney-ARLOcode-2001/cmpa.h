@@ -27,8 +27,41 @@ double cochlea_x2f(int species,double x);
 double runAN(TAuditoryNerve* p,double x);
 void runAN2(TAuditoryNerve *p, const double *in, double *out, const int length);
 
+/* Set p->ifspike before the call. Reentrant: it only writes into *p (no static or global
+   state), so fibers can be initialized and run on several threads at once (anbatch.c) */
 void initAuditoryNerve(TAuditoryNerve *p,int model, int species, double tdres, double cf, double spont);
+/* initAuditoryNerve through a cache of initialized fibers (ancache.c), keyed by
+   (model,species,tdres,cf,spont,p->ifspike): a fiber seen before is a copy of the stored one,
+   the same as initAuditoryNerve bit for bit. Thread-safe among OpenMP threads */
+void initAuditoryNerveCached(TAuditoryNerve *p,int model, int species, double tdres, double cf, double spont);
+/* free the cached fibers and reset the counts */
+void clearAuditoryNerveCache(void);
+/* fibers in the cache, and the calls that found (hits) or added (misses) a fiber */
+void getAuditoryNerveCacheStats(long *nfibers, long *hits, long *misses);
+/* Multirate mode: after the IHC low-pass, the signal is decimated by decim (1..DEC_MAXFACTOR)
+   and the IHC-PPI and the synapse run at tdres*decim. Call after initAuditoryNerve.
+   Larger factors are clamped to DEC_MAXFACTOR; decim 1 restores the full-rate synapse */
+void setAuditoryNerveDecimation(TAuditoryNerve *p, int decim);
+/* Run the fiber in multirate mode on a whole stimulus.
+   If ifdecout, out gets the (length+decim-1)/decim samples of sout at tdres*decim,
+   otherwise sout is interpolated back to tdres and out gets length samples.
+   Returns the number of output samples, -1 if out of memory */
+int runAN2Decimated(TAuditoryNerve *p, const double *in, double *out, const int length, int ifdecout);
+/* runAN2 with every stage kept: the BM output, the tau of the tuning filter (control path),
+   the IHC output, the IHC-PPI and sout, each of length samples, in one pass.
+   Any of them can be NULL. Full rate only (decim 1). Returns 0, -1 if out of memory */
+int runAN2Taps(TAuditoryNerve *p, const double *in, double *bmout, double *tauout,
+               double *ihcout, double *ppiout, double *sout, const int length);
+/* Forward-mode sensitivity (ansens.c): runAN2 that also gives the derivatives of sout with
+   respect to nder parameters of the stimulus, in one pass. din[i+length*k] is the derivative
+   of in[i] with respect to parameter k (e.g. in[i] for the input scale, in[i]*log(10)/20 for
+   the level in dB), dout[i+length*k] gets the derivative of out[i]. Full rate only (decim 1).
+   Returns 0, -1 if out of memory or decimated */
+int runAN2Sens(TAuditoryNerve *p, const double *in, const double *din, double *out, double *dout,
+               const int length, const int nder);
 void initBasilarMembrane(TBasilarMembrane* bm,int model, int species, double tdres, double cf);
+/* Same as bm->run2 with the default filters, but specialized per model type and filter order (bmkernel.c) */
+void run2BasilarMembraneFast(TBasilarMembrane *bm, const double *in, double *out, const int length);
 
 /*/############################################################################## */
 
@@ -58,6 +91,8 @@ struct __BasilarMembrane{ /* class of basilar membrane */
   TGammaTone wbfilter; /*/Control Path filter */
   THairCell ohc;
   TNonLinear afterohc;
+  /* If not NULL, run2 stores the tau of the tuning filter after every sample here */
+  double *tautap;
 };
 
 /** Class of the auditory nerve fiber, this is a complete model of the fiber
@@ -78,12 +113,15 @@ struct __AuditoryNerve{
   THairCell ihc;
   TNonLinear ihcppi; /*/From ihc->ppi */
   Tsynapse syn;
+  TDecimator dec; /*/From ihc to ihcppi, used by runAN2Decimated */
 /*/  TSpikeGenerator sg; */
 /*/ Model Parameters */
   double tdres,cf,spont;
   int species,model;
   /* This parameter indicates if we are using sout only or spikes */
   int ifspike;
+  /* Decimation factor of the IHC output, 1 runs the whole model at tdres */
+  int decim;
 };
 
 #endif
@@ -4,7 +4,35 @@
 %
 % This creates the matlab function: an_arlo, which creates the sypnapse output
 %    in response to an arbitrary input stimulus, scaled in pascals.
-mex an_arlo.c runmodel.c cmpa.c hc.c complex.c filters.c synapse.c
+%    The basilar membrane uses the specialized kernels in bmkernel.c; add -DBM_GENERIC
+%    to use the original run2BasilarMembrane. test_bmkernel.c checks that both agree.
+%    With para(7:8) = [decim,ifdecout], the IHC-PPI and the synapse run at tdres*decim;
+%    test_multirate.c compares this with the full-rate output.
+%    an_arlo('create'/'process'/'reset'/'destroy',...) runs a stimulus in chunks;
+%    test_stream.c checks that the chunks give the same output as one call.
+%    [sout,bm,tau,ihc,ppi] = an_arlo(...) also returns the intermediate signals.
+%    [sout,dsout] = an_arlo(para,input,dinput) also returns the derivatives of sout
+%    (ansens.c); test_sens.c compares them with finite differences.
+mex an_arlo.c runmodel.c ancache.c cmpa.c bmkernel.c hc.c complex.c filters.c synapse.c anpop.c ansens.c
+
+% This creates the matlab function an_arlo_pop, which runs a population of fibers
+%    (a vector of CFs) in one call and returns a CF x time matrix of synapse output.
+%    The fiber loops are vectorized by the compiler, e.g. with gcc add
+%    COPTIMFLAGS='-O3 -mavx2' (or -mavx512f) to the mex command.
+%    With para(11) = 1 it runs in single precision (anpop_impl.h is compiled twice
+%    in anpop.c); test_float.c reports its accuracy and speed against double.
+mex an_arlo_pop.c runmodel.c ancache.c cmpa.c bmkernel.c hc.c complex.c filters.c synapse.c anpop.c ansens.c
+
+% This creates the matlab function an_arlo_batch, which runs a table (or the cross
+%    product) of CF, spont, model, species, stimulus and level jobs on all processors.
+%    Compile it with OpenMP, e.g. with gcc add
+%    CFLAGS='$CFLAGS -fopenmp' LDFLAGS='$LDFLAGS -fopenmp' to the mex command;
+%    test_batch.c checks it against an_arlo.
+mex an_arlo_batch.c anbatch.c runmodel.c ancache.c cmpa.c bmkernel.c hc.c complex.c filters.c synapse.c anpop.c ansens.c
 
 % This creates the matlab function sgmodel, which is a spike generation model.
+%    The repetitions run in parallel with OpenMP, e.g. with gcc add
+%    CFLAGS='$CFLAGS -fopenmp' LDFLAGS='$LDFLAGS -fopenmp' to the mex command.
+%    rate = sgmodel('rate',tdres,sout) returns the expected rate instead of spike times;
+%    test_sgrate.c compares it with the PSTH of the repetitions.
 mex sgmodel.c spikes.c
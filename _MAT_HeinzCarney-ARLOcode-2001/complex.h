@@ -46,6 +46,8 @@ typedef struct __COMPLEX COMPLEX;
 #define CTREAL(z,X,real) {(z).x=(X).x*(real);(z).y=(X).y*(real);}
 
 #define CEXP(z,phase) {(z).x = cos(phase); (z).y = sin(phase); }
+/*//pull a phasor back onto the unit circle (one Newton step for 1/|z|, |z| close to 1) */
+#define CRENORM(z) {double r_=(3.0-CNORM(z))*0.5; (z).x*=r_; (z).y*=r_;}
 /* implementation using function : for compatibility */
 COMPLEX compdiv(COMPLEX ne,COMPLEX de);
 COMPLEX compexp(double theta);
@@ -210,6 +210,9 @@ void initGammaTone(TGammaTone* res,double _tdres,double _Fshift,double _tau,doub
   res->F_shift = _Fshift;
   res->delta_phase = -TWOPI*_Fshift*_tdres;
   res->phase = 0;
+  CMPLX(res->c_phase,1.0,0.0);
+  CEXP(res->c_delta,res->delta_phase);
+  res->nrot = 0;
   res->tau = _tau;
 
   c = 2.0/_tdres; /* for bilinear transformation */
@@ -254,8 +257,10 @@ double runGammaTone(TGammaTone *p, double x)
   COMPLEX c1,c2,c_phase;
   x *= p->gain;
   p->phase += p->delta_phase;
+  if(fabs(p->phase)>GT_TWOPI) p->phase = fmod(p->phase,GT_TWOPI);
 
   CEXP(c_phase,p->phase); /*/ FREQUENCY SHIFT */
+  p->c_phase = c_phase;
   CTREAL(p->gtf[0],c_phase,x);
   for( j = 1; j <= p->Order; j++)      /*/ IIR Bilinear transformation LPF */
   {
@@ -271,19 +276,23 @@ double runGammaTone(TGammaTone *p, double x)
   return(out);
 };
 
-void runGammaTone2(TGammaTone *p, const double *in, double *out, const int length)
+/**
+
+   Pass one block through the gammatone filter, (cr,ci) is the frequency-shift
+   phasor of each sample of the block
+ */
+static void runGammaToneBlock(TGammaTone *p, const double *cr, const double *ci,
+			      const double *in, double *out, const int length)
 {
   int register loopSig,loopGT;
   double x;
-  COMPLEX c1,c2,c_phase;
+  COMPLEX c1,c2;
 
   for(loopSig = 0; loopSig<length; loopSig++)
   {
     x = p->gain*in[loopSig];
-    p->phase += p->delta_phase;
-
-    CEXP(c_phase,p->phase); /*/ FREQUENCY SHIFT */
-    CTREAL(p->gtf[0],c_phase,x);
+    p->gtf[0].x = cr[loopSig]*x; /*/ FREQUENCY SHIFT */
+    p->gtf[0].y = ci[loopSig]*x;
     for( loopGT = 1; loopGT <= p->Order; loopGT++)      /*/ IIR Bilinear transformation LPF */
     {
     CADD(c1,p->gtf[loopGT-1],p->gtfl[loopGT-1]);
@@ -291,12 +300,153 @@ void runGammaTone2(TGammaTone *p, const double *in, double *out, const int lengt
     CTREAL(c1,p->gtfl[loopGT],p->c1LP);
     CADD(p->gtf[loopGT],c1,c2);
     };
-    CONJ(c_phase); /* FREQ SHIFT BACK UP */
-    CMULT(c1,c_phase,p->gtf[p->Order]);
     for(loopGT=0; loopGT<=p->Order;loopGT++) p->gtfl[loopGT] = p->gtf[loopGT];
+    /* FREQ SHIFT BACK UP, real part */
+    out[loopSig] = cr[loopSig]*p->gtf[p->Order].x + ci[loopSig]*p->gtf[p->Order].y;
+  };
+return;
+};
 
-    out[loopSig] = CREAL(c1);
-  }; 
+/**
+
+   Same as runGammaTone, but the phasor exp(i*phase) is advanced by
+   multiplication with exp(i*delta_phase) instead of calling cos and sin on every
+   sample. The input is processed in blocks of GT_BLOCK samples: the phasors of a
+   block are computed first. The phasor is put back on the unit circle after every
+   GT_BLOCK samples of the filter (nrot), so that the output does not depend on how
+   the signal is cut into calls.
+   Filters with equal delta_phase and phasor (gfagain and bmfilter of one fiber)
+   share the phasors of the block.
+ */
+void runGammaToneBatch(TGammaTone **p, const int nfilt, const double **in, double **out, const int length)
+{
+  int register loopSig,k,j;
+  int nblock,n,share[GT_MAXBATCH];
+  double cr[GT_MAXBATCH][GT_BLOCK],ci[GT_MAXBATCH][GT_BLOCK];
+  COMPLEX c1;
+
+  n = (nfilt>GT_MAXBATCH) ? GT_MAXBATCH : nfilt;
+  for(k=0; k<n; k++)
+  {
+    share[k] = k;
+    for(j=0; j<k; j++)
+      if((share[j]==j)&&(p[j]->delta_phase==p[k]->delta_phase)&&(p[j]->nrot==p[k]->nrot)
+	 &&(p[j]->c_phase.x==p[k]->c_phase.x)&&(p[j]->c_phase.y==p[k]->c_phase.y))
+      { share[k] = j; break; };
+  };
+
+  for(loopSig=0; loopSig<length; loopSig+=GT_BLOCK)
+  {
+    nblock = (length-loopSig<GT_BLOCK) ? length-loopSig : GT_BLOCK;
+    for(k=0; k<n; k++)
+    {
+      if(share[k]!=k) continue;
+      for(j=0; j<nblock; j++)
+      {
+	CMULT(c1,p[k]->c_phase,p[k]->c_delta);
+	p[k]->c_phase = c1;
+	cr[k][j] = c1.x;
+	ci[k][j] = c1.y;
+	if(++(p[k]->nrot)==GT_BLOCK)
+	{
+	  CRENORM(p[k]->c_phase);
+	  p[k]->nrot = 0;
+	};
+      };
+    };
+    for(k=0; k<n; k++)
+      runGammaToneBlock(p[k],cr[share[k]],ci[share[k]],in[k]+loopSig,out[k]+loopSig,nblock);
+  };
+  for(k=0; k<n; k++)
+  {
+    p[k]->c_phase = p[share[k]]->c_phase;
+    p[k]->nrot = p[share[k]]->nrot;
+    GTPHASE_ADVANCE(p[k],length);
+  };
+  /* the rest of the filters */
+  if(nfilt>n) runGammaToneBatch(p+n,nfilt-n,in+n,out+n,length);
 return;
 };
 
+void runGammaTone2(TGammaTone *p, const double *in, double *out, const int length)
+{
+  runGammaToneBatch(&p,1,&in,&out,length);
+return;
+};
+
+/**
+    The decimator is a windowed-sinc (Blackman) low-pass FIR with 2*DEC_HALFLEN*factor+1
+    taps and cutoff at 0.8 of the output Nyquist frequency, unity gain at DC.
+    The filter is centered (no delay): output m is the filtered input at
+    sample m*factor. Only the kept outputs are computed (the cost of the polyphase
+    form), i.e. 2*DEC_HALFLEN+1 multiplications per input sample.
+    Beyond both ends the signal is taken as its first/last sample, so that the resting
+    level of the IHC output is not seen as a step.
+    interp2 is the inverse: the same filter (times factor) interpolates back to the
+    input rate, each output sample uses 2*DEC_HALFLEN+1 input samples.
+ */
+int runDecimator2(TDecimator *p,const double *in, double *out, const int length);
+void runInterpolator2(TDecimator *p,const double *in, double *out, const int length);
+void initDecimator(TDecimator* p,int _factor)
+{
+  int k;
+  double t,fc,w,sum;
+  if(_factor<1) _factor = 1;
+  if(_factor>DEC_MAXFACTOR) _factor = DEC_MAXFACTOR;
+  p->factor = _factor;
+  p->delay = DEC_HALFLEN*_factor;
+  p->ntaps = 2*p->delay+1;
+  fc = 0.8*0.5/_factor; /* cycles per input sample */
+  sum = 0;
+  for(k=0; k<p->ntaps; k++)
+  {
+    t = k-p->delay;
+    w = 0.42+0.5*cos(GT_TWOPI*t/(p->ntaps+1))+0.08*cos(2*GT_TWOPI*t/(p->ntaps+1));
+    p->h[k] = (t==0) ? 2*fc : sin(GT_TWOPI*fc*t)/(GT_TWOPI*0.5*t);
+    p->h[k] *= w;
+    sum += p->h[k];
+  };
+  for(k=0; k<p->ntaps; k++) p->h[k] /= sum;
+  p->run2 = runDecimator2;
+  p->interp2 = runInterpolator2;
+return;
+};
+
+int runDecimator2(TDecimator *p,const double *in, double *out, const int length)
+{
+  register int m,k;
+  int n,center,klo,khi;
+  double sum;
+  n = (length+p->factor-1)/p->factor;
+  for(m=0; m<n; m++)
+  {
+    center = m*p->factor+p->delay; /* in[center-k] pairs with h[k] */
+    klo = (center-(length-1)>0) ? center-(length-1) : 0;
+    khi = (center<p->ntaps-1) ? center : p->ntaps-1;
+    sum = 0;
+    for(k=0; k<klo; k++) sum += p->h[k]*in[length-1];
+    for(k=klo; k<=khi; k++) sum += p->h[k]*in[center-k];
+    for(k=khi+1; k<p->ntaps; k++) sum += p->h[k]*in[0];
+    out[m] = sum;
+  };
+return(n);
+};
+
+void runInterpolator2(TDecimator *p,const double *in, double *out, const int length)
+{
+  register int i,m;
+  int n,M,mlo,mhi;
+  double sum;
+  M = p->factor;
+  n = (length+M-1)/M;
+  for(i=0; i<length; i++)
+  { /*/ in[m] pairs with h[i-m*M+delay] */
+    mlo = (i+p->delay-(p->ntaps-1)+M-1+M*DEC_HALFLEN*2)/M-DEC_HALFLEN*2;
+    mhi = (i+p->delay)/M;
+    sum = 0;
+    for(m=mlo; m<=mhi; m++)
+      sum += p->h[i-m*M+p->delay]*in[(m<0) ? 0 : ((m>=n) ? n-1 : m)];
+    out[i] = M*sum;
+  };
+return;
+};
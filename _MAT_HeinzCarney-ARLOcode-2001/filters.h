@@ -12,12 +12,19 @@
 #endif
 /*// Maximum order of the filter */
 #define MAX_ORDER 10
+/*// 2*pi to full precision, the phase of the gammatone filters is kept within one period */
+#define GT_TWOPI 6.28318530717958647692
+/*// Block length of the gammatone filters, the phasor is renormalized after each block */
+#define GT_BLOCK 64
+/*// Maximum number of filters in one runGammaToneBatch pass */
+#define GT_MAXBATCH 8
 
 /*/######################################################################## */
 /* interface the users */
 typedef struct __LowPass TLowPass;
 typedef struct __HighPass THighPass;
 typedef struct __GammaTone TGammaTone;
+typedef struct __Decimator TDecimator;
 /*// Construct the filter with time_resolustion(1/F_s), cutoff frequency, gain, filter order */
 TLowPass* getLowPass(double _tdres,double _Fc,double _gain,int _LPorder);
 void initLowPass(TLowPass* p,double _tdres,double _Fc,double _gain,int _LPorder);
@@ -27,6 +34,12 @@ void initGammaTone(TGammaTone* p,double _tdres,double _Fshift,double _tau,double
 /*// Init the filter with time_resolution(1/F_s), cut-off freq., gain,order */
 THighPass* getHighPass(double _tdres,double _Fc,double _gain,int _HPorder);
 void initHighPass(THighPass* p,double _tdres,double _Fc,double _gain,int _HPorder);
+/*// Run several gammatone filters block by block, in the given order, filter k can use
+//// the output of filter j<k as input. Filters with the same frequency shift and phase
+//// share one phasor */
+void runGammaToneBatch(TGammaTone **p, const int nfilt, const double **in, double **out, const int length);
+/*// Init the decimator with the decimation factor (1..DEC_MAXFACTOR) */
+void initDecimator(TDecimator* p,int _factor);
 /* /########################################################################################## */
 /*/ ----------------------------------------------------------------------------
  **
@@ -74,6 +87,10 @@ struct __GammaTone
   void (*run2)(TGammaTone *p,const double *in, double *out, const int length);
 
   double phase;
+  /*// exp(i*phase) and exp(i*delta_phase), the phasor is advanced by complex multiplication */
+  COMPLEX c_phase,c_delta;
+  /*// rotations since c_phase was last put back on the unit circle, every GT_BLOCK samples */
+  int nrot;
   /* Cutoff Freq(tau), Shift Freq, ... */
   double tdres,tau;
   double F_shift,delta_phase;
@@ -84,4 +101,25 @@ struct __GammaTone
   /*// Set the tau of the gammatone filter, this is useful for time-varying filter */
   void (*settau)(TGammaTone *p, double _tau);
 };
+
+/*/ ----------------------------------------------------------------------------
+ **
+   Decimator : linear-phase FIR anti-alias filter, evaluated only at the kept samples
+ */
+/*// Maximum decimation factor, half length of the filter in output samples */
+#define DEC_MAXFACTOR 32
+#define DEC_HALFLEN 4
+#define DEC_MAXTAPS (2*DEC_HALFLEN*DEC_MAXFACTOR+1)
+struct __Decimator{
+  /*// out[m] = sum_k h[k]*in[m*factor+delay-k]
+  //// returns the number of output samples, (length+factor-1)/factor */
+  int (*run2)(TDecimator *p,const double *in, double *out, const int length);
+  /*// back to the input rate, in holds (length+factor-1)/factor samples */
+  void (*interp2)(TDecimator *p,const double *in, double *out, const int length);
+  int factor,ntaps,delay;
+  double h[DEC_MAXTAPS];
+};
+
+/*// advance the phase of a gammatone filter by n samples, kept within one period */
+#define GTPHASE_ADVANCE(p,n) ((p)->phase = fmod((p)->phase+(n)*(p)->delta_phase,GT_TWOPI))
 #endif
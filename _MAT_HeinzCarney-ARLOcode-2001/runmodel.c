@@ -2,17 +2,126 @@
 #include "cmpa.h"
 #include "complex.h"
 #include "filters.h"
+#include "anpop.h"
 
 int an_arlo(double tdres, double cf, double spont, int model, int species, int ifspike,
 				   const double *in, double *out, int length)
 {
 	TAuditoryNerve anf;
 	anf.ifspike = ifspike;
-	initAuditoryNerve(&anf, model, species,tdres,cf,spont);
+	initAuditoryNerveCached(&anf, model, species,tdres,cf,spont);
 	runAN2(&anf, in, out, length);
 return(0);	
 };
 
+/*/ The same, and the intermediate signals of the same pass (bm, tau, ihc, ppi may be NULL).
+//// Returns 1 if out of memory */
+int an_arlo_taps(double tdres, double cf, double spont, int model, int species, int ifspike,
+		 const double *in, double *sout, double *bmout, double *tauout, double *ihcout,
+		 double *ppiout, int length)
+{
+	TAuditoryNerve anf;
+	anf.ifspike = ifspike;
+	initAuditoryNerveCached(&anf, model, species,tdres,cf,spont);
+	if(runAN2Taps(&anf, in, bmout, tauout, ihcout, ppiout, sout, length)<0) return(1);
+return(0);
+};
+
+/*/ sout and its derivatives with respect to nder stimulus parameters, din and dout are
+//// length x nder. Returns 1 if out of memory */
+int an_arlo_sens(double tdres, double cf, double spont, int model, int species, int ifspike,
+		 const double *in, const double *din, int nder, double *out, double *dout, int length)
+{
+	TAuditoryNerve anf;
+	anf.ifspike = ifspike;
+	initAuditoryNerveCached(&anf, model, species,tdres,cf,spont);
+	if(runAN2Sens(&anf, in, din, out, dout, length, nder)<0) return(1);
+return(0);
+};
+
+/*/ Streaming handle */
+struct __ANStream{
+	TAuditoryNerve anf;
+	double tdres,cf,spont;
+	int model,species,ifspike;
+};
+
+TANStream* an_arlo_create(double tdres, double cf, double spont, int model, int species, int ifspike)
+{
+	TANStream *h;
+	h = (TANStream*)malloc(sizeof(TANStream));
+	if(h==NULL) return(NULL);
+	h->tdres = tdres;
+	h->cf = cf;
+	h->spont = spont;
+	h->model = model;
+	h->species = species;
+	h->ifspike = ifspike;
+	an_arlo_reset(h);
+return(h);
+};
+
+void an_arlo_process(TANStream *h, const double *in, double *out, int length)
+{
+	runAN2(&(h->anf), in, out, length);
+};
+
+void an_arlo_reset(TANStream *h)
+{
+	h->anf.ifspike = h->ifspike;
+	initAuditoryNerveCached(&(h->anf), h->model, h->species, h->tdres, h->cf, h->spont);
+};
+
+void an_arlo_destroy(TANStream *h)
+{
+	free(h);
+};
+
+/*/ Multirate: the IHC-PPI and the synapse run at tdres*decim,
+//// out holds length samples, or (length+decim-1)/decim if ifdecout.
+//// Returns 1 if out of memory, 2 if decim is larger than DEC_MAXFACTOR */
+int an_arlo_decim(double tdres, double cf, double spont, int model, int species, int ifspike,
+		  int decim, int ifdecout, const double *in, double *out, int length)
+{
+	TAuditoryNerve anf;
+	if(decim>DEC_MAXFACTOR) return(2);
+	anf.ifspike = ifspike;
+	initAuditoryNerveCached(&anf, model, species,tdres,cf,spont);
+	setAuditoryNerveDecimation(&anf,decim);
+	if(runAN2Decimated(&anf, in, out, length, ifdecout)<0) return(1);
+return(0);
+};
+
+/*/ Run a population of fibers, out is nfibers x length (CF x time) */
+int an_arlo_pop(double tdres, double spont, int model, int species, int ifspike,
+		const double *cf, int nfibers, const double *in, double *out, int length)
+{
+	TANPopulation *pop;
+	pop = getANPopulation(model,species,tdres,spont,ifspike,cf,nfibers);
+	if(pop==NULL) return(1);
+	anpop_run(pop,in,out,length);
+	freeANPopulation(pop);
+return(0);
+};
+
+/*/ The same in single precision (TANPopulationF), see test_float.c */
+int an_arlo_popF(double tdres, double spont, int model, int species, int ifspike,
+		 const double *cf, int nfibers, const double *in, double *out, int length)
+{
+	TANPopulationF *pop;
+	pop = getANPopulationF(model,species,tdres,spont,ifspike,cf,nfibers);
+	if(pop==NULL) return(1);
+	anpop_runF(pop,in,out,length);
+	freeANPopulationF(pop);
+return(0);
+};
+
+/*/ Get the CFs of the filter bank from -fibers, -cf, -cflo, -cfhi, -delx */
+int getcflist(T_stim *ptm, double *cflist)
+{
+  return(cochlea_cflist(ptm->species,ptm->cf,ptm->cflo,ptm->cfhi,ptm->delx,ptm->banks,cflist));
+};
+
 /*/ ---------------------------------------------------------------- */
 
 int parsecommandline(T_stim *ptm,int argc, char* argv[])
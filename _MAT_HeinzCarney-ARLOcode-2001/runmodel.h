@@ -29,8 +29,21 @@ struct _Tstim{
   double *buf;
 };
 
+/* Streaming: one fiber whose state (filters, OHC, after-OHC, IHC and synapse) is kept
+   between calls, so a long stimulus can be processed in consecutive chunks.
+   The chunks give the same sout as an_arlo() on the whole stimulus, bit for bit. */
+typedef struct __ANStream TANStream;
+/* NULL if out of memory */
+TANStream* an_arlo_create(double tdres, double cf, double spont, int model, int species, int ifspike);
+void an_arlo_process(TANStream *h, const double *in, double *out, int length);
+/* back to the state right after an_arlo_create */
+void an_arlo_reset(TANStream *h);
+void an_arlo_destroy(TANStream *h);
+
 /* get parameters from the command line */
 int parsecommandline(T_stim *ptm,int argc,char *argv[]);
+/* get the cf of each fiber of the filter bank, cflist holds ptm->banks elements */
+int getcflist(T_stim *ptm, double *cflist);
 #endif
 
 
@@ -1,23 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
 #include "spikes.h"
 #include "mex.h"
 
 extern void _main();
 /*********************/
-extern int SGmodel(double tdres, const double *sout, double** sptimeptr, const int nstim, const int nrep);
+extern long SGmodel2(double tdres, const double *sout, const int nstim, const int nrep, unsigned long seed,
+              double **sptimeptr, double **trialptr);
 
 /* The gateway routine */
 void mexFunction( int nlhs, mxArray *plhs[],
                   int nrhs, const mxArray *prhs[])
 {
-      int error;
       double *para,*in,*out,*out2;
       double tdres;
-      int nrep,nspikes;
-      double  x;
-      double** outptr;
+      int nrep;
+      long nspikes,i;
+      unsigned long seed;
+      double *sptime,*trial;
       int     length,mrows,ncols;
       /*  Check for proper number of arguments. */
       /* NOTE: You do not need an else statement when using
@@ -25,17 +28,38 @@ void mexFunction( int nlhs, mxArray *plhs[],
            get to the else statement if mexErrMsgTxt is executed.
            (mexErrMsgTxt breaks you out of the MEX-file.) 
        */
+      /* rate = sgmodel('rate',tdres,input): expected rate (spikes/sec), no trials */
+      if((nrhs>0)&&mxIsChar(prhs[0]))
+      {
+        char cmd[8];
+        mxGetString(prhs[0],cmd,sizeof(cmd));
+        if((strcmp(cmd,"rate")!=0)||(nrhs!=3))
+          mexErrMsgTxt("rate = sgmodel('rate',tdres,input);");
+        if(nlhs>1)
+          mexErrMsgTxt("One output.");
+        tdres = mxGetScalar(prhs[1]);
+        in = mxGetPr(prhs[2]);
+        mrows = mxGetM(prhs[2]);
+        ncols = mxGetN(prhs[2]);
+        length = mrows*ncols;
+        plhs[0] = mxCreateDoubleMatrix(mrows,ncols,mxREAL);
+        if(SGrate(tdres,in,length,mxGetPr(plhs[0]))<0) mexErrMsgTxt("Out of memory.");
+        return;
+      };
       if(nrhs!=2) 
-        mexErrMsgTxt("[sptime,nspikes] = ihcmodel([tdres,nrep],input);");
-      if(nlhs!=2) 
-        mexErrMsgTxt("Two output required.");
+        mexErrMsgTxt("[sptime,nspikes,trial] = sgmodel([tdres,nrep(,seed)],input);");
+      if(nlhs>3) 
+        mexErrMsgTxt("At most three outputs.");
 
       /*  Get the input parameter. */
       if((mxGetM(prhs[0])*mxGetN(prhs[0]))<2)
-	mexErrMsgTxt("The first input para contains [tdres,nrep]");
+	mexErrMsgTxt("The first input para contains [tdres,nrep(,seed)]");
       para = mxGetPr(prhs[0]);
       tdres = para[0];
       nrep = (int)para[1];
+      /* the same seed gives the same spikes; without it, the spikes change from call to call */
+      if((mxGetM(prhs[0])*mxGetN(prhs[0]))>=3) seed = (unsigned long)para[2];
+      else seed = (unsigned long)time(NULL);
       
       /*  Create a pointer to the input matrix in. */
       in = mxGetPr(prhs[1]);
@@ -43,27 +67,29 @@ void mexFunction( int nlhs, mxArray *plhs[],
       /*  Get the dimensions of the matrix input in. */
       mrows = mxGetM(prhs[1]);
       ncols = mxGetN(prhs[1]);
-      /*  Set the output pointer to the output matrix. */
-/*      plhs[0] = mxCreateDoubleMatrix(mrows,ncols, mxREAL);*/
-      plhs[1] = mxCreateDoubleMatrix(1,1, mxREAL);
-      out2 = mxGetPr(plhs[1]);
-      
-      /*  Create a C pointer to a copy of the output matrix. */
-/*      out = mxGetPr(plhs[0]); */
       length = mrows*ncols;
 
       /*  Call the C subroutine. */
-      plhs[0] = mxCreateDoubleMatrix(10000,1,mxREAL);
-      out = mxGetPr(plhs[0]);
-      outptr  = &out;
-      
-      nspikes = SGmodel(tdres,in,outptr,length,nrep);
-/*      plhs[0] = mxCreateDoubleMatrix(nspikes,1,mxREAL);
+      nspikes = SGmodel2(tdres,in,length,nrep,seed,&sptime,(nlhs>2) ? &trial : NULL);
+      if(nspikes<0) mexErrMsgTxt("Out of memory.");
+
+      /* spike times (sec, from the start of each trial), ordered by trial */
+      plhs[0] = mxCreateDoubleMatrix(nspikes,1,mxREAL);
       out = mxGetPr(plhs[0]);
-      for(length = 0; length<nspikes; length++)
-	out[length] = (*outptr)[length];
-*/
-      out2[0] = (int)(nspikes+0.1);
-/*      free(*outptr); */
-};
+      for(i = 0; i<nspikes; i++) out[i] = sptime[i];
+      free(sptime);
 
+      if(nlhs>1)
+      {
+        plhs[1] = mxCreateDoubleMatrix(1,1, mxREAL);
+        out2 = mxGetPr(plhs[1]);
+        out2[0] = (double)nspikes;
+      };
+      if(nlhs>2)
+      {
+        plhs[2] = mxCreateDoubleMatrix(nspikes,1,mxREAL);
+        out = mxGetPr(plhs[2]);
+        for(i = 0; i<nspikes; i++) out[i] = trial[i];
+        free(trial);
+      };
+};
@@ -96,7 +96,272 @@ int runSpikes(TSpikeGenerator *p, const double x)
 		out = 1;
 	};
   };
-  printf("\n Out %d",out);
 return(out);
 };
 
+/*/ ---------------------------------------------------------------- */
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+void philox4x32(const sg_uint32 ctr[4], const sg_uint32 key[2], sg_uint32 out[4])
+{
+  int r;
+  unsigned long long p0,p1;
+  sg_uint32 x0,x1,x2,x3,k0,k1;
+  x0 = ctr[0]; x1 = ctr[1]; x2 = ctr[2]; x3 = ctr[3];
+  k0 = key[0]; k1 = key[1];
+  for(r=0; r<10; r++)
+  {
+    p0 = (unsigned long long)PHILOX_M0*x0;
+    p1 = (unsigned long long)PHILOX_M1*x2;
+    x0 = (sg_uint32)(p1>>32)^x1^k0;
+    x1 = (sg_uint32)p1;
+    x2 = (sg_uint32)(p0>>32)^x3^k1;
+    x3 = (sg_uint32)p0;
+    k0 += PHILOX_W0; k1 += PHILOX_W1;
+  };
+  out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+};
+
+void initPhilox(TPhilox *p, unsigned long seed, sg_uint32 stream)
+{
+  p->key[0] = (sg_uint32)(seed&0xFFFFFFFFUL);
+  p->key[1] = (sg_uint32)(((seed>>16)>>16)^0x53474D4FUL); /*/ "SGMO" */
+  p->ctr[0] = 0; p->ctr[1] = 0;
+  p->ctr[2] = stream; p->ctr[3] = 0;
+  p->nbuf = 0;
+};
+
+double philox_uniform(TPhilox *p)
+{
+  sg_uint32 a,b;
+  if(p->nbuf<2)
+  {
+    philox4x32(p->ctr,p->key,p->buf);
+    if(++(p->ctr[0])==0) p->ctr[1]++;
+    p->nbuf = 4;
+  };
+  a = p->buf[--(p->nbuf)]>>5;
+  b = p->buf[--(p->nbuf)]>>6;
+return(((double)a*67108864.0+(double)b+0.5)/9007199254740992.0);
+};
+
+static int addSpike(TSpikeTrain *train, double t)
+{
+  long newmax;
+  double *tmp;
+  if(train->nspikes>=train->maxspikes)
+  {
+    newmax = (train->maxspikes<64) ? 64 : 2*train->maxspikes;
+    tmp = (double*)realloc(train->sptime,sizeof(double)*newmax);
+    if(tmp==NULL) return(-1);
+    train->sptime = tmp;
+    train->maxspikes = newmax;
+  };
+  train->sptime[train->nspikes++] = t;
+return(0);
+};
+
+long runSpikeTrain(TSpikeGenerator *p, TPhilox *rng, const double *sout, const int nstim, TSpikeTrain *train)
+{
+  long j,n0;
+  double rtime,rsptime,rint;
+  double d0,d1,e0,e1;  /*/ exp(-(rint-dead)/s0), exp(-(rint-dead)/s1) kept by recurrence */
+  double H,E;          /*/ integrated rate since the last spike, and its target */
+  int armed;
+
+  n0 = train->nspikes;
+  d0 = exp(-p->tdres/p->s0);
+  d1 = exp(-p->tdres/p->s1);
+  rsptime = (sout[0]>0) ? -philox_uniform(rng)/sout[0] : -1e10;
+  E = -log(philox_uniform(rng));
+  H = 0; e0 = e1 = 0;
+  armed = 0;
+  for(j=0; j<nstim; j++)
+  {
+    rtime = (j+1)*p->tdres;
+    rint = rtime-rsptime;
+    if(rint<=p->dead) continue;
+    if(!armed)
+    {
+      e0 = exp(-(rint-p->dead)/p->s0);
+      e1 = exp(-(rint-p->dead)/p->s1);
+      armed = 1;
+    }
+    else { e0 *= d0; e1 *= d1; };
+    if(sout[j]>0) H += sout[j]*p->tdres*(1.0-(p->c0*e0+p->c1*e1));
+    if(H>=E)
+    {
+      if(addSpike(train,rtime)) return(-1);
+      rsptime = rtime;
+      armed = 0;
+      H = 0;
+      E = -log(philox_uniform(rng));
+    };
+  };
+return(train->nspikes-n0);
+};
+
+long SGmodel2(double tdres, const double *sout, const int nstim, const int nrep, unsigned long seed,
+              double **sptimeptr, double **trialptr)
+{
+  long i,k,isp,nspikes;
+  int failed;
+  double *sptime,*trial;
+  TSpikeTrain *trains;
+
+  *sptimeptr = NULL;
+  if(trialptr!=NULL) *trialptr = NULL;
+  if(nrep<=0 || nstim<=0) return(0);
+  trains = (TSpikeTrain*)calloc(nrep,sizeof(TSpikeTrain));
+  if(trains==NULL) return(-1);
+
+  failed = 0;
+#pragma omp parallel for schedule(dynamic,4) reduction(|:failed)
+  for(i=0; i<nrep; i++)
+  {
+    TSpikeGenerator sg;
+    TPhilox rng;
+    initspikegenerator(&sg,tdres);
+    initPhilox(&rng,seed,(sg_uint32)i);
+    if(runSpikeTrain(&sg,&rng,sout,nstim,&trains[i])<0) failed = 1;
+  };
+
+  nspikes = 0;
+  for(i=0; i<nrep; i++) nspikes += trains[i].nspikes;
+  sptime = (double*)malloc(sizeof(double)*((nspikes>0) ? nspikes : 1));
+  trial = (trialptr==NULL) ? NULL : (double*)malloc(sizeof(double)*((nspikes>0) ? nspikes : 1));
+  if(sptime==NULL || (trialptr!=NULL && trial==NULL)) failed = 1;
+  isp = 0;
+  for(i=0; i<nrep; i++)
+  {
+    for(k=0; !failed && k<trains[i].nspikes; k++)
+    {
+      sptime[isp] = trains[i].sptime[k];
+      if(trial!=NULL) trial[isp] = i+1;
+      isp++;
+    };
+    free(trains[i].sptime);
+  };
+  free(trains);
+  if(failed)
+  {
+    free(sptime); free(trial);
+    return(-1);
+  };
+  *sptimeptr = sptime;
+  if(trialptr!=NULL) *trialptr = trial;
+return(nspikes);
+};
+
+int SGrate(double tdres, const double *sout, const int nstim, double *rate)
+{
+  TSpikeGenerator sg;
+  int j,m,M,K,L,k,l,n,head;
+  int *Lk;
+  double *P,*R,*T,*age,*enter,*Pm;
+  double x,r,u,v,a,a0,a1,lambda,dtmp;
+
+  initspikegenerator(&sg,tdres);
+  /*/ ages 1..M-1 (in samples) on the grid, M and older in the tail; at age M
+  //// e0 = u and e1 = v, the moments with u^k*v^l below SG_RATE_EPS are left out */
+  M = (int)ceil((sg.dead+SG_RATE_TAIL*sg.s0)/tdres);
+  if(M<2) M = 2;
+  u = exp(-(M*tdres-sg.dead)/sg.s0);
+  v = exp(-(M*tdres-sg.dead)/sg.s1);
+  K = (int)(log(SG_RATE_EPS)/log(u));
+  L = (int)(log(SG_RATE_EPS)/log(v));
+  n = (K+2)*(L+2);
+  P = (double*)calloc(M,sizeof(double));
+  R = (double*)calloc(M,sizeof(double));
+  T = (double*)calloc(3*n,sizeof(double));
+  Lk = (int*)calloc(K+1,sizeof(int));
+  if((P==NULL)||(R==NULL)||(T==NULL)||(Lk==NULL))
+  {
+    free(P); free(R); free(T); free(Lk);
+    return(-1);
+  };
+  age = T+n;     /*/ e0^k*e1^l of one sample more */
+  enter = T+2*n; /*/ u^k*v^l, of the age entering the tail */
+  for(k=0; k<=K; k++)
+  {
+    Lk[k] = (int)((log(SG_RATE_EPS)-k*log(u))/log(v));
+    for(l=0; l<=Lk[k]; l++)
+    {
+      age[k*(L+2)+l] = exp(-tdres*(k/sg.s0+l/sg.s1));
+      enter[k*(L+2)+l] = pow(u,k)*pow(v,l);
+    };
+  };
+  /*/ recovery at age m, as in runSpikes */
+  for(m=1; m<M; m++)
+    if(m*tdres>sg.dead)
+      R[m] = 1.0-(sg.c0*exp(-(m*tdres-sg.dead)/sg.s0)+sg.c1*exp(-(m*tdres-sg.dead)/sg.s1));
+
+  /*/ age at sample 0 is tdres+U/sout[0]: density sout[0] over (tdres,tdres+1/sout[0]) */
+  x = (nstim>0) ? sout[0] : 0;
+  if(x>0)
+  {
+    a1 = tdres+1.0/x;
+    for(m=1; m<M; m++)
+    {
+      a0 = (m-0.5)*tdres;
+      a = (m+0.5)*tdres;
+      if(a0<tdres) a0 = tdres;
+      if(a>a1) a = a1;
+      if(a>a0) P[m] = x*(a-a0);
+    };
+    a0 = (M-0.5)*tdres;
+    if(a1>a0)
+      for(k=0; k<=K; k++)
+      for(l=0; l<=Lk[k]; l++)
+      {
+        lambda = k/sg.s0+l/sg.s1;
+        T[k*(L+2)+l] = (lambda>0) ? x/lambda*(exp(-lambda*(a0-sg.dead))-exp(-lambda*(a1-sg.dead)))
+                                  : x*(a1-a0);
+      };
+  }
+  else T[0] = 1.0; /*/ no spike before the trial, fully recovered */
+
+  /*/ P is a ring: age m is at P[(head+m)%M], head moves back by one every sample */
+  head = 0;
+  for(j=0; j<nstim; j++)
+  {
+    x = sout[j]*tdres;
+    if(x<0) x = 0;
+    if(x>1) x = 1;
+    /*/ spike probability, and the survivors of every age */
+    r = 0;
+    Pm = P+head;
+    for(m=1; m<M-head; m++)
+    {
+      dtmp = Pm[m]*x*R[m];
+      r += dtmp;
+      Pm[m] -= dtmp;
+    };
+    Pm = P+head-M;
+    for(; m<M; m++)
+    {
+      dtmp = Pm[m]*x*R[m];
+      r += dtmp;
+      Pm[m] -= dtmp;
+    };
+    r += x*(T[0]-sg.c0*T[L+2]-sg.c1*T[1]);
+    for(k=0; k<=K; k++)
+    for(l=0; l<=Lk[k]; l++)
+      T[k*(L+2)+l] += x*(sg.c0*T[(k+1)*(L+2)+l]+sg.c1*T[k*(L+2)+l+1]-T[k*(L+2)+l]);
+    rate[j] = r/tdres;
+    /*/ one sample older: age M-1 goes to the tail, the spikes of this sample have age 1 */
+    head = (head>0) ? head-1 : M-1;
+    dtmp = P[head];
+    P[head] = 0;
+    for(k=0; k<=K; k++)
+    for(l=0; l<=Lk[k]; l++)
+      T[k*(L+2)+l] = T[k*(L+2)+l]*age[k*(L+2)+l]+dtmp*enter[k*(L+2)+l];
+    P[(head+1)%M] = r;
+  };
+  free(P); free(R); free(T); free(Lk);
+return(0);
+};
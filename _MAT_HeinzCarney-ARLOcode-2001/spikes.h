@@ -18,4 +18,63 @@ void initspikegenerator(TSpikeGenerator *p, double tdres);
 void initSG2(TSpikeGenerator *p, double spont);
 int SGmodel(double tdres, const double *sout, double** sptimeptr, const int nstim, const int nrep);
 
+/*/############################################################################## */
+/* Counter based random numbers (Philox4x32-10, Salmon et al. 2011)
+ * The n-th block of 4 random words of a stream is a function of (key,stream,n) only,
+ * so every trial has its own independent stream and the trials can run in any order
+ * (or on several threads) and still give the same spikes for the same seed.
+ * sg_uint32 must be 32 bits wide.
+ */
+typedef unsigned int sg_uint32;
+typedef struct __tphilox TPhilox;
+struct __tphilox {
+  sg_uint32 key[2];
+  sg_uint32 ctr[4];  /*/ ctr[0],ctr[1] block number, ctr[2] stream */
+  sg_uint32 buf[4];
+  int nbuf;          /*/ unused words left in buf */
+};
+void philox4x32(const sg_uint32 ctr[4], const sg_uint32 key[2], sg_uint32 out[4]);
+void initPhilox(TPhilox *p, unsigned long seed, sg_uint32 stream);
+/* uniform in (0,1), 53 bits */
+double philox_uniform(TPhilox *p);
+
+/* Growable list of spike times */
+typedef struct __tspiketrain TSpikeTrain;
+struct __tspiketrain {
+  double *sptime;
+  long nspikes,maxspikes;
+};
+
+/* One trial of the spike generator (same refractory model as runSpikes: c0,s0,c1,s1,dead).
+ * Instead of one random draw per sample, an exponential variate is drawn per spike and
+ * the integrated discharge rate sout*(1-c0*exp(-t/s0)-c1*exp(-t/s1)) is accumulated
+ * until it reaches it (time rescaling). The trial starts with the last spike at
+ * -U/sout[0] as initSG2 does. Spike times are in sec from the start of the trial.
+ * Returns the number of spikes added to train, -1 if out of memory */
+long runSpikeTrain(TSpikeGenerator *p, TPhilox *rng, const double *sout, const int nstim, TSpikeTrain *train);
+
+/* nrep independent trials, trial i uses stream i of seed. The trials run in parallel
+ * when compiled with OpenMP. *sptimeptr gets the spike times and *trialptr (if not NULL)
+ * the trial (1..nrep) of each spike, ordered by trial; both are malloc'ed, the caller frees them.
+ * Returns the number of spikes, -1 if out of memory */
+long SGmodel2(double tdres, const double *sout, const int nstim, const int nrep, unsigned long seed,
+              double **sptimeptr, double **trialptr);
+
+/* Expected discharge rate of the spike generator, without random numbers. The state is
+ * the probability distribution of the time since the last spike (a renewal process): at
+ * every sample the spike probability is sum over ages of P(age)*h, h = sout*tdres*
+ * (1-c0*e0-c1*e1) and 0 within the dead time, and the ages move on by one sample. This is
+ * the PSTH of infinitely many trials of runSpikes, which spikes with probability h.
+ * runSpikeTrain (SGmodel2) sums h against an exponential variate, i.e. spikes with
+ * probability 1-exp(-h), so SGrate approximates its PSTH to O(h^2) (relative h/2, 0.75%
+ * at 1500 spikes/sec and tdres = 1e-5). Ages up to dead+SG_RATE_TAIL*s0 are
+ * kept on a grid of tdres, older ones as the moments sum P*e0^k*e1^l, which go through
+ * the same steps in closed form; the moments smaller than SG_RATE_EPS (relative) are left
+ * out. The trial starts with the last spike uniformly in (-1/sout[0],0), as in
+ * runSpikeTrain. sout*tdres should not exceed 1.
+ * rate[j] gets the expected rate in spikes/sec at sample j. Returns 0, -1 if out of memory */
+#define SG_RATE_EPS 1e-12
+#define SG_RATE_TAIL 5
+int SGrate(double tdres, const double *sout, const int nstim, double *rate);
+
 #endif
@@ -19,10 +19,10 @@ return(error);
 int ihc_nl(Tsynapse *pthis, const double *in, double *out, const int length)
 {
   int error = 0;
-  static double A0 = 0.1;
-  static double B = 2000.;
-  static double C = 1.74;
-  static double D = 6.87e-9;
+  static const double A0 = 0.1;
+  static const double B = 2000.;
+  static const double C = 1.74;
+  static const double D = 6.87e-9;
   register int i;
   double temp,tempA,dtemp;
   double p1,p2,Vihc,PPI,pst,psl;
@@ -172,7 +172,49 @@ void runsyn_dynamic(Tsynapse *pthis, const double *in, double *out, int length)
 
   pthis->CIlast = CIlast;
   pthis->CLlast = CLlast;
-  pthis->PPIlast = pthis->PPIlast;
+  pthis->PPIlast = PPIlast;
+return;
+};
+
+/*
+ * With a coarse tdres (the decimated IHC output in the multirate mode) the forward Euler
+ * step of runsyn_dynamic is too long for CI, whose time constant VI/(PPI+PL) is ~20us at
+ * high levels. Over one step, PPI is taken as the mean of the two end samples and CL as
+ * constant, which makes the CI equation linear with the exact solution
+ *   CI = CIinf+(CIlast-CIinf)*exp(-(PPI+PL)*tdres/VI), CIinf = PL*CL/(PPI+PL)
+ * CL is slow (VL/PL ~ 80ms) and keeps the Euler step.
+ */
+void runsyn_dynamic_coarse(Tsynapse *pthis, const double *in, double *out, const int length)
+{
+  int register i;
+  double PPIlast,PL,PG,CIlast,CLlast,CG,VI,VL;
+  double tdres;
+  double CInow,CLnow,PPI,CIinf;
+
+  tdres = pthis->tdres;
+  PL = pthis->PL;
+  PG = pthis->PG;
+  CG = pthis->CG;
+  VI = pthis->VI;
+  VL = pthis->VL;
+  CIlast = pthis->CIlast;
+  CLlast = pthis->CLlast;
+  PPIlast = pthis->PPIlast;
+
+  for(i = 0; i<length;i++){
+    PPI = 0.5*(PPIlast+in[i]);
+    CIinf = PL*CLlast/(PPI+PL);
+    CInow = CIinf + (CIlast-CIinf)*exp(-(PPI+PL)*tdres/VI);
+    CLnow = CLlast + (tdres/VL)*(-PL*(CLlast-CIlast)+PG*(CG - CLlast));
+    PPIlast = in[i];
+    CIlast = CInow;
+    CLlast = CLnow;
+    out[i] = CInow*PPIlast;
+  };
+
+  pthis->CIlast = CIlast;
+  pthis->CLlast = CLlast;
+  pthis->PPIlast = PPIlast;
 return;
 };
 
@@ -14,6 +14,8 @@ struct __tsynapse{
 int runSynapse(Tsynapse *pthis, const double *in, double *out, const int length);
 void runsyn_dynamic(Tsynapse *pthis, const double *in, double *out, const int length);
 double run1syn_dynamic(Tsynapse *pthis, double x);
+/* Same model for a coarse tdres (multirate mode), the fast CI equation is integrated exactly */
+void runsyn_dynamic_coarse(Tsynapse *pthis, const double *in, double *out, const int length);
 int initSynapse(Tsynapse *pthis);
 #endif
 
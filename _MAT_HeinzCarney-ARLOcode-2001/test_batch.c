@@ -0,0 +1,124 @@
+/*
+ * Check of the batch runner (anbatch_run, anbatch.c).
+ *
+ * A rate-level and CF sweep (5 CFs, 0 to 90dB in 10dB steps, models 1 and 3, cat and
+ * human, a 20ms tone pip at 0dB SPL and a click) is run with anbatch_run on 1 thread
+ * and on nthreads threads. Every job must give the same sout as an_arlo() on the scaled
+ * stimulus, bit for bit, and the same mean rate. Reported are the times and the speed-up.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -fopenmp -o test_batch test_batch.c anbatch.c runmodel.c ancache.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c anpop.c ansens.c -lm
+ *   ./test_batch [nthreads(all processors)]
+ * Without -fopenmp it still runs, on one thread. Returns 0 if every job is identical.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "anbatch.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+int an_arlo(double tdres, double cf, double spont, int model, int species, int ifspike,
+	    const double *in, double *out, int length);
+
+static double wallclock(void)
+{
+#ifdef _OPENMP
+  return(omp_get_wtime());
+#else
+  return(clock()/(double)CLOCKS_PER_SEC);
+#endif
+}
+
+static void printprogress(void *arg, int done, int njobs)
+{
+  (void)arg;
+  printf("  %d of %d jobs\n",done,njobs);
+}
+
+int main(int argc, char *argv[])
+{
+  const double cf[] = {500,1000,2000,4000,8000};
+  const double spont[] = {50};
+  const double model[] = {1,3};
+  const double species[] = {0,1};
+  const double stim[] = {0,1};
+  double level[10];
+  const double tdres = 1e-5;
+  const int length = 3000;
+  int nthreads = 0;
+  double *stimuli,*sout1,*soutn,*rate1,*raten,*sig,*ref;
+  double t,gain,t1,tn;
+  TANBatch b;
+  TANJob *jobs;
+  int njobs,i,j,ndiff,nfail;
+
+  if(argc>1) nthreads = atoi(argv[1]);
+  for(i=0; i<10; i++) level[i] = 10*i;
+  njobs = anbatch_grid(cf,5,spont,1,model,2,species,2,stim,2,level,10,NULL);
+  jobs = (TANJob*)malloc(sizeof(TANJob)*njobs);
+  anbatch_grid(cf,5,spont,1,model,2,species,2,stim,2,level,10,jobs);
+
+  /*/ 20ms 1kHz tone pip with 2ms ramps, and a 100us click, both at 0dB SPL */
+  stimuli = (double*)calloc(2*length,sizeof(double));
+  for(i=0; i<2000; i++)
+  {
+    t = i*tdres;
+    gain = (t<0.002) ? t/0.002 : ((t>0.018) ? (0.02-t)/0.002 : 1);
+    stimuli[i] = gain*20e-6*sqrt(2.0)*sin(TWOPI*1000*t);
+  };
+  for(i=0; i<10; i++) stimuli[length+100+i] = 20e-6;
+
+  sout1 = (double*)malloc(sizeof(double)*length*njobs);
+  soutn = (double*)malloc(sizeof(double)*length*njobs);
+  rate1 = (double*)malloc(sizeof(double)*njobs);
+  raten = (double*)malloc(sizeof(double)*njobs);
+  sig = (double*)malloc(sizeof(double)*length);
+  ref = (double*)malloc(sizeof(double)*length);
+
+  b.tdres = tdres;
+  b.ifspike = 0;
+  b.stim = stimuli;
+  b.nstim = 2;
+  b.length = length;
+  b.jobs = jobs;
+  b.njobs = njobs;
+  b.sout = sout1;
+  b.rate = rate1;
+  t1 = wallclock();
+  if(anbatch_run(&b,1,NULL,NULL)!=0) { printf("anbatch_run failed\n"); return(1); };
+  t1 = wallclock()-t1;
+  b.sout = soutn;
+  b.rate = raten;
+  tn = wallclock();
+  if(anbatch_run(&b,nthreads,printprogress,NULL)!=0) { printf("anbatch_run failed\n"); return(1); };
+  tn = wallclock()-tn;
+
+  nfail = 0;
+  for(j=0; j<njobs; j++)
+  {
+    gain = pow(10.0,jobs[j].level/20.0);
+    for(i=0; i<length; i++) sig[i] = gain*stimuli[i+jobs[j].stim*length];
+    an_arlo(tdres,jobs[j].cf,jobs[j].spont,jobs[j].model,jobs[j].species,0,sig,ref,length);
+    ndiff = 0;
+    for(i=0; i<length; i++)
+      if((sout1[i+j*length]!=ref[i])||(soutn[i+j*length]!=ref[i])) ndiff++;
+    if((ndiff>0)||(rate1[j]!=raten[j]))
+    {
+      printf("job %d (cf %g model %d species %d stim %d %gdB): %d samples differ\n",j,jobs[j].cf,
+             jobs[j].model,jobs[j].species,jobs[j].stim,jobs[j].level,ndiff);
+      nfail++;
+    };
+  };
+#ifdef _OPENMP
+  if(nthreads<1) nthreads = omp_get_num_procs();
+#else
+  nthreads = 1;
+#endif
+  printf("%d jobs: 1 thread %.3fs, %d threads %.3fs, speed-up %.2f, %d jobs differ from an_arlo\n",
+         njobs,t1,nthreads,tn,t1/tn,nfail);
+  free(jobs); free(stimuli); free(sout1); free(soutn); free(rate1); free(raten); free(sig); free(ref);
+  return((nfail>0) ? 1 : 0);
+}
@@ -0,0 +1,98 @@
+/*
+ * Regression test of the specialized basilar membrane kernels (bmkernel.c)
+ * against the generic run2BasilarMembrane.
+ *
+ * For every species, model and a set of CFs, the BM output for a click, a tone
+ * at several levels and a noise is computed with both versions (the fast one in
+ * three pieces, to check that the state is carried over) and the largest
+ * difference relative to the peak of the generic output is reported.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -o test_bmkernel test_bmkernel.c bmkernel.c cmpa.c hc.c filters.c complex.c synapse.c -lm
+ *   ./test_bmkernel [tolerance(1e-9)]
+ * Returns 0 if every difference is within the tolerance.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cmpa.h"
+
+#define NSTIM 4
+
+void run2BasilarMembrane(TBasilarMembrane *bm, const double *in, double *out, const int length);
+
+/*/ stimulus in pascals: 0 click, 1 tone at 40dB SPL, 2 tone at 90dB SPL, 3 noise at 70dB SPL */
+static void makestim(int type, double tdres, double cf, double *sig, int length)
+{
+  int i;
+  unsigned long seed = 12345;
+  double amp;
+  for(i=0; i<length; i++) sig[i] = 0.0;
+  switch(type)
+  {
+  case 0:
+    sig[length/10] = 20e-6*pow(10,80/20.0)*sqrt(2.0);
+    break;
+  case 1:
+  case 2:
+    amp = 20e-6*pow(10,((type==1) ? 40 : 90)/20.0)*sqrt(2.0);
+    for(i=0; i<length*3/4; i++) sig[i] = amp*sin(TWOPI*cf*i*tdres);
+    break;
+  case 3:
+    amp = 20e-6*pow(10,70/20.0)*sqrt(3.0);
+    for(i=0; i<length*3/4; i++)
+    {
+      seed = (seed*1103515245+12345)&0x7fffffff;
+      sig[i] = amp*(2.0*seed/2147483647.0-1.0);
+    };
+    break;
+  };
+}
+
+int main(int argc, char *argv[])
+{
+  const int species[] = {0,1,9};
+  const double cfs[] = {250,1000,4000,12000};
+  const double tdres = 1e-5;
+  const int length = 20000;
+  double tol = 1e-9;
+  double *sig,*ref,*out;
+  double err,maxerr,peak;
+  int is,model,icf,type,i,nfail;
+  TBasilarMembrane bm1,bm2;
+
+  if(argc>1) tol = atof(argv[1]);
+  sig = (double*)malloc(sizeof(double)*length);
+  ref = (double*)malloc(sizeof(double)*length);
+  out = (double*)malloc(sizeof(double)*length);
+
+  nfail = 0;
+  for(is=0; is<3; is++)
+  for(model=1; model<=5; model++)
+  {
+    maxerr = 0;
+    for(icf=0; icf<4; icf++)
+    for(type=0; type<NSTIM; type++)
+    {
+      makestim(type,tdres,cfs[icf],sig,length);
+      initBasilarMembrane(&bm1,model,species[is],tdres,cfs[icf]);
+      initBasilarMembrane(&bm2,model,species[is],tdres,cfs[icf]);
+      run2BasilarMembrane(&bm1,sig,ref,length);
+      run2BasilarMembraneFast(&bm2,sig,out,length/3);
+      run2BasilarMembraneFast(&bm2,sig+length/3,out+length/3,length/3);
+      run2BasilarMembraneFast(&bm2,sig+2*(length/3),out+2*(length/3),length-2*(length/3));
+      peak = 0;
+      for(i=0; i<length; i++) if(fabs(ref[i])>peak) peak = fabs(ref[i]);
+      for(i=0; i<length; i++)
+      {
+        err = fabs(out[i]-ref[i])/((peak>0) ? peak : 1.0);
+        if(err>maxerr) maxerr = err;
+      };
+    };
+    printf("species %d model %d : max relative error %g %s\n",species[is],model,maxerr,
+           (maxerr<=tol) ? "ok" : "FAILED");
+    if(maxerr>tol) nfail++;
+  };
+  free(sig); free(ref); free(out);
+  return((nfail>0) ? 1 : 0);
+}
@@ -0,0 +1,107 @@
+/*
+ * Check of the fiber cache (initAuditoryNerveCached, ancache.c).
+ *
+ * For every species and model and 20 CFs, a fiber from the cache (first the one that
+ * adds it, then a copy of the stored one) must give the same sout for a click as a fiber
+ * from initAuditoryNerve, bit for bit, and the counts of the cache must add up. With
+ * OpenMP the same fibers are also taken from the cache by several threads at once.
+ * Reported are the time of initAuditoryNerve and of a cached fiber, and of a 20ms click
+ * at tdres = 1e-5 with each (the init is what the cache saves on short stimuli).
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -fopenmp -o test_cache test_cache.c ancache.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c -lm
+ *   ./test_cache
+ * Returns 0 if every cached fiber is identical.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "cmpa.h"
+
+#define NCF 20
+#define LENGTH 2000
+#define NTIME 20000
+
+/*/ sout of a click the same as with initAuditoryNerve, returns 1 if not */
+static int checkfiber(int model, int species, double cf, const double *click, double *ref, double *out)
+{
+  TAuditoryNerve a,b;
+  int i;
+  a.ifspike = b.ifspike = 0;
+  initAuditoryNerve(&a,model,species,1e-5,cf,50);
+  initAuditoryNerveCached(&b,model,species,1e-5,cf,50);
+  runAN2(&a,click,ref,LENGTH);
+  runAN2(&b,click,out,LENGTH);
+  for(i=0; i<LENGTH; i++)
+    if(out[i]!=ref[i]) return(1);
+return(0);
+}
+
+int main(void)
+{
+  const int species[] = {0,1,9};
+  double click[LENGTH],ref[LENGTH],out[LENGTH];
+  double cf[NCF];
+  long n,hits,misses;
+  int is,model,ic,i,pass,nfail,ntfail;
+  double tinit,tcache,trun;
+  clock_t t0;
+  TAuditoryNerve a;
+
+  for(ic=0; ic<NCF; ic++) cf[ic] = 250*pow(2.0,ic*5.0/(NCF-1));
+  for(i=0; i<LENGTH; i++) click[i] = ((i>=100)&&(i<110)) ? 0.02 : 0;
+
+  /*/ pass 0 adds the fibers, pass 1 copies them */
+  nfail = 0;
+  clearAuditoryNerveCache();
+  for(pass=0; pass<2; pass++)
+  for(is=0; is<3; is++)
+  for(model=1; model<=5; model++)
+  for(ic=0; ic<NCF; ic++)
+    if(checkfiber(model,species[is],cf[ic],click,ref,out))
+    {
+      printf("pass %d species %d model %d cf %g: differs from initAuditoryNerve\n",
+             pass,species[is],model,cf[ic]);
+      nfail++;
+    };
+  getAuditoryNerveCacheStats(&n,&hits,&misses);
+  printf("%ld fibers in the cache, %ld hits, %ld misses\n",n,hits,misses);
+  if((n!=3*5*NCF)||(hits!=3*5*NCF)||(misses!=3*5*NCF)) nfail++;
+
+  /*/ many threads on the same keys, from an empty cache */
+  clearAuditoryNerveCache();
+  ntfail = 0;
+#pragma omp parallel for schedule(dynamic,1) reduction(+:ntfail)
+  for(i=0; i<8*3*5*NCF; i++)
+  {
+    double r[LENGTH],o[LENGTH];
+    int k = i%(3*5*NCF);
+    ntfail += checkfiber(k/(3*NCF)+1,species[(k/NCF)%3],cf[k%NCF],click,r,o);
+  };
+  getAuditoryNerveCacheStats(&n,&hits,&misses);
+  printf("threads: %ld fibers in the cache, %ld hits, %ld misses, %d differ\n",n,hits,misses,ntfail);
+  nfail += ntfail;
+
+  /*/ timing, cat model 1 */
+  a.ifspike = 0;
+  t0 = clock();
+  for(i=0; i<NTIME; i++) initAuditoryNerve(&a,1,1,1e-5,cf[i%NCF],50);
+  tinit = (clock()-t0)/(double)CLOCKS_PER_SEC/NTIME;
+  t0 = clock();
+  for(i=0; i<NTIME; i++) initAuditoryNerveCached(&a,1,1,1e-5,cf[i%NCF],50);
+  tcache = (clock()-t0)/(double)CLOCKS_PER_SEC/NTIME;
+  t0 = clock();
+  for(i=0; i<NTIME/10; i++)
+  {
+    initAuditoryNerveCached(&a,1,1,1e-5,cf[i%NCF],50);
+    runAN2(&a,click,out,LENGTH);
+  };
+  trun = (clock()-t0)/(double)CLOCKS_PER_SEC/(NTIME/10);
+  printf("initAuditoryNerve %.2fus, cached %.2fus (%.1f times faster); 20ms click %.1fus, "
+         "init %.1f%% of it, cached %.2f%%\n",1e6*tinit,1e6*tcache,tinit/tcache,1e6*trun,
+         100*tinit/trun,100*tcache/trun);
+  clearAuditoryNerveCache();
+  return((nfail>0) ? 1 : 0);
+}
@@ -0,0 +1,145 @@
+/*
+ * Accuracy and speed of the single precision population (TANPopulationF)
+ * against the double precision one (TANPopulation).
+ *
+ * For every species and model, a population of fibers (CFs from 250Hz to 12kHz) is run
+ * in both precisions on a click, a tone at 40 and 80dB SPL and a noise. Reported are the
+ * largest difference of sout relative to the peak of the double sout, the largest
+ * relative difference of the mean rate of a fiber, and the time ratio double/float.
+ * The stimuli end with silence, so a drift of the synapse would show in the last samples.
+ * As a yardstick for the rounding errors of float, the double population is also run with
+ * every sample of the stimulus multiplied by 1+-2^-24 (half an ulp of a float, random sign).
+ * Some models amplify such tiny differences: the feedback model (model 2) always, and the
+ * feed-forward model of the human at high levels and CFs (at tdres=2e-6 the difference of two
+ * double runs grows ten-fold every ~10ms), so that sout is only reproducible in the mean.
+ * A model passes if both differences are within the fixed tolerances of the model
+ * (soutTol, rateTol), which hold at tdres = 1e-5 and 2e-6; for model 2 only the mean rate
+ * is checked.
+ *
+ * Build and run (no MATLAB needed; add -mavx2 or -mavx512f for wider vectors):
+ *   cc -O3 -o test_float test_float.c anpop.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c -lm
+ *   ./test_float [tdres(1e-5)] [duration(0.1)] [fibers(32)]
+ * Returns 0 if every model passes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "anpop.h"
+
+#define NSTIM 4
+
+/*/ Tolerances of each model (index = model), sout relative to its peak and mean rate
+//// relative to the double one; a negative tolerance is not checked */
+static const double soutTol[6] = {0, 0.1, -1, 2e-4, 2e-4, 2e-4};
+static const double rateTol[6] = {0, 5e-3, 5e-2, 1e-4, 1e-4, 1e-4};
+
+/*/ stimulus in pascals: 0 click, 1,2 tone (1kHz) at 40,80dB SPL, 3 noise at 70dB SPL */
+static void makestim(int type, double tdres, double *sig, int length)
+{
+  int i;
+  unsigned long seed = 12345;
+  double amp;
+  for(i=0; i<length; i++) sig[i] = 0.0;
+  switch(type)
+  {
+  case 0:
+    sig[length/10] = 20e-6*pow(10,80/20.0)*sqrt(2.0)*1e-5/tdres;
+    break;
+  case 1:
+  case 2:
+    amp = 20e-6*pow(10,((type==1) ? 40 : 80)/20.0)*sqrt(2.0);
+    for(i=length/10; i<length*3/5; i++) sig[i] = amp*sin(TWOPI*1000*i*tdres);
+    break;
+  case 3:
+    amp = 20e-6*pow(10,70/20.0)*sqrt(3.0);
+    for(i=length/10; i<length*3/5; i++)
+    {
+      seed = (seed*1103515245+12345)&0x7fffffff;
+      sig[i] = amp*(2.0*seed/2147483647.0-1.0);
+    };
+    break;
+  };
+}
+
+int main(int argc, char *argv[])
+{
+  const int species[] = {0,1,9};
+  double tdres = 1e-5;
+  double duration = 0.1;
+  int nfibers = 32;
+  double *sig,*outd,*outf,*oute,*cf;
+  double err,errs,errm,erre,peak,md,mf,td,tf;
+  int is,model,type,i,k,length,pass,nfail;
+  clock_t t0;
+  TANPopulation *pd,*pe;
+  TANPopulationF *pf;
+
+  if(argc>1) tdres = atof(argv[1]);
+  if(argc>2) duration = atof(argv[2]);
+  if(argc>3) nfibers = atoi(argv[3]);
+  length = (int)(duration/tdres);
+  sig = (double*)malloc(sizeof(double)*length);
+  outd = (double*)malloc(sizeof(double)*length*nfibers);
+  outf = (double*)malloc(sizeof(double)*length*nfibers);
+  oute = (double*)malloc(sizeof(double)*length*nfibers);
+  cf = (double*)malloc(sizeof(double)*nfibers);
+  if((sig==NULL)||(outd==NULL)||(outf==NULL)||(oute==NULL)||(cf==NULL)) { printf("Out of memory\n"); return(1); };
+
+  printf("tdres %g, %gs stimuli, %d fibers\n",tdres,duration,nfibers);
+  nfail = 0;
+  td = tf = 0;
+  for(is=0; is<3; is++)
+  for(model=1; model<=5; model++)
+  {
+    cochlea_cflist(species[is],0,250,12000,0,nfibers,cf);
+    errs = errm = erre = 0;
+    for(type=0; type<NSTIM; type++)
+    {
+      makestim(type,tdres,sig,length);
+      pd = getANPopulation(model,species[is],tdres,50,0,cf,nfibers);
+      pf = getANPopulationF(model,species[is],tdres,50,0,cf,nfibers);
+      if((pd==NULL)||(pf==NULL)) { printf("Out of memory\n"); return(1); };
+      t0 = clock();
+      anpop_run(pd,sig,outd,length);
+      td += (double)(clock()-t0)/CLOCKS_PER_SEC;
+      t0 = clock();
+      anpop_runF(pf,sig,outf,length);
+      tf += (double)(clock()-t0)/CLOCKS_PER_SEC;
+      freeANPopulation(pd);
+      freeANPopulationF(pf);
+      for(k=0; k<length; k++) sig[k] *= ((k*7919)%5<2) ? 1.0-1.0/16777216.0 : 1.0+1.0/16777216.0;
+      pe = getANPopulation(model,species[is],tdres,50,0,cf,nfibers);
+      if(pe==NULL) { printf("Out of memory\n"); return(1); };
+      anpop_run(pe,sig,oute,length);
+      freeANPopulation(pe);
+
+      for(i=0; i<nfibers; i++)
+      {
+        peak = md = mf = 0;
+        for(k=0; k<length; k++)
+        {
+          if(fabs(outd[i+(long)nfibers*k])>peak) peak = fabs(outd[i+(long)nfibers*k]);
+          md += outd[i+(long)nfibers*k];
+          mf += outf[i+(long)nfibers*k];
+        };
+        for(k=0; k<length; k++)
+        {
+          err = fabs(outf[i+(long)nfibers*k]-outd[i+(long)nfibers*k])/peak;
+          if(err>errs) errs = err;
+          err = fabs(oute[i+(long)nfibers*k]-outd[i+(long)nfibers*k])/peak;
+          if(err>erre) erre = err;
+        };
+        err = fabs(mf-md)/md;
+        if(err>errm) errm = err;
+      };
+    };
+    pass = ((soutTol[model]<0)||(errs<=soutTol[model]))&&(errm<=rateTol[model]);
+    printf("species %d model %d : sout %.2e mean rate %.2e (double, input*(1+-2^-24): sout %.2e) %s\n",
+           species[is],model,errs,errm,erre,pass ? "ok" : "FAILED");
+    if(!pass) nfail++;
+  };
+  printf("time double %.3fs float %.3fs, throughput ratio float/double %.2f\n",td,tf,td/tf);
+  free(sig); free(outd); free(outf); free(oute); free(cf);
+  return((nfail>0) ? 1 : 0);
+}
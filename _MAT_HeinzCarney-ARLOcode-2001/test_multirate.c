@@ -0,0 +1,142 @@
+/*
+ * Accuracy check of the multirate mode (runAN2Decimated) against the full-rate model.
+ *
+ * For each species, model, CF and decimation factor, sout is computed at full rate
+ * (runAN2) and with the IHC-PPI and the synapse running at tdres*decim, for a tone
+ * burst at 30 and 70dB SPL, a click and a noise. Reported are the largest difference
+ * of the decimated sout (compared with the full-rate sout at the same instants) and of
+ * the interpolated sout (at every sample), both relative to the peak of the full-rate
+ * sout, and the relative difference of the mean rate.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -o test_multirate test_multirate.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c -lm
+ *   ./test_multirate [tdres(2e-6)] [tolerance(0.02)]
+ * Returns 0 if every difference of the decimated sout is within the tolerance.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cmpa.h"
+
+#define NSTIM 4
+
+/*/ stimulus in pascals: 0,1 tone at 30,70dB SPL, 2 click, 3 noise at 60dB SPL */
+static void makestim(int type, double tdres, double cf, double *sig, int length)
+{
+  int i;
+  unsigned long seed = 12345;
+  double amp;
+  for(i=0; i<length; i++) sig[i] = 0.0;
+  switch(type)
+  {
+  case 0:
+  case 1:
+    amp = 20e-6*pow(10,((type==0) ? 30 : 70)/20.0)*sqrt(2.0);
+    for(i=length/10; i<length*3/5; i++) sig[i] = amp*sin(TWOPI*cf*i*tdres);
+    break;
+  case 2:
+    sig[length/10] = 20e-6*pow(10,80/20.0)*sqrt(2.0)*1e-5/tdres;
+    break;
+  case 3:
+    amp = 20e-6*pow(10,60/20.0)*sqrt(3.0);
+    for(i=length/10; i<length*3/5; i++)
+    {
+      seed = (seed*1103515245+12345)&0x7fffffff;
+      sig[i] = amp*(2.0*seed/2147483647.0-1.0);
+    };
+    break;
+  };
+}
+
+int main(int argc, char *argv[])
+{
+  const int species[] = {0,9};
+  const int models[] = {1,3};
+  const double cfs[] = {500,2000,8000};
+  const int decims[] = {2,4,5,8,10,20};
+  double tdres = 2e-6;
+  double tol = 0.02;
+  double *sig,*ref,*dec,*decn,*itp;
+  double err,errd,erri,errm,peak,mref,mdec;
+  int is,im,icf,id,type,i,m,n,M,length,nfail;
+  TAuditoryNerve an;
+
+  if(argc>1) tdres = atof(argv[1]);
+  if(argc>2) tol = atof(argv[2]);
+  length = (int)(0.1/tdres);
+  sig = (double*)malloc(sizeof(double)*length);
+  ref = (double*)malloc(sizeof(double)*length);
+  dec = (double*)malloc(sizeof(double)*length);
+  itp = (double*)malloc(sizeof(double)*length);
+
+  nfail = 0;
+  printf("tdres %g, 100ms stimuli\n",tdres);
+  for(id=0; id<(int)(sizeof(decims)/sizeof(int)); id++)
+  {
+    M = decims[id];
+    if(M>DEC_MAXFACTOR || 0.5/(tdres*M)<5000) continue; /*/ keep the output rate above 10kHz */
+    for(is=0; is<2; is++)
+    for(im=0; im<2; im++)
+    {
+      errd = erri = errm = 0;
+      for(icf=0; icf<3; icf++)
+      for(type=0; type<NSTIM; type++)
+      {
+        makestim(type,tdres,cfs[icf],sig,length);
+        an.ifspike = 0;
+        initAuditoryNerve(&an,models[im],species[is],tdres,cfs[icf],50);
+        runAN2(&an,sig,ref,length);
+        initAuditoryNerve(&an,models[im],species[is],tdres,cfs[icf],50);
+        setAuditoryNerveDecimation(&an,M);
+        decn = (double*)malloc(sizeof(double)*((length+M-1)/M)); /*/ room for sout at tdres*M only */
+        n = runAN2Decimated(&an,sig,decn,length,1);
+        initAuditoryNerve(&an,models[im],species[is],tdres,cfs[icf],50);
+        setAuditoryNerveDecimation(&an,M);
+        runAN2Decimated(&an,sig,itp,length,0);
+
+        peak = mref = mdec = 0;
+        for(i=0; i<length; i++)
+        {
+          if(fabs(ref[i])>peak) peak = fabs(ref[i]);
+          mref += ref[i];
+        };
+        for(m=0; m<n; m++)
+        {
+          err = fabs(decn[m]-ref[m*M])/peak;
+          if(err>errd) errd = err;
+          mdec += decn[m];
+        };
+        for(i=0; i<length; i++)
+        {
+          err = fabs(itp[i]-ref[i])/peak;
+          if(err>erri) erri = err;
+        };
+        err = fabs(mdec/n-mref/length)/(mref/length);
+        if(err>errm) errm = err;
+        free(decn);
+      };
+      printf("decim %2d (%6.0fHz) species %d model %d : decimated %.2e interpolated %.2e mean rate %.2e %s\n",
+             M,1.0/(tdres*M),species[is],models[im],errd,erri,errm,(errd<=tol) ? "ok" : "FAILED");
+      if(errd>tol) nfail++;
+    };
+  };
+
+  /*/ decim 1 after a decimation runs the full-rate model again, factors above
+  //// DEC_MAXFACTOR are clamped (an_arlo rejects them) */
+  makestim(1,tdres,cfs[1],sig,length);
+  an.ifspike = 0;
+  initAuditoryNerve(&an,models[0],species[0],tdres,cfs[1],50);
+  runAN2(&an,sig,ref,length);
+  initAuditoryNerve(&an,models[0],species[0],tdres,cfs[1],50);
+  setAuditoryNerveDecimation(&an,2*DEC_MAXFACTOR);
+  m = an.decim;
+  setAuditoryNerveDecimation(&an,1);
+  runAN2Decimated(&an,sig,dec,length,0);
+  for(i=0, n=0; i<length; i++) if(dec[i]!=ref[i]) n++;
+  printf("decim %d clamped to %d, back to 1 : %d samples differ from full rate %s\n",
+         2*DEC_MAXFACTOR,m,n,((m==DEC_MAXFACTOR)&&(n==0)) ? "ok" : "FAILED");
+  if((m!=DEC_MAXFACTOR)||(n>0)) nfail++;
+
+  free(sig); free(ref); free(dec); free(itp);
+  return((nfail>0) ? 1 : 0);
+}
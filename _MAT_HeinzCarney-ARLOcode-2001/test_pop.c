@@ -0,0 +1,116 @@
+/*
+ * Check of the fiber-population engine (anpop_run, anpop.c) against an_arlo.
+ *
+ * For every species and model, a population of NCF fibers (250Hz to 16kHz) is run on a
+ * tone burst at 70dB SPL and on a click, and each fiber is run on its own as an_arlo()
+ * does (initAuditoryNerve, runAN2) with the same parameters. The linear models (3 and 4) do the same arithmetic
+ * in the same order, so their sout must be identical. For models 1 and 5 sout may differ
+ * by rounding: the largest difference, relative to the peak sout of the fiber, must stay
+ * below POP_TOL. The feedback model (2) amplifies rounding at CFs well above the tone
+ * (a change of the stimulus by 1e-15 changes its sout by up to 25% at 7.5kHz), so for
+ * it the mean rate of each fiber must be within POP_RATETOL instead.
+ *
+ * The linear models are only identical without contraction of a*b+c into fused
+ * multiply-adds, which round differently: add -ffp-contract=off to -march=native.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -o test_pop test_pop.c anpop.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c -lm
+ *   ./test_pop
+ * Returns 0 if every fiber is within its tolerance.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "anpop.h"
+
+#define NCF 12
+#define LENGTH 5000
+#define TDRES 1e-5
+#define POP_TOL 1e-9
+#define POP_RATETOL 1e-2
+
+/*/ 0: 1kHz tone at 70dB SPL with 1ms ramps, 1: 100us click */
+static void makestim(int type, double *sig)
+{
+  int i;
+  double amp = sqrt(2.0)*20e-6*pow(10.0,70/20.0);
+  for(i=0; i<LENGTH; i++)
+  {
+    if(type==1) sig[i] = ((i>=100)&&(i<110)) ? 0.02 : 0;
+    else
+    {
+      sig[i] = amp*sin(2*M_PI*1000*i*TDRES);
+      if(i<100) sig[i] *= i/100.0;
+      if(i>=LENGTH-100) sig[i] *= (LENGTH-i)/100.0;
+    };
+  };
+}
+
+int main(void)
+{
+  const int species[] = {0,1,9};
+  double cf[NCF],sig[LENGTH],ref[LENGTH],*out;
+  double err,errmax,errrate,peak,mref,mpop;
+  int is,model,type,ic,i,ndiff,nfail;
+  TANPopulation *pop;
+  TAuditoryNerve an;
+
+  for(ic=0; ic<NCF; ic++) cf[ic] = 250*pow(2.0,ic*6.0/(NCF-1));
+  out = (double*)malloc(sizeof(double)*NCF*LENGTH);
+  nfail = 0;
+  for(is=0; is<3; is++)
+  for(model=1; model<=5; model++)
+  {
+    errmax = errrate = 0; ndiff = 0;
+    for(type=0; type<2; type++)
+    {
+      makestim(type,sig);
+      pop = getANPopulation(model,species[is],TDRES,50,0,cf,NCF);
+      if(pop==NULL)
+      {
+        printf("getANPopulation failed\n");
+        return(1);
+      };
+      anpop_run(pop,sig,out,LENGTH);
+      freeANPopulation(pop);
+      for(ic=0; ic<NCF; ic++)
+      {
+        an.ifspike = 0;
+        initAuditoryNerve(&an,model,species[is],TDRES,cf[ic],50);
+        runAN2(&an,sig,ref,LENGTH);
+        peak = mref = mpop = 0;
+        for(i=0; i<LENGTH; i++) if(fabs(ref[i])>peak) peak = fabs(ref[i]);
+        for(i=0; i<LENGTH; i++)
+        {
+          if(out[ic+NCF*i]!=ref[i]) ndiff++;
+          err = fabs(out[ic+NCF*i]-ref[i])/peak;
+          if(err>errmax) errmax = err;
+          mref += ref[i];
+          mpop += out[ic+NCF*i];
+        };
+        err = fabs(mpop-mref)/mref;
+        if(err>errrate) errrate = err;
+      };
+    };
+    if((model==3)||(model==4))
+    {
+      printf("species %d model %d : %d samples differ %s\n",species[is],model,ndiff,
+             (ndiff==0) ? "ok" : "FAILED");
+      if(ndiff>0) nfail++;
+    }
+    else if(model==2)
+    {
+      printf("species %d model %d : mean rate differs by %.2e (largest difference %.2e of the peak) %s\n",
+             species[is],model,errrate,errmax,(errrate<=POP_RATETOL) ? "ok" : "FAILED");
+      if(errrate>POP_RATETOL) nfail++;
+    }
+    else
+    {
+      printf("species %d model %d : largest difference %.2e of the peak %s\n",species[is],model,errmax,
+             (errmax<=POP_TOL) ? "ok" : "FAILED");
+      if(errmax>POP_TOL) nfail++;
+    };
+  };
+  free(out);
+  return((nfail>0) ? 1 : 0);
+}
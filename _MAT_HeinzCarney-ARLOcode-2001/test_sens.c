@@ -0,0 +1,126 @@
+/*
+ * Check of the forward-mode sensitivity (runAN2Sens, ansens.c) against finite differences.
+ *
+ * For every species and model, a tone of frequency f near CF at 40, 60 and 90dB SPL is
+ * run once with runAN2Sens, with two parameters: the level (din = in*log(10)/20, per dB)
+ * and the frequency of the tone (din = amp*2*pi*t*cos(2*pi*f*t), per Hz). The derivatives
+ * are compared with central differences of runAN2 (steps 1e-4 dB and 1e-5 Hz), the error
+ * relative to the peak of the derivative is reported, and sout with the one of runAN2.
+ * Reported too is the time of runAN2Sens against the four runAN2 of the differences.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -o test_sens test_sens.c ansens.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c -lm
+ *   ./test_sens [tolerance(1e-3)]
+ * Returns 0 if every difference is within the tolerance.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "cmpa.h"
+
+#define NLEVEL 3
+
+/*/ tone at level db and frequency f */
+static void maketone(double tdres, double f, double db, double *sig, int length)
+{
+  int i;
+  double amp = 20e-6*pow(10,db/20.0)*sqrt(2.0);
+  for(i=0; i<length; i++) sig[i] = amp*sin(TWOPI*f*i*tdres);
+}
+
+int main(int argc, char *argv[])
+{
+  const int species[] = {0,1,9};
+  const double levels[NLEVEL] = {40,60,90};
+  const double tdres = 1e-5;
+  const double cf = 2000, f = 1900;
+  const double hdb = 1e-4, hf = 1e-5;
+  const int length = 5000;
+  double tol = 1e-3;
+  double *sig,*din,*out,*dout,*ref,*up,*dn;
+  double amp,t,fd,err[2],peak[2],serr,speak,maxerr,tsens,tfd;
+  clock_t t0;
+  int is,model,il,i,k,nfail;
+  TAuditoryNerve anf;
+
+  if(argc>1) tol = atof(argv[1]);
+  sig = (double*)malloc(sizeof(double)*length);
+  din = (double*)malloc(sizeof(double)*length*2);
+  out = (double*)malloc(sizeof(double)*length);
+  dout = (double*)malloc(sizeof(double)*length*2);
+  ref = (double*)malloc(sizeof(double)*length);
+  up = (double*)malloc(sizeof(double)*length);
+  dn = (double*)malloc(sizeof(double)*length);
+
+  nfail = 0;
+  tsens = tfd = 0;
+  anf.ifspike = 0;
+  for(is=0; is<3; is++)
+  for(model=1; model<=5; model++)
+  {
+    maxerr = 0;
+    for(il=0; il<NLEVEL; il++)
+    {
+      amp = 20e-6*pow(10,levels[il]/20.0)*sqrt(2.0);
+      maketone(tdres,f,levels[il],sig,length);
+      for(i=0; i<length; i++)
+      {
+        t = i*tdres;
+        din[i] = sig[i]*log(10.0)/20.0;
+        din[i+length] = amp*TWOPI*t*cos(TWOPI*f*t);
+      };
+      t0 = clock();
+      initAuditoryNerve(&anf,model,species[is],tdres,cf,50);
+      if(runAN2Sens(&anf,sig,din,out,dout,length,2)<0)
+      {
+        printf("runAN2Sens failed\n");
+        return(1);
+      };
+      tsens += clock()-t0;
+      initAuditoryNerve(&anf,model,species[is],tdres,cf,50);
+      runAN2(&anf,sig,ref,length);
+      serr = speak = 0;
+      for(i=0; i<length; i++)
+      {
+        if(fabs(out[i]-ref[i])>serr) serr = fabs(out[i]-ref[i]);
+        if(fabs(ref[i])>speak) speak = fabs(ref[i]);
+      };
+      if(serr/speak>maxerr) maxerr = serr/speak;
+
+      for(k=0; k<2; k++)
+      {
+        t0 = clock();
+        if(k==0) maketone(tdres,f,levels[il]+hdb,sig,length);
+        else maketone(tdres,f+hf,levels[il],sig,length);
+        initAuditoryNerve(&anf,model,species[is],tdres,cf,50);
+        runAN2(&anf,sig,up,length);
+        if(k==0) maketone(tdres,f,levels[il]-hdb,sig,length);
+        else maketone(tdres,f-hf,levels[il],sig,length);
+        initAuditoryNerve(&anf,model,species[is],tdres,cf,50);
+        runAN2(&anf,sig,dn,length);
+        tfd += clock()-t0;
+        err[k] = peak[k] = 0;
+        for(i=0; i<length; i++)
+        {
+          fd = (up[i]-dn[i])/(2*((k==0) ? hdb : hf));
+          if(fabs(fd-dout[i+length*k])>err[k]) err[k] = fabs(fd-dout[i+length*k]);
+          if(fabs(fd)>peak[k]) peak[k] = fabs(fd);
+        };
+        if(peak[k]>0) err[k] /= peak[k];
+        if(err[k]>maxerr) maxerr = err[k];
+      };
+      printf("species %d model %d %2.0fdB : sout %.1e  d/dlevel %.1e  d/dfreq %.1e\n",
+             species[is],model,levels[il],serr/speak,err[0],err[1]);
+    };
+    if(maxerr>tol)
+    {
+      printf("species %d model %d FAILED\n",species[is],model);
+      nfail++;
+    };
+  };
+  printf("time runAN2Sens (2 parameters) %.3fs, central differences (4 runAN2) %.3fs\n",
+         tsens/(double)CLOCKS_PER_SEC,tfd/(double)CLOCKS_PER_SEC);
+  free(sig); free(din); free(out); free(dout); free(ref); free(up); free(dn);
+  return((nfail>0) ? 1 : 0);
+}
@@ -0,0 +1,100 @@
+/*
+ * Check of the analytic discharge rate (SGrate, spikes.c) against the PSTH of SGmodel2.
+ *
+ * sout is 100ms: 50 spikes/sec spontaneous, then from 20 to 70ms a 500Hz modulated
+ * drive (300+250*sin) with a 5ms onset of 1500 spikes/sec. For every tdres the
+ * expected spike count of SGrate in bins of 50 samples is compared with the count of
+ * nrep trials of SGmodel2: the largest z-score (count-expected)/sqrt(expected/nrep) and
+ * the mean rates are reported, with the time of SGrate against the trials.
+ * SGrate approximates this PSTH to second order in sout*tdres (see spikes.h): at the
+ * onset it is about 1% higher at tdres=1e-5, which the z-scores resolve only beyond
+ * some 10^5 trials.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -fopenmp -o test_sgrate test_sgrate.c spikes.c -lm
+ *   ./test_sgrate [nrep(5000)] [zmax(5)]
+ * Returns 0 if every bin is within zmax and the mean rates within 1%.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "spikes.h"
+
+#define NTDRES 3
+#define BIN 50
+#define TWOPI 6.28318530717959
+
+int main(int argc, char *argv[])
+{
+  const double tdress[NTDRES] = {1e-5,5e-6,2e-6};
+  const double dur = 0.1;
+  int nrep = 5000;
+  double zmax = 5;
+  double *sout,*rate,*sptime,*trial,*count;
+  double tdres,t,expect,z,maxz,mrate,mtrial,trate,ttrial;
+  clock_t t0;
+  long nspikes,k;
+  int it,n,nbin,i,b,nfail;
+
+  if(argc>1) nrep = atoi(argv[1]);
+  if(argc>2) zmax = atof(argv[2]);
+  nfail = 0;
+  for(it=0; it<NTDRES; it++)
+  {
+    tdres = tdress[it];
+    n = (int)(dur/tdres+0.5);
+    nbin = n/BIN;
+    sout = (double*)malloc(sizeof(double)*n);
+    rate = (double*)malloc(sizeof(double)*n);
+    count = (double*)calloc(nbin,sizeof(double));
+    for(i=0; i<n; i++)
+    {
+      t = i*tdres;
+      sout[i] = ((t>0.02)&&(t<0.07)) ? 300+250*sin(TWOPI*500*t)+((t<0.025) ? 1500 : 0) : 50;
+    };
+    t0 = clock();
+    if(SGrate(tdres,sout,n,rate)<0)
+    {
+      printf("SGrate: out of memory\n");
+      return(1);
+    };
+    trate = (clock()-t0)/(double)CLOCKS_PER_SEC;
+    t0 = clock();
+    nspikes = SGmodel2(tdres,sout,n,nrep,12345,&sptime,&trial);
+    ttrial = (clock()-t0)/(double)CLOCKS_PER_SEC;
+    if(nspikes<0)
+    {
+      printf("SGmodel2: out of memory\n");
+      return(1);
+    };
+    /*/ spike time (j+1)*tdres is sample j */
+    for(k=0; k<nspikes; k++)
+    {
+      i = (int)floor(sptime[k]/tdres+0.5)-1;
+      if((i>=0)&&(i<nbin*BIN)) count[i/BIN] += 1.0/nrep;
+    };
+    maxz = mrate = mtrial = 0;
+    for(b=0; b<nbin; b++)
+    {
+      expect = 0;
+      for(i=b*BIN; i<(b+1)*BIN; i++) expect += rate[i]*tdres;
+      z = (expect>0) ? (count[b]-expect)/sqrt(expect/nrep) : count[b]*nrep;
+      if(fabs(z)>maxz) maxz = fabs(z);
+      mrate += expect;
+      mtrial += count[b];
+    };
+    mrate /= nbin*BIN*tdres;
+    mtrial /= nbin*BIN*tdres;
+    printf("tdres %g : mean rate %.2f, %d trials %.2f, largest z %.2f, time SGrate %.3fs, trials %.3fs",
+           tdres,mrate,nrep,mtrial,maxz,trate,ttrial);
+    if((maxz>zmax)||(fabs(mrate-mtrial)>0.01*mrate))
+    {
+      printf(" FAILED");
+      nfail++;
+    };
+    printf("\n");
+    free(sout); free(rate); free(count); free(sptime); free(trial);
+  };
+  return((nfail>0) ? 1 : 0);
+}
@@ -0,0 +1,76 @@
+/*
+ * Check of the streaming handle (an_arlo_create/process/reset/destroy):
+ * sout computed in chunks of random length must be the same, bit for bit,
+ * as an_arlo() on the whole stimulus, for every species and model.
+ * The stimulus is then run again after an_arlo_reset, in other chunks.
+ *
+ * Build and run (no MATLAB needed):
+ *   cc -O2 -fopenmp -o test_stream test_stream.c runmodel.c ancache.c cmpa.c bmkernel.c hc.c filters.c complex.c synapse.c anpop.c ansens.c -lm
+ *   ./test_stream
+ * Returns 0 if every chunked output is identical.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "runmodel.h"
+#include "cmpa.h"
+
+int an_arlo(double tdres, double cf, double spont, int model, int species, int ifspike,
+	    const double *in, double *out, int length);
+
+static unsigned long seed = 7;
+static int nextrand(int n)
+{
+  seed = (seed*1103515245+12345)&0x7fffffff;
+  return((int)(seed%n));
+}
+
+/*/ run sig through h in chunks of 1..maxchunk samples, count the samples that differ from ref */
+static int runchunks(TANStream *h, const double *sig, const double *ref, double *out, int length, int maxchunk)
+{
+  int i,k,ndiff;
+  for(i=0; i<length; i+=k)
+  {
+    k = 1+nextrand(maxchunk);
+    if(i+k>length) k = length-i;
+    an_arlo_process(h,sig+i,out+i,k);
+  };
+  ndiff = 0;
+  for(i=0; i<length; i++) if(out[i]!=ref[i]) ndiff++;
+  return(ndiff);
+}
+
+int main(void)
+{
+  const int species[] = {0,1,9};
+  const double tdres = 1e-5;
+  const double cf = 1500;
+  const int length = 100000;
+  double *sig,*ref,*out;
+  int is,model,i,n1,n2,nfail;
+  TANStream *h;
+
+  sig = (double*)malloc(sizeof(double)*length);
+  ref = (double*)malloc(sizeof(double)*length);
+  out = (double*)malloc(sizeof(double)*length);
+  /*/ noise at about 70dB SPL plus a 1kHz tone */
+  for(i=0; i<length; i++)
+    sig[i] = 0.2*(2.0*nextrand(1<<30)/(1<<30)-1.0)+0.05*sin(TWOPI*1000*i*tdres);
+
+  nfail = 0;
+  for(is=0; is<3; is++)
+  for(model=1; model<=5; model++)
+  {
+    an_arlo(tdres,cf,50,model,species[is],0,sig,ref,length);
+    h = an_arlo_create(tdres,cf,50,model,species[is],0);
+    n1 = runchunks(h,sig,ref,out,length,977);
+    an_arlo_reset(h);
+    n2 = runchunks(h,sig,ref,out,length,64);
+    an_arlo_destroy(h);
+    printf("species %d model %d : %d and %d samples differ %s\n",species[is],model,n1,n2,
+           (n1+n2==0) ? "ok" : "FAILED");
+    if(n1+n2>0) nfail++;
+  };
+  free(sig); free(ref); free(out);
+  return((nfail>0) ? 1 : 0);
+}
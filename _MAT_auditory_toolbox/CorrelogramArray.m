@@ -2,7 +2,8 @@ function movie = CorrelogramArray(data, sr, frameRate, width)
 % function movie = CorrelogramArray(data, sr, frameRate, width)
 % Compute an array of correlogram frames, from the sound file data with
 % a sampling rate of sr Hz.  Compute frameRate frames per second, using
-% a window size of "width" samples.
+% a window size of "width" samples.  Uses the correlogram MEX
+% function if it is there.
 
 % (c) 1998 Interval Research Corporation
 
@@ -15,10 +16,19 @@ frameIncrement = fix(sr/frameRate);
 frameCount = floor((len-width)/frameIncrement)+1;
 fprintf('Correlogram spacing is %g samples per frame.\n', frameIncrement);
 
-movie = zeros(channels*width, frameCount);
+useMex = exist('correlogram') == 3;
+if useMex
+	movie = correlogram(data, width, frameIncrement, frameIncrement*4);
+else
+	movie = zeros(channels*width, frameCount);
+end
 for i=1:frameCount
-	start = (i-1)*frameIncrement + 1;
-	pic = CorrelogramFrame(data, width, start, frameIncrement*4);
+	if useMex
+		pic = reshape(movie(:,i), channels, width);
+	else
+		start = (i-1)*frameIncrement + 1;
+		pic = CorrelogramFrame(data, width, start, frameIncrement*4);
+	end
 		minimum = min(min(pic));
 		maximum = max(max(pic));
 		image((pic-minimum)/(maximum-minimum)*length(colormap));
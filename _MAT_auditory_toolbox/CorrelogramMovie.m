@@ -2,7 +2,8 @@ function movie = CorrelogramMovie(data, sr, frameRate, width)
 % function movie = CorrelogramMovie(data, sr, frameRate, width)
 % Compute a Matlab movie of a sound array called "data" which has
 % a sampling rate of sr Hz.  Compute frameRate frames per second, each
-% time taking "width" samples for analysis.
+% time taking "width" samples for analysis.  Uses the correlogram MEX
+% function if it is there, a few frames at a time.
 
 % (c) 1998 Interval Research Corporation
 
@@ -14,10 +15,20 @@ if nargin < 4, width = 256; end
 frameIncrement = fix(sr/frameRate);
 frameCount = floor((len-width)/frameIncrement)+1;
 
+useMex = exist('correlogram') == 3;
+blockSize = 16;
 movie = moviein(frameCount);
 for i=1:frameCount
-	start = (i-1)*frameIncrement + 1;
-	pic = CorrelogramFrame(data, width, start, frameIncrement*2);
+	if useMex
+		if rem(i-1, blockSize) == 0
+			block = correlogram(data, width, frameIncrement, ...
+				frameIncrement*2, i:min(frameCount, i+blockSize-1));
+		end
+		pic = reshape(block(:,rem(i-1, blockSize)+1), channels, width);
+	else
+		start = (i-1)*frameIncrement + 1;
+		pic = CorrelogramFrame(data, width, start, frameIncrement*2);
+	end
 		minimum = min(min(pic));
 		maximum = max(max(pic));
 		image((pic-minimum)/(maximum-minimum)*length(colormap));
@@ -52,6 +52,17 @@ if 0
 	[tar1 tar2 tar3 tar4; eps1 eps2 eps3 eps4]
 end
 
+if exist('lyonear') == 3		%% Compiled: all in one pass, no
+	if agcf > 0			%% full rate matrices.
+		agcParms = [tar1 tar2 tar3 tar4; eps1 eps2 eps3 eps4];
+	else
+		agcParms = [];
+	end
+	y = lyonear(x, earFilters, agcParms, decFilt, df, differ);
+	y = y(3:nChannels,:);
+	return;
+end
+
 for i=0:nOutputSamples-1
 	[sosOutput sosState]= soscascade(x(i*df+1:i*df+df), earFilters, ...  
 				sosState);
@@ -25,3 +25,27 @@ sosfilters([1 0 0 0 0 0;2 0 0 0 0 0], [1 0 0 -.9 0])
 sosfilters([1 zeros(1,9)], [1 0 0 -.9 0; 1 0 0 -.8 0])
 [output,s] = sosfilters([1 zeros(1,4)], [1 0 0 -.9 0; 1 0 0 -.8 0])
 sosfilters(zeros(1,5), [1 0 0 -.9 0; 1 0 0 -.8 0], s)
+
+mex lyonear.c -O
+f = DesignLyonFilters(16000);
+x = randn(1,4000);
+[y1,s] = lyonear(x(1:2000), f, [.0032;.0014], [0 0 1 -1.99 .99], 20, 1);
+max(max(abs([y1 lyonear(x(2001:4000), f, [.0032;.0014], [0 0 1 -1.99 .99], 20, 1, s)] - ...
+	lyonear(x, f, [.0032;.0014], [0 0 1 -1.99 .99], 20, 1))))
+
+mex correlogram.c -O
+c = rand(4, 1000);
+pic = CorrelogramFrame(c, 64, 101, 256);
+max(max(abs(pic - reshape(correlogram(c, 64, 100, 256, 2), 4, 64))))
+
+mex invlyonear.c -O
+c = rand(2,300);
+f = [1 0 0 -.9 0;1 1 0 0 0];
+[y1,s] = invlyonear(c(:,1:100), f, [.5;.5], []);
+[y1 invlyonear(c(:,101:300), f, [.5;.5], [], s)] - ...
+	invsoscascade(inverseagc(c, [.5;.5]), f)
+
+mex meddishaircellmex.c -O
+x = rand(4, 200);
+[y1, s] = meddishaircellmex(x(:,1:100), 16000);
+meddishaircellmex(x, 16000) - [y1 meddishaircellmex(x(:,101:200), 16000, 0, s)]
@@ -11,6 +11,11 @@ function y = MeddisHairCell(data,sampleRate,subtractSpont)
 
 if (nargin<3),  subtractSpont=0;  end
 
+if exist('meddishaircellmex') == 3	% Compiled, the same model
+	y = meddishaircellmex(data, sampleRate, subtractSpont);
+	return;
+end
+
 % Parameters from Meddis' April 1990 JASA paper.
 M = 1;
 A = 5;
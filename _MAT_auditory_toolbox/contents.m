@@ -13,6 +13,10 @@
 %   FreqResp           - Evaluate frequency response of the filter
 %   LyonPassiveEar     - Calculate auditory nerve responses using
 %                        Lyon's passive cochlear model
+%   lyonear            - LyonPassiveEar in one pass (cascade, agc and
+%                        decimation), with explicit state
+%   invlyonear         - Invert a cochleagram (inverseagc and
+%                        invsoscascade in one pass)
 %   SecondOrderSection - Design a second order filter section
 %   SetGain            - Set the gain of a second order system
 %   soscascade         - Implement a cascade of second order filters
@@ -23,6 +27,7 @@
 %   MakeERBFilters     - Design for ERB cochlear model
 %   ERBFilterBank      - Implement a bank of ERB Gammatone filters
 %   MeddisHairCell     - Implement Meddis' Inner Hair Cell Model
+%   meddishaircellmex  - The same, compiled, with explicit state
 %
 % Seneff Auditory Model
 %   SeneffEar          - Implement Stages I/II of Seneff's Auditory Model
@@ -33,6 +38,8 @@
 %   CorrelogramFrame   - Compute a single correlogram frame
 %   CorrelogramMovie   - Compute a Matlab movie of a correlogram
 %   CorrelogramPitch   - Compute the pitch of a signal with a correlogram
+%   correlogram        - Compute many correlogram frames, and their
+%                        summary, with FFTs
 %
 % Signal Processing.
 %   mfcc               - Mel-frequency cepstral coefficient transform of
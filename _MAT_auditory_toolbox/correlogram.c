@@ -0,0 +1,469 @@
+/* =======================================================================
+*		correlogram.c	Correlogram frames of a cochleagram, the
+*				autocorrelation of each channel computed
+*				with FFTs.  This is CorrelogramFrame for
+*				many frames in one call.
+*
+*		[movie, summary] = correlogram(data, picWidth,
+*				frameIncrement, winLen, frames)
+*		summary = correlogram(data, picWidth, frameIncrement,
+*				winLen, frames, 'summary')
+* ========================================================================*/
+
+/*
+ *	data is channels x samples.  Frame i starts at sample
+ *	(i-1)*frameIncrement+1, and is CorrelogramFrame(data, picWidth,
+ *	start, winLen) reshaped into column i of movie, as in
+ *	CorrelogramArray.  frames (default, or [], all the frames that
+ *	CorrelogramArray computes, floor((samples-picWidth)/frameIncrement)+1)
+ *	picks the frames to compute, so that a long movie can be computed
+ *	a few frames at a time.  summary(:,i) is the sum of frame i over
+ *	the channels, the summary correlogram CorrelogramPitch looks for
+ *	the pitch in:
+ *	>> summary = correlogram(data, 256, 1333, 2666, [], 'summary');
+ *	>> pitch = CorrelogramPitch(summary, 256, sr);
+ *	With 'summary' the frames themselves are not kept.
+ *
+ *	To check against CorrelogramFrame (the same up to rounding)
+ *	>> data = rand(4, 1000);
+ *	>> pic = CorrelogramFrame(data, 64, 101, 256);
+ *	>> movie = correlogram(data, 64, 100, 256, 2);
+ *	>> max(max(abs(pic - reshape(movie, 4, 64))))
+ *
+ *	The FFTs are long enough for the first picWidth lags not to wrap
+ *	around, which is often half of CorrelogramFrame's.  The FFT tables
+ *	and the window are computed once (and kept for the next call with
+ *	the same sizes).  Two channels are transformed
+ *	together, as the real and imaginary parts of one complex FFT, and
+ *	kPairs such pairs go through the butterflies side by side (SIMD
+ *	lanes, with optimization, e.g. -O3 -march=native).  The power
+ *	spectra are real and even, so the same forward FFT gives both
+ *	autocorrelations back.  Compiled with OpenMP (CFLAGS='$CFLAGS
+ *	-fopenmp' LDFLAGS='$LDFLAGS -fopenmp') the frames are computed on
+ *	several threads.
+ */
+
+#define	pDATAM			prhs[0]
+#define	pWIDTHM			prhs[1]
+#define	pINCREMENTM		prhs[2]
+#define	pWINLENM		prhs[3]
+#define	pFRAMESM		prhs[4]
+#define	pMODEM			prhs[5]
+
+#define	kPairs			8	/* Channel pairs in an FFT batch */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include 	<math.h>
+#include	"mex.h"
+#ifdef	_OPENMP
+#include	<omp.h>
+#endif
+
+#ifndef	DOUBLE
+#define	DOUBLE	double
+#endif
+
+#ifndef	INT
+#define	INT	int
+#endif
+
+#ifndef	M_PI
+#define	M_PI	3.14159265358979323846
+#endif
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define	RESTRICT	restrict
+#elif defined(__GNUC__) || defined(_MSC_VER)
+#define	RESTRICT	__restrict
+#else
+#define	RESTRICT
+#endif
+
+					/* The FFT tables and the window, kept
+					 * from one call to the next.
+					 */
+typedef struct {
+	INT	fftSize, winLen;
+	INT	*bitReverse;
+	DOUBLE	*twiddleRe, *twiddleIm;	/* [h+j] = exp(-pi i j/h), j<h */
+	DOUBLE	*window;
+} CorrelogramPlan;
+
+					/* Everything else, filled in by
+					 * CheckArguments().
+					 */
+typedef struct {
+	const DOUBLE	*data;
+	INT	nChannels, nSamples;
+	INT	picWidth, frameIncrement, winLen, fftSize;
+	INT	nFrames, *frames;	/* Frame numbers, from 0 */
+	DOUBLE	*movie, *summary;	/* Outputs, or 0 */
+	mxArray	*movieMatrix, *summaryMatrix;
+} Correlogram;
+
+static CorrelogramPlan	plan;
+
+/* =====================================================================*/
+/*	The plan for an FFT of fftSize points and a window of winLen.	*/
+
+static void ClearPlan(void)
+{
+	free(plan.bitReverse);
+	free(plan.twiddleRe);
+	free(plan.twiddleIm);
+	free(plan.window);
+	memset(&plan, 0, sizeof(plan));
+}
+
+static int MakePlan(INT fftSize, INT winLen)
+{
+	INT	i, j, h, bits;
+	DOUBLE	a = .54, b = -.46, wr = sqrt(64.0/256), phi = M_PI/winLen;
+
+	if (plan.fftSize == fftSize && plan.winLen == winLen)
+		return 0;
+	ClearPlan();
+	plan.bitReverse = (INT *)malloc(fftSize*sizeof(INT));
+	plan.twiddleRe = (DOUBLE *)malloc(fftSize*sizeof(DOUBLE));
+	plan.twiddleIm = (DOUBLE *)malloc(fftSize*sizeof(DOUBLE));
+	plan.window = (DOUBLE *)malloc(winLen*sizeof(DOUBLE));
+	if (!plan.bitReverse || !plan.twiddleRe || !plan.twiddleIm ||
+	    !plan.window){
+		ClearPlan();
+		return 1;
+	}
+	for (bits=0; (1<<bits) < fftSize; bits++)
+		;
+	for (i=0; i<fftSize; i++){
+		INT	r = 0;
+
+		for (j=0; j<bits; j++)
+			if (i & (1<<j))
+				r |= 1 << (bits-1-j);
+		plan.bitReverse[i] = r;
+	}
+					/* The twiddles of each stage, in a
+					 * row, for blocks of 2h points.
+					 */
+	for (h=1; h<fftSize; h*=2)
+		for (j=0; j<h; j++){
+			plan.twiddleRe[h+j] = cos(M_PI*j/h);
+			plan.twiddleIm[h+j] = -sin(M_PI*j/h);
+		}
+					/* The window of CorrelogramFrame */
+	for (i=0; i<winLen; i++)
+		plan.window[i] = 2*wr/sqrt(4*a*a+2*b*b)*
+			(a + b*cos(2*M_PI*i/winLen + phi));
+	plan.fftSize = fftSize;
+	plan.winLen = winLen;
+	mexAtExit(ClearPlan);
+	return 0;
+}
+
+/* =====================================================================*/
+/*	Function to determine if arguments are valid. 			*/
+/*	Also fill in some pointers we will need later.			*/
+
+static int CheckArguments(int nlhs, mxArray *plhs[],
+				int nrhs, const mxArray *prhs[], Correlogram *p){
+	INT	i, n, p2, maxFrames;
+	int	summaryOnly = 0;
+	char	mode[20];
+
+	if (nrhs < 4 || nrhs > 6 || nlhs > 2){
+		printf("Incorrect calling syntax:\n [movie, summary] = ");
+		printf("correlogram(data, picWidth, frameIncrement, winLen, "
+			"frames)\n");
+		printf(" summary = correlogram(data, picWidth, "
+			"frameIncrement, winLen, frames, 'summary')\n");
+		printf("        data is channels x samples\n");
+		printf("        movie is channels*picWidth x frames\n");
+		printf("        summary is picWidth x frames\n");
+		return 1;
+	}
+
+	if (!mxIsDouble(pDATAM) || mxIsComplex(pDATAM) ||
+	    mxGetM(pDATAM)*mxGetN(pDATAM) == 0){
+		printf("The data must be a real, non empty array\n");
+		return 1;
+	}
+	p->data = mxGetPr(pDATAM);
+	p->nChannels = mxGetM(pDATAM);
+	p->nSamples = mxGetN(pDATAM);
+	p->picWidth = (INT)mxGetScalar(pWIDTHM);
+	p->frameIncrement = (INT)mxGetScalar(pINCREMENTM);
+	p->winLen = (INT)mxGetScalar(pWINLENM);
+	if (p->picWidth < 3 || p->frameIncrement < 1 || p->winLen < 1){
+		printf("picWidth must be 3 at least, frameIncrement and "
+			"winLen 1\n");
+		return 1;
+	}
+					/* Long enough that the first picWidth
+					 * lags don't wrap around (half the
+					 * size of CorrelogramFrame's, often).
+					 */
+	n = p->winLen + p->picWidth - 1;
+	for (p2=2; p2<n; p2*=2)
+		;
+	p->fftSize = p2;
+
+/*------------ The frames, and the mode ------------------------------ */
+	maxFrames = (p->nSamples - p->picWidth)/p->frameIncrement + 1;
+	if (p->nSamples < p->picWidth)
+		maxFrames = 0;
+	if (nrhs > 4 && !mxIsEmpty(pFRAMESM)){
+		p->nFrames = mxGetM(pFRAMESM)*mxGetN(pFRAMESM);
+		p->frames = (INT *)mxCalloc(p->nFrames, sizeof(INT));
+		for (i=0; i<p->nFrames; i++){
+			DOUBLE	f = mxGetPr(pFRAMESM)[i];
+
+			if (f < 1 || f != floor(f)){
+				printf("Frame numbers must be positive "
+					"integers\n");
+				return 1;
+			}
+			p->frames[i] = (INT)f - 1;
+		}
+	} else {
+		p->nFrames = maxFrames;
+		p->frames = (INT *)mxCalloc(p->nFrames > 0 ? p->nFrames : 1,
+			sizeof(INT));
+		for (i=0; i<p->nFrames; i++)
+			p->frames[i] = i;
+	}
+	if (nrhs > 5){
+		if (!mxIsChar(pMODEM) || mxGetString(pMODEM, mode,
+		    sizeof(mode)) || strcmp(mode, "summary")){
+			printf("The only mode is 'summary'\n");
+			return 1;
+		}
+		summaryOnly = 1;
+	}
+
+/*-------------------- Create the output matrices ---------------------*/
+	p->movieMatrix = p->summaryMatrix = 0;
+	p->movie = p->summary = 0;
+	if (!summaryOnly){
+		p->movieMatrix = mxCreateDoubleMatrix(
+			p->nChannels*p->picWidth, p->nFrames, mxREAL);
+		p->movie = mxGetPr(p->movieMatrix);
+	}
+	if (summaryOnly || nlhs > 1){
+		p->summaryMatrix = mxCreateDoubleMatrix(p->picWidth,
+			p->nFrames, mxREAL);
+		p->summary = mxGetPr(p->summaryMatrix);
+	}
+
+	return 0;
+}
+
+/* =======================================================================*/
+/*	An FFT of kPairs signals side by side, x[n*kPairs+b], in	*/
+/*	place, the input in bit reversed order.  Two radix 2 stages at	*/
+/*	a time: the blocks of h points are combined into blocks of 4h.	*/
+
+static void BatchFFT(DOUBLE *RESTRICT re, DOUBLE *RESTRICT im, INT fftSize)
+{
+	const DOUBLE	*twRe = plan.twiddleRe, *twIm = plan.twiddleIm;
+	INT	h, g, j, b, stages;
+
+	for (stages=0; (1<<stages) < fftSize; stages++)
+		;
+	h = 1;
+	if (stages % 2){			/* One radix 2 stage first */
+		for (g=0; g<fftSize; g+=2){
+			DOUBLE	*r0 = &re[g*kPairs], *i0 = &im[g*kPairs];
+			DOUBLE	*r1 = r0 + kPairs, *i1 = i0 + kPairs;
+
+			for (b=0; b<kPairs; b++){
+				DOUBLE	xr = r0[b], xi = i0[b];
+
+				r0[b] = xr + r1[b];
+				i0[b] = xi + i1[b];
+				r1[b] = xr - r1[b];
+				i1[b] = xi - i1[b];
+			}
+		}
+		h = 2;
+	}
+	for (; h<fftSize; h*=4){
+		for (g=0; g<fftSize; g+=4*h){
+			for (j=0; j<h; j++){
+				DOUBLE	c1 = twRe[h+j], s1 = twIm[h+j];
+				DOUBLE	c2 = twRe[2*h+j], s2 = twIm[2*h+j];
+				DOUBLE	c3 = twRe[3*h+j], s3 = twIm[3*h+j];
+				DOUBLE	*r0 = &re[(g+j)*kPairs], *i0 = &im[(g+j)*kPairs];
+				DOUBLE	*r1 = r0 + h*kPairs, *i1 = i0 + h*kPairs;
+				DOUBLE	*r2 = r1 + h*kPairs, *i2 = i1 + h*kPairs;
+				DOUBLE	*r3 = r2 + h*kPairs, *i3 = i2 + h*kPairs;
+
+				for (b=0; b<kPairs; b++){
+					DOUBLE	tr, ti, ar, ai, br, bi, cr, ci;
+					DOUBLE	dr, di, vr, vi, xr, xi;
+
+					tr = c1*r1[b] - s1*i1[b];
+					ti = c1*i1[b] + s1*r1[b];
+					ar = r0[b] + tr;  ai = i0[b] + ti;
+					br = r0[b] - tr;  bi = i0[b] - ti;
+					tr = c1*r3[b] - s1*i3[b];
+					ti = c1*i3[b] + s1*r3[b];
+					cr = r2[b] + tr;  ci = i2[b] + ti;
+					dr = r2[b] - tr;  di = i2[b] - ti;
+					vr = c2*cr - s2*ci;
+					vi = c2*ci + s2*cr;
+					xr = c3*dr - s3*di;
+					xi = c3*di + s3*dr;
+					r0[b] = ar + vr;  i0[b] = ai + vi;
+					r2[b] = ar - vr;  i2[b] = ai - vi;
+					r1[b] = br + xr;  i1[b] = bi + xi;
+					r3[b] = br - xr;  i3[b] = bi - xi;
+				}
+			}
+		}
+	}
+}
+
+/* =======================================================================*/
+/*	Frame k (column k of the outputs), using the buffers of 4 x	*/
+/*	fftSize x kPairs values at buffer.				*/
+
+static void ComputeFrame(Correlogram *p, INT k, DOUBLE *buffer)
+{
+	INT	N = p->fftSize, C = p->nChannels, W = p->picWidth;
+	DOUBLE	*re = buffer, *im = re + N*kPairs;
+	DOUBLE	*pr = im + N*kPairs, *pi = pr + N*kPairs;
+	DOUBLE	*movie, *summary, r0, r1, r2, scale;
+	INT	start, segLen, c0, c, n, m, b, lag;
+	const DOUBLE	*x;
+
+	start = p->frames[k]*p->frameIncrement;
+	segLen = p->nSamples - start;
+	if (segLen > p->winLen)
+		segLen = p->winLen;
+	movie = p->movie ? &p->movie[(size_t)k*C*W] : 0;
+	summary = p->summary ? &p->summary[(size_t)k*W] : 0;
+	if (summary)
+		for (lag=0; lag<W; lag++)
+			summary[lag] = 0;
+
+	for (c0=0; c0<C; c0+=2*kPairs){
+				/* Channels c0+2b and c0+2b+1 windowed into
+				 * the real and imaginary parts of signal b.
+				 */
+		memset(re, 0, 2*N*kPairs*sizeof(DOUBLE));
+		for (n=0; n<segLen; n++){
+			DOUBLE	w = plan.window[n];
+			INT	r = plan.bitReverse[n]*kPairs;
+
+			x = &p->data[(size_t)(start+n)*C];
+			for (b=0; b<kPairs; b++){
+				c = c0 + 2*b;
+				if (c < C)
+					re[r+b] = w*x[c];
+				if (c+1 < C)
+					im[r+b] = w*x[c+1];
+			}
+		}
+		BatchFFT(re, im, N);
+
+				/* The power spectra of the two channels,
+				 * from Z(k) and Z(N-k), into pr + i pi.
+				 */
+		for (n=0; n<N; n++){
+			INT	r = plan.bitReverse[n]*kPairs;
+			DOUBLE	*zr = &re[n*kPairs], *zi = &im[n*kPairs];
+			DOUBLE	*yr, *yi;
+
+			m = (N - n) % N;
+			yr = &re[m*kPairs];
+			yi = &im[m*kPairs];
+			for (b=0; b<kPairs; b++){
+				DOUBLE	sr = zr[b] + yr[b], di = zi[b] - yi[b];
+				DOUBLE	si = zi[b] + yi[b], dr = zr[b] - yr[b];
+
+				pr[r+b] = (sr*sr + di*di)/4;
+				pi[r+b] = (si*si + dr*dr)/4;
+			}
+		}
+		BatchFFT(pr, pi, N);
+
+				/* The first picWidth lags, normalized by the
+				 * energy if lag 0 is a peak, else zero.
+				 */
+		for (b=0; b<2*kPairs && c0+b<C; b++){
+			DOUBLE	*r = (b%2) ? pi : pr;
+			INT	bb = b/2;
+
+			c = c0 + b;
+			r0 = r[0*kPairs+bb]/N;
+			r1 = r[1*kPairs+bb]/N;
+			r2 = r[2*kPairs+bb]/N;
+			scale = (r0 > r1 && r0 > r2) ? 1/(N*sqrt(r0)) : 0;
+			if (movie)
+				for (lag=0; lag<W; lag++)
+					movie[(size_t)lag*C + c] = 
+						r[lag*kPairs+bb]*scale;
+			if (summary)
+				for (lag=0; lag<W; lag++)
+					summary[lag] += r[lag*kPairs+bb]*scale;
+		}
+	}
+}
+
+/* =======================================================================*/
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+	Correlogram	correlogram, *p = &correlogram;
+	INT	k;
+	int	failed = 0;
+
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, p) ){
+		mexErrMsgTxt("correlogram argument checking failed.");
+		return ;
+	}
+	if (MakePlan(p->fftSize, p->winLen)){
+		mexErrMsgTxt("correlogram: out of memory.");
+		return ;
+	}
+
+#ifdef	_OPENMP
+#pragma omp parallel if(p->nFrames > 1)
+#endif
+	{
+		DOUBLE	*buffer;
+
+		buffer = (DOUBLE *)malloc(4*(size_t)p->fftSize*kPairs*
+			sizeof(DOUBLE));
+		if (!buffer){
+#ifdef	_OPENMP
+#pragma omp atomic
+#endif
+			failed |= 1;
+		}
+#ifdef	_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+		for (k=0; k<p->nFrames; k++)
+			if (buffer)
+				ComputeFrame(p, k, buffer);
+		free(buffer);
+	}
+	mxFree(p->frames);
+	if (failed){
+		if (p->movieMatrix)
+			mxDestroyArray(p->movieMatrix);
+		if (p->summaryMatrix)
+			mxDestroyArray(p->summaryMatrix);
+		mexErrMsgTxt("correlogram: out of memory.");
+		return ;
+	}
+						/* Assign output pointers */
+	if (p->movieMatrix){
+		plhs[0] = p->movieMatrix;
+		if (p->summaryMatrix)
+			plhs[1] = p->summaryMatrix;
+	} else
+		plhs[0] = p->summaryMatrix;
+}
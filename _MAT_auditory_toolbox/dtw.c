@@ -38,122 +38,294 @@
  * Columns 13 through 16
  *
  *     15    15    16    16
+ *
+ * Only part of the array has to be searched, which saves most of the
+ * time and the memory on long signals:
+ *	>> [err,p1,p2] = dtw(s1, s2, 'itakura');
+ * searches only the cells a path with slopes between 1/2 and 2 can go
+ * through (the same result as the full search, in about a third of it);
+ *	>> [err,p1,p2] = dtw(s1, s2, 'sakoe', r);
+ * only the cells within r frames of the diagonal (Sakoe-Chiba band);
+ *	>> [err,p1,p2] = dtw(s1, s2, 'fast', r);
+ * the FastDTW search: the path found on the signals averaged over pairs
+ * of frames (recursively), widened by r frames (default 10).  The last
+ * two are approximations; they may find a larger error than the best.
+ * The memory is a byte per cell searched (the full search needs 9), and
+ * the local distances are only computed for the cells searched.
+ *
+ * To match queries against a library of templates, load them once
+ *	>> dtw('load', {t1, t2, ...}, r);
+ * (KxNi each, searched with the Sakoe-Chiba band of radius r), then
+ *	>> [err,index,p1,p2] = dtw('search', s2, k);
+ * gives the k templates closest to s2, best first: err(m) is
+ * dtw(templates{index(m)}, s2, 'sakoe', r) and p1{m}, p2{m} its paths.
+ * A template is only searched if two lower bounds of its error are no
+ * more than the k-th best error so far: LB_Kim (the first, second and
+ * last cells, which every path goes through), then LB_Keogh (each frame
+ * of s2 against the envelope of the template frames it can be matched
+ * to, computed at load time).  The searches run on several threads
+ * with OpenMP, and give up as soon as the error can't be small enough.
+ * dtw('clear') frees the templates.
  */
 
 #include	<stdlib.h>
+#include	<string.h>
 #include	<math.h>
+#ifdef	_OPENMP
+#include	<omp.h>
+#endif
 
 #ifndef	HUGE
 	#define	HUGE	1e30
 #endif
 
-#define	s1(r,c)    v1[(r-1) + (c-1)*(d)]
-#define	s2(r,c)    v2[(r-1) + (c-1)*(d)]
-#define	ldist(i,j) larray[(i-1)+(j-1)*l1]
-#define	gdist(i,j) garray[(i-1)+(j-1)*l1]
-#define	path(i,j)  parray[(i-1)+(j-1)*l1]
 #define	path1(i)   p1vector[i-1]
 #define	path2(i)   p2vector[i-1]
 
 #ifdef	MATLAB
 #define	DATA	double
-#define	INDEX	short
 #else
 #define	DATA	float
-#define	INDEX	char
 #endif
+#define	INDEX	int			/* Frame numbers, any length */
+
+#define	kFastRadius	10		/* Default of dtwfast() */
+#define	kBoundSlack	1e-3		/* Bounds in double, errors in float */
+
+/*
+ * A template library: each template transposed, t[n][k*l+i-1] for
+ * frame i of length[n], followed by its upper and lower envelopes (the
+ * largest and smallest value of feature k within radius frames of i).
+ */
+typedef struct {
+	int	nTemplates;	/* Number of templates */
+	int	d;		/* Features per frame */
+	int	radius;		/* Of the Sakoe-Chiba band */
+	int	*length;	/* Frames of each template */
+	DATA	**t;		/* Transposed templates and envelopes */
+} DtwLibrary;
 
 DATA dtw(DATA *v1, int l1, DATA *v2, int l2, int d, INDEX **pp1, INDEX **pp2);
+DATA dtwwindow(DATA *v1, int l1, DATA *v2, int l2, int d, 
+	const int *lo, const int *hi, INDEX **pp1, INDEX **pp2);
+DATA dtwitakura(DATA *v1, int l1, DATA *v2, int l2, int d, 
+	INDEX **pp1, INDEX **pp2);
+DATA dtwsakoe(DATA *v1, int l1, DATA *v2, int l2, int d, int radius,
+	INDEX **pp1, INDEX **pp2);
+DATA dtwfast(DATA *v1, int l1, DATA *v2, int l2, int d, int radius,
+	INDEX **pp1, INDEX **pp2);
+DtwLibrary *dtwlibrary(DATA **templates, const int *lengths, int n, int d,
+	int radius);
+void dtwfreelibrary(DtwLibrary *lib);
+int dtwsearch(const DtwLibrary *lib, DATA *v2, int l2, int k, int *index,
+	DATA *error, INDEX **pp1, INDEX **pp2);
 
+/*
+ * All the searches return the error, or -1 if out of memory, and the
+ * path vectors (allocated with malloc, the caller frees them) if pp1
+ * and pp2 are not 0.  dtwlibrary() returns 0 if out of memory;
+ * dtwsearch() returns the number of templates found (at most k, only
+ * those with a path in the band), or -1 if out of memory, with their
+ * numbers (from 0), errors and paths (arrays of k pointers) best first.
+ */
+
+/*
+ * The full search.
+ */
 DATA dtw(DATA *v1, int l1, DATA *v2, int l2, int d, INDEX **pp1, INDEX **pp2){
-	float 	ldist;
-	int	i, j, k, p1, p2;/* General Indices */
+	int	*lo, *hi, j;
+	DATA	error;
+
+	lo = (int *)malloc((l2+1)*sizeof(*lo));
+	hi = (int *)malloc((l2+1)*sizeof(*hi));
+	if (!lo || !hi){
+		free(lo); free(hi);
+		return -1;
+	}
+	for (j=1; j<=l2; j++){
+		lo[j] = 1;
+		hi[j] = l1;
+	}
+	error = dtwwindow(v1, l1, v2, l2, d, lo, hi, pp1, pp2);
+	free(lo); free(hi);
+	return error;
+}
+
+/*
+ * The search of a window of the array: rows lo[j] to hi[j] of column
+ * j, for j=1..l2 (lo and hi have l2+1 elements, element 0 is not
+ * used).  Cells outside of the window are never on the path.  With
+ * the whole array as the window this gives the same error and path as
+ * the original full search.
+ *
+ * The global distance of a cell only depends on the two columns
+ * before it, so only three columns of global distances and two of
+ * local distances are kept (full length, HUGE outside of the window)
+ * and the cells of a column are independent of each other: both the
+ * local distances (summed over the features in the same order for
+ * each cell, from a transposed copy of s1) and the global distances
+ * of a column are computed in loops over the rows that vectorize.
+ * Only the path directions of the window are stored, a byte a cell.
+ *
+ * DtwColumns() does the search from s1 already transposed.  Without
+ * pp1 and pp2 it doesn't keep the directions at all; with rest (l2+1
+ * elements, rest[j] a lower bound of the distances of the columns
+ * after j) it gives up, returning HUGE, as soon as no path can have an
+ * error of abandon or less.
+ */
+static DATA DtwColumns(const DATA *t1, int l1, const DATA *v2, int l2, int d,
+	const int *lo, const int *hi, const double *rest, double abandon,
+	INDEX **pp1, INDEX **pp2){
+	int	i, j, k, p1, p2, i0, i1;/* General Indices */
 	int	topPath, midPath, botPath;
-	float	*larray;	/* Local Distance Array */
-	float	*garray;	/* Global Distance Array */
+	float	*columns;	/* Local and global distance columns */
+	float	*g, *gp, *gpp, *lc, *lp;
+	int	wlo[5], whi[5];	/* Rows written in each column */
+	size_t	*offset, n;	/* Of each column in parray */
 	char	*parray;	/* Path Array */
 	INDEX	*p1vector;	/* Path 1 vector */
 	INDEX	*p2vector;	/* Path 1 vector */
 	DATA	error;		/* Return value */
+	float	colMin, prevMin;	/* Of the last two columns */
+	int	paths = pp1 || pp2;
 
+/* We're only going to allow slopes of 2,1,.5.  */
+	topPath=1;
+	midPath=2;
+	botPath=3;
 
-/*
- * Now figure out all the relative distances all at once.  We'll
- * never use the outside corners of this array, but it's easier
- * to calculate all at once.
- * ldist=zeros(l1, l2);
- * for i=1:l1
- * 	for j=1:l2
- * 		ldist(i,j) = sum((s1(:,i)-s2(:,j)).^2);
- * 	end
- * end
-*/
-	larray = (float *)malloc(sizeof(*larray)*l1*l2);
-	if (!larray)
-		return 0;
-
-	for (i=1; i<=l1; i++){
-		for (j=1; j<=l2; j++){
-			float	diff, sum;
-
-			sum = 0;
-			for (k=1; k<=d; k++){
-				diff = s1(k,i)-s2(k,j);
-				sum += diff*diff;
+	columns = (float *)malloc(sizeof(*columns)*5*(size_t)(l1+1));
+	offset = 0;
+	parray = 0;
+	p1vector = p2vector = 0;
+	if (paths){
+		offset = (size_t *)malloc((l2+2)*sizeof(*offset));
+		p1vector = (INDEX *)calloc(l1, sizeof(*p1vector));
+		p2vector = (INDEX *)calloc(l2, sizeof(*p2vector));
+		if (offset && columns && p1vector && p2vector){
+			n = 0;
+			for (j=1; j<=l2; j++){
+				offset[j] = n;
+				if (hi[j] >= lo[j])
+					n += hi[j] - lo[j] + 1;
 			}
-			ldist(i,j) = sum;
+			offset[l2+1] = n;
+			parray = (char *)malloc(n > 0 ? n : 1);
 		}
 	}
+	if (!columns || (paths && !parray)){
+		free(offset); free(columns); free(p1vector); free(p2vector);
+		return -1;
+	}
+	for (i=0; i<5*(l1+1); i++)
+		columns[i] = HUGE;
+	for (k=0; k<5; k++){
+		wlo[k] = 1;
+		whi[k] = 0;
+	}
+	prevMin = HUGE;
 
-/* We're only going to allow slopes of 2,1,.5.  */
-	topPath=1;
-	midPath=2;
-	botPath=3;
+/* g is column j of global distances (column j%3 of the first three),
+ * gp and gpp the two before it; lc and lp the local distances of
+ * columns j and j-1 (columns 3+j%2).
+ */
+	for (j=1; j<=l2; j++){
+		g = &columns[(j%3)*(size_t)(l1+1)];
+		gp = &columns[((j+2)%3)*(size_t)(l1+1)];
+		gpp = &columns[((j+1)%3)*(size_t)(l1+1)];
+		lc = &columns[(3+j%2)*(size_t)(l1+1)];
+		lp = &columns[(3+(j+1)%2)*(size_t)(l1+1)];
+		i0 = lo[j] < 1 ? 1 : lo[j];
+		i1 = hi[j] > l1 ? l1 : hi[j];
 
-/* We'll fill the global distance array with infinities. */
-	
-	garray = (float *)malloc(sizeof(*garray)*l1*l2);
-	parray = (char *)malloc(sizeof(*parray)*l1*l2);
-	if (!garray || !parray)
-		return 0;
+		for (i=wlo[j%3]; i<=whi[j%3]; i++)
+			g[i] = HUGE;
+		for (i=wlo[3+j%2]; i<=whi[3+j%2]; i++)
+			lc[i] = HUGE;
+		wlo[j%3] = wlo[3+j%2] = i0;
+		whi[j%3] = whi[3+j%2] = i1;
 
-	for (i=1; i<=l1; i++){
-		for (j=1; j<=l2; j++){
-			gdist(i, j) = HUGE;
-			path(i,j) = -1;
+/* The local distances of the column,
+ * ldist(i,j) = sum((s1(:,i)-s2(:,j)).^2);
+ */
+		if (i1 >= i0){
+			for (i=i0; i<=i1; i++)
+				lc[i] = 0;
+			for (k=1; k<=d; k++){
+				const DATA *t = &t1[(k-1)*(size_t)l1 - 1];
+				DATA	s = v2[(k-1) + (j-1)*(size_t)d];
+
+				for (i=i0; i<=i1; i++){
+					float	diff = t[i] - s;
+
+					lc[i] += diff*diff;
+				}
+			}
 		}
-	}
 
 /* The first two directions are fixed.  They have to be the 
- * middle path.
+ * middle path.  Anything else before row and column 3 can't be
+ * reached.
  */
-	gdist(1,1) = ldist(1,1);
-	path(1,1) = midPath;
-	gdist(2,2) = gdist(1,1) + ldist(2,2);
-	path(2,2) = midPath;
+		if (paths)
+			for (i=i0; i<=i1; i++)
+				parray[offset[j] + i - lo[j]] = -1;
+		if (j == 1 && i0 <= 1 && 1 <= i1){
+			g[1] = lc[1];
+			if (paths)
+				parray[offset[j] + 1 - lo[j]] = midPath;
+		}
+		if (j == 2 && i0 <= 2 && 2 <= i1){
+			g[2] = gp[1] + lc[2];
+			if (paths)
+				parray[offset[j] + 2 - lo[j]] = midPath;
+		}
 
-	for (i=3; i<=l1; i++){
-		for (j=3; j<=l2; j++){
-			register float top, mid, bot;
+		for (i=(i0 < 3 ? 3 : i0); j>=3 && i<=i1; i++){
+			float top, mid, bot, best;
+			char	direct;
 
-			top = gdist(i-2,j-1) + ldist(i-1,j) + ldist(i,j);
-			mid = gdist(i-1,j-1) + ldist(i,j);
-			bot = gdist(i-1,j-2) + ldist(i,j-1) + ldist(i,j);
+			top = gp[i-2] + lc[i-1] + lc[i];
+			mid = gp[i-1] + lc[i];
+			bot = gpp[i-1] + lp[i] + lc[i];
 
 			if (top < mid && top < bot){
-				gdist(i,j) = top;
-				path(i,j) = topPath;
+				best = top;
+				direct = topPath;
 			} else if (bot < top && bot < mid){
-				gdist(i,j) = bot;
-				path(i,j) = botPath;
+				best = bot;
+				direct = botPath;
 			} else {
-				gdist(i,j) = mid;
-				path(i,j) = midPath;
+				best = mid;
+				direct = midPath;
+			}
+			g[i] = best;
+			if (paths)
+				parray[offset[j] + i - lo[j]] = direct;
+		}
+
+/* Early abandoning: the steps skip at most one column, so every path
+ * ends a step in column j-1 or j, and then still goes through all of
+ * the columns after j, each adding at least rest[j'] - rest[j'-1].
+ */
+		if (rest){
+			colMin = HUGE;
+			for (i=i0; i<=i1; i++)
+				colMin = g[i] < colMin ? g[i] : colMin;
+			if ((prevMin < colMin ? prevMin : colMin) + rest[j] > 
+			    abandon){
+				free(columns); free(offset); free(parray);
+				free(p1vector); free(p2vector);
+				return HUGE;
 			}
+			prevMin = colMin;
 		}
 	}
 
-	error = gdist(l1,l2);
+	error = columns[(l2%3)*(size_t)(l1+1) + l1];
+	free(columns);
+	if (!paths)
+		return error;
 
 /* Now backtrack through the array looking for the path that got
  * us the minimum distance.  Luckily we left a string of 
@@ -161,19 +333,15 @@ DATA dtw(DATA *v1, int l1, DATA *v2, int l2, int d, INDEX **pp1, INDEX **pp2){
  */
 	p1 = l1;
 	p2 = l2;
-	
-	p1vector = malloc(l1*sizeof(*p1vector));
-	p2vector = malloc(l2*sizeof(*p2vector));
-	
-	if (!p1vector || !p2vector)
-		return 0;
-		
 	while (p1 > 0 && p2 > 0){
 		int	direct;
 
 		path1(p1) = p2;
 		path2(p2) = p1;
-		direct = path(p1,p2);
+		if (p1 >= lo[p2] && p1 <= hi[p2])
+			direct = parray[offset[p2] + p1 - lo[p2]];
+		else
+			direct = -1;
 		if (direct == topPath){
 			p1 = p1 - 1;
 			path1(p1) = p2;
@@ -186,15 +354,478 @@ DATA dtw(DATA *v1, int l1, DATA *v2, int l2, int d, INDEX **pp1, INDEX **pp2){
 		p1 = p1 - 1;
 		p2 = p2 - 1;
 	}
+
+	free(offset); free(parray);
 	if (pp1)
 		*pp1 = p1vector;
-
+	else
+		free(p1vector);
 	if (pp2)
 		*pp2 = p2vector;
+	else
+		free(p2vector);
 
 	return error;
 }
 
+DATA dtwwindow(DATA *v1, int l1, DATA *v2, int l2, int d, 
+	const int *lo, const int *hi, INDEX **pp1, INDEX **pp2){
+	DATA	*t1;		/* s1 transposed, t1[k*l1+i-1] */
+	DATA	error;
+	int	i, k;
+
+	t1 = (DATA *)malloc(sizeof(*t1)*l1*(size_t)d);
+	if (!t1)
+		return -1;
+	for (i=1; i<=l1; i++)
+		for (k=1; k<=d; k++)
+			t1[(k-1)*(size_t)l1 + i-1] = v1[(k-1) + (i-1)*(size_t)d];
+	error = DtwColumns(t1, l1, v2, l2, d, lo, hi, 0, HUGE, pp1, pp2);
+	free(t1);
+	return error;
+}
+
+/*
+ * The Itakura parallelogram: the cells with slopes between 1/2 and 2
+ * both from (1,1) and to (l1,l2).  No other cell can be on a path with
+ * these steps, so the result is that of the full search.  (Two more
+ * rows each side for the cells the top and bottom steps go past.)
+ */
+DATA dtwitakura(DATA *v1, int l1, DATA *v2, int l2, int d, 
+	INDEX **pp1, INDEX **pp2){
+	int	*lo, *hi, j, a, b;
+	DATA	error;
+
+	lo = (int *)malloc((l2+1)*sizeof(*lo));
+	hi = (int *)malloc((l2+1)*sizeof(*hi));
+	if (!lo || !hi){
+		free(lo); free(hi);
+		return -1;
+	}
+	for (j=1; j<=l2; j++){
+		a = 1 + j/2;			/* 1 + ceil((j-1)/2) */
+		b = l1 - 2*(l2-j);
+		lo[j] = (a > b ? a : b) - 2;
+		a = 1 + 2*(j-1);
+		b = l1 - (l2-j+1)/2;
+		hi[j] = (a < b ? a : b) + 2;
+		if (lo[j] < 1) lo[j] = 1;
+		if (hi[j] > l1) hi[j] = l1;
+	}
+	error = dtwwindow(v1, l1, v2, l2, d, lo, hi, pp1, pp2);
+	free(lo); free(hi);
+	return error;
+}
+
+/*
+ * The Sakoe-Chiba band: the cells within radius rows of the diagonal
+ * from (1,1) to (l1,l2).
+ */
+static void SakoeWindow(int l1, int l2, int radius, int *lo, int *hi){
+	int	j;
+	double	c;
+
+	for (j=1; j<=l2; j++){
+		c = (l2 > 1) ? 1 + (j-1)*(double)(l1-1)/(l2-1) : 1;
+		lo[j] = (int)ceil(c - radius);
+		hi[j] = (int)floor(c + radius);
+		if (lo[j] < 1) lo[j] = 1;
+		if (hi[j] > l1) hi[j] = l1;
+	}
+}
+
+DATA dtwsakoe(DATA *v1, int l1, DATA *v2, int l2, int d, int radius,
+	INDEX **pp1, INDEX **pp2){
+	int	*lo, *hi;
+	DATA	error;
+
+	lo = (int *)malloc((l2+1)*sizeof(*lo));
+	hi = (int *)malloc((l2+1)*sizeof(*hi));
+	if (!lo || !hi){
+		free(lo); free(hi);
+		return -1;
+	}
+	SakoeWindow(l1, l2, radius, lo, hi);
+	error = dtwwindow(v1, l1, v2, l2, d, lo, hi, pp1, pp2);
+	free(lo); free(hi);
+	return error;
+}
+
+/*
+ * FastDTW (Salvador and Chan, 2007): average the signals over pairs of
+ * frames, find the path of those (the same way, down to radius+2
+ * frames), and search the cells of that path at full resolution
+ * widened by radius frames in both directions.  If the step pattern
+ * finds no path in that window, the radius is doubled.
+ */
+static DATA *Coarsen(const DATA *v, int l, int d){
+	DATA	*c;
+	int	i, k;
+
+	c = (DATA *)malloc(sizeof(*c)*((l+1)/2)*(size_t)d);
+	if (!c)
+		return 0;
+	for (i=0; i<l/2; i++)
+		for (k=0; k<d; k++)
+			c[k + i*(size_t)d] = (v[k + 2*i*(size_t)d] + 
+				v[k + (2*i+1)*(size_t)d])/2;
+	if (l%2)
+		for (k=0; k<d; k++)
+			c[k + (l/2)*(size_t)d] = v[k + (l-1)*(size_t)d];
+	return c;
+}
+
+DATA dtwfast(DATA *v1, int l1, DATA *v2, int l2, int d, int radius,
+	INDEX **pp1, INDEX **pp2){
+	DATA	*c1, *c2, error;
+	INDEX	*q1, *q2;
+	int	*plo, *phi, *lo, *hi, m1, m2, i, j, jj;
+
+	if (radius < 0)
+		radius = kFastRadius;
+	if (l1 <= radius+2 || l2 <= radius+2)
+		return dtw(v1, l1, v2, l2, d, pp1, pp2);
+
+	m1 = (l1+1)/2;
+	m2 = (l2+1)/2;
+	c1 = Coarsen(v1, l1, d);
+	c2 = Coarsen(v2, l2, d);
+	q1 = q2 = 0;
+	error = -1;
+	if (c1 && c2)
+		error = dtwfast(c1, m1, c2, m2, d, radius, &q1, &q2);
+	free(c1); free(c2);
+	if (error < 0)
+		return -1;
+
+/* The rows of the coarse path in each coarse column, then at full
+ * resolution, and widened.
+ */
+	plo = (int *)malloc((l2+1)*sizeof(*plo));
+	phi = (int *)malloc((l2+1)*sizeof(*phi));
+	lo = (int *)malloc((l2+1)*sizeof(*lo));
+	hi = (int *)malloc((l2+1)*sizeof(*hi));
+	if (!plo || !phi || !lo || !hi){
+		free(q1); free(q2); free(plo); free(phi); free(lo); free(hi);
+		return -1;
+	}
+	for (j=1; j<=m2; j++){
+		plo[j] = m1+1;
+		phi[j] = 0;
+	}
+	for (i=1; i<=m1; i++){
+		j = q1[i-1];
+		if (j >= 1 && j <= m2){
+			if (i < plo[j]) plo[j] = i;
+			if (i > phi[j]) phi[j] = i;
+		}
+	}
+	for (j=1; j<=m2; j++){
+		i = q2[j-1];
+		if (i >= 1 && i <= m1){
+			if (i < plo[j]) plo[j] = i;
+			if (i > phi[j]) phi[j] = i;
+		}
+	}
+	free(q1); free(q2);
+	for (j=1; j<=m2; j++){		/* Coarse column j is fine */
+		lo[2*j-1] = 2*plo[j]-1;		/* columns 2j-1 and 2j */
+		hi[2*j-1] = 2*phi[j];
+		if (2*j <= l2){
+			lo[2*j] = 2*plo[j]-1;
+			hi[2*j] = 2*phi[j];
+		}
+	}
+	for (j=1; j<=l2; j++){
+		plo[j] = l1+1;
+		phi[j] = 0;
+		for (jj=j-radius; jj<=j+radius; jj++)
+			if (jj >= 1 && jj <= l2 && lo[jj] <= hi[jj]){
+				if (lo[jj] < plo[j]) plo[j] = lo[jj];
+				if (hi[jj] > phi[j]) phi[j] = hi[jj];
+			}
+	}
+	for (j=1; j<=l2; j++){
+		lo[j] = plo[j] - radius;
+		hi[j] = phi[j] + radius;
+		if (lo[j] < 1) lo[j] = 1;
+		if (hi[j] > l1) hi[j] = l1;
+	}
+	free(plo); free(phi);
+
+	error = dtwwindow(v1, l1, v2, l2, d, lo, hi, pp1, pp2);
+	free(lo); free(hi);
+	if (error >= HUGE){			/* No path in the window */
+		if (pp1) free(*pp1);
+		if (pp2) free(*pp2);
+		return dtwfast(v1, l1, v2, l2, d, 2*radius+1, pp1, pp2);
+	}
+	return error;
+}
+
+/*
+ * The template library.  The lower bounds are a little smaller than
+ * computed (kBoundSlack) as the errors are summed in float.
+ */
+DtwLibrary *dtwlibrary(DATA **templates, const int *lengths, int n, int d,
+	int radius){
+	DtwLibrary	*lib;
+	DATA	*t, *upper, *lower, *v;
+	int	m, i, ii, k, l;
+
+	lib = (DtwLibrary *)calloc(1, sizeof(*lib));
+	if (!lib)
+		return 0;
+	lib->nTemplates = n;
+	lib->d = d;
+	lib->radius = radius < 0 ? 0 : radius;
+	lib->length = (int *)calloc(n > 0 ? n : 1, sizeof(*lib->length));
+	lib->t = (DATA **)calloc(n > 0 ? n : 1, sizeof(*lib->t));
+	if (!lib->length || !lib->t){
+		dtwfreelibrary(lib);
+		return 0;
+	}
+	for (m=0; m<n; m++){
+		l = lib->length[m] = lengths[m];
+		t = lib->t[m] = (DATA *)malloc(sizeof(*t)*(3*(size_t)l*d + 1));
+		if (!t){
+			dtwfreelibrary(lib);
+			return 0;
+		}
+		upper = t + l*(size_t)d;
+		lower = upper + l*(size_t)d;
+		v = templates[m];
+		for (i=0; i<l; i++)
+			for (k=0; k<d; k++)
+				t[k*(size_t)l + i] = v[k + i*(size_t)d];
+		for (k=0; k<d; k++){
+			v = &t[k*(size_t)l];
+			for (i=0; i<l; i++){
+				DATA	hiValue = v[i], loValue = v[i];
+
+				for (ii=i-lib->radius; ii<=i+lib->radius; ii++)
+					if (ii >= 0 && ii < l){
+						if (v[ii] > hiValue)
+							hiValue = v[ii];
+						if (v[ii] < loValue)
+							loValue = v[ii];
+					}
+				upper[k*(size_t)l + i] = hiValue;
+				lower[k*(size_t)l + i] = loValue;
+			}
+		}
+	}
+	return lib;
+}
+
+void dtwfreelibrary(DtwLibrary *lib){
+	int	m;
+
+	if (!lib)
+		return;
+	if (lib->t)
+		for (m=0; m<lib->nTemplates; m++)
+			free(lib->t[m]);
+	free(lib->t);
+	free(lib->length);
+	free(lib);
+}
+
+/* ldist(i,j) of template n, in double */
+static double LocalDistance(const DtwLibrary *lib, int n, int i,
+	const DATA *v2, int j){
+	const DATA	*t = lib->t[n];
+	int	k, l = lib->length[n];
+	double	sum = 0, diff;
+
+	for (k=0; k<lib->d; k++){
+		diff = t[k*(size_t)l + i-1] - v2[k + (j-1)*(size_t)lib->d];
+		sum += diff*diff;
+	}
+	return sum;
+}
+
+/* LB_Kim: the cells (1,1), (2,2) and (l1,l2) are on every path. */
+static double KimBound(const DtwLibrary *lib, int n, const DATA *v2, int l2){
+	int	l1 = lib->length[n];
+	double	bound;
+
+	bound = LocalDistance(lib, n, 1, v2, 1);
+	if (l1 > 1 && l2 > 1)
+		bound += LocalDistance(lib, n, 2, v2, 2);
+	if (l1 > 2 || l2 > 2)
+		bound += LocalDistance(lib, n, l1, v2, l2);
+	return bound*(1 - kBoundSlack);
+}
+
+/*
+ * LB_Keogh: every column j is on the path, at one of the rows of its
+ * band, all within radius rows of the one nearest to the diagonal, so
+ * its cost is at least the distance of s2(:,j) to the envelopes there.
+ * Also rest[j], the bound of the columns after j.
+ */
+static double KeoghBound(const DtwLibrary *lib, int n, const DATA *v2, int l2,
+	double *rest){
+	int	l1 = lib->length[n], d = lib->d, i, j, k;
+	const DATA	*upper = lib->t[n] + l1*(size_t)d;
+	const DATA	*lower = upper + l1*(size_t)d;
+	double	c, q, column, total;
+
+	total = 0;
+	for (j=l2; j>=1; j--){
+		rest[j] = total*(1 - kBoundSlack);
+		c = (l2 > 1) ? 1 + (j-1)*(double)(l1-1)/(l2-1) : 1;
+		i = (int)floor(c + 0.5);
+		if (i < 1) i = 1;
+		if (i > l1) i = l1;
+		column = 0;
+		for (k=0; k<d; k++){
+			q = v2[k + (j-1)*(size_t)d];
+			if (q > upper[k*(size_t)l1 + i-1])
+				column += (q - upper[k*(size_t)l1 + i-1])*
+					(q - upper[k*(size_t)l1 + i-1]);
+			else if (q < lower[k*(size_t)l1 + i-1])
+				column += (lower[k*(size_t)l1 + i-1] - q)*
+					(lower[k*(size_t)l1 + i-1] - q);
+		}
+		total += column;
+	}
+	return total*(1 - kBoundSlack);
+}
+
+typedef struct {
+	double	bound;
+	int	index;
+} DtwCandidate;
+
+static int CompareCandidates(const void *a, const void *b){
+	const DtwCandidate	*ca = (const DtwCandidate *)a;
+	const DtwCandidate	*cb = (const DtwCandidate *)b;
+
+	if (ca->bound != cb->bound)
+		return ca->bound < cb->bound ? -1 : 1;
+	return ca->index - cb->index;
+}
+
+/* Keep the k best (lowest error, then lowest number) in order. */
+static void InsertMatch(int k, int *found, int *index, DATA *error, 
+	int n, DATA e){
+	int	m;
+
+	if (*found == k && (e > error[k-1] || 
+	    (e == error[k-1] && n > index[k-1])))
+		return;
+	m = (*found < k) ? (*found)++ : k-1;
+	while (m > 0 && (error[m-1] > e || (error[m-1] == e && index[m-1] > n))){
+		error[m] = error[m-1];
+		index[m] = index[m-1];
+		m--;
+	}
+	error[m] = e;
+	index[m] = n;
+}
+
+/*
+ * The templates are tried in the order of LB_Kim, on all the threads;
+ * the k best so far (and so the threshold) are shared.  The paths of
+ * the k best are found again at the end.
+ */
+int dtwsearch(const DtwLibrary *lib, DATA *v2, int l2, int k, int *index,
+	DATA *error, INDEX **pp1, INDEX **pp2){
+	DtwCandidate	*candidates;
+	int	nTemplates = lib->nTemplates, n, m, found = 0, failed = 0;
+	int	*lo, *hi;
+
+	if (k > nTemplates)
+		k = nTemplates;
+	if (k <= 0 || l2 < 1)
+		return 0;
+	candidates = (DtwCandidate *)malloc(nTemplates*sizeof(*candidates));
+	if (!candidates)
+		return -1;
+	for (n=0; n<nTemplates; n++){
+		candidates[n].index = n;
+		candidates[n].bound = lib->length[n] > 0 ? 
+			KimBound(lib, n, v2, l2) : HUGE;
+	}
+	qsort(candidates, nTemplates, sizeof(*candidates), CompareCandidates);
+
+#ifdef	_OPENMP
+#pragma omp parallel private(n, lo, hi)
+#endif
+	{
+		double	*rest, threshold;
+		DATA	e;
+
+		lo = (int *)malloc((l2+1)*sizeof(*lo));
+		hi = (int *)malloc((l2+1)*sizeof(*hi));
+		rest = (double *)malloc((l2+1)*sizeof(*rest));
+		if (!lo || !hi || !rest){
+#ifdef	_OPENMP
+#pragma omp atomic
+#endif
+			failed |= 1;
+		}
+#ifdef	_OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+		for (m=0; m<nTemplates; m++){
+			n = candidates[m].index;
+			if (!lo || !hi || !rest || lib->length[n] < 1)
+				continue;
+#ifdef	_OPENMP
+#pragma omp critical (dtwsearch)
+#endif
+			threshold = (found < k) ? HUGE : error[k-1];
+			if (candidates[m].bound > threshold)
+				continue;
+			if (KeoghBound(lib, n, v2, l2, rest) > threshold)
+				continue;
+			SakoeWindow(lib->length[n], l2, lib->radius, lo, hi);
+			e = DtwColumns(lib->t[n], lib->length[n], v2, l2, lib->d,
+				lo, hi, rest, threshold, 0, 0);
+			if (e < 0){
+#ifdef	_OPENMP
+#pragma omp atomic
+#endif
+				failed |= 1;
+			}
+			if (e < 0 || e >= HUGE)
+				continue;
+#ifdef	_OPENMP
+#pragma omp critical (dtwsearch)
+#endif
+			InsertMatch(k, &found, index, error, n, e);
+		}
+		free(lo); free(hi); free(rest);
+	}
+	free(candidates);
+	if (failed)
+		return -1;
+
+	lo = (int *)malloc((l2+1)*sizeof(*lo));
+	hi = (int *)malloc((l2+1)*sizeof(*hi));
+	for (m=0; m<found && (pp1 || pp2); m++){
+		n = index[m];
+		if (lo && hi){
+			SakoeWindow(lib->length[n], l2, lib->radius, lo, hi);
+			error[m] = DtwColumns(lib->t[n], lib->length[n], v2, l2,
+				lib->d, lo, hi, 0, HUGE, pp1 ? &pp1[m] : 0,
+				pp2 ? &pp2[m] : 0);
+		}
+		if (!lo || !hi || error[m] < 0){
+			while (--m >= 0){
+				if (pp1) free(pp1[m]);
+				if (pp2) free(pp2[m]);
+			}
+			found = -1;
+			break;
+		}
+	}
+	free(lo); free(hi);
+	return found;
+}
+
 #ifdef	MAIN
 #include	<stdio.h>
 
@@ -321,6 +952,8 @@ main(){
 
 #define	pS1	prhs[0]
 #define	pS2	prhs[1]
+#define	pMODE	prhs[2]
+#define	pRADIUS	prhs[3]
 
 #include	<stdio.h>
 #include 	<math.h>
@@ -330,19 +963,180 @@ main(){
 #define	mxGetSize(m)	(mxGetN(m) * mxGetM(m))
 
    
+/* =====================================================================*/
+/*	The template library: dtw('load', templates, radius),		*/
+/*	dtw('search', s2, k) and dtw('clear').				*/
+
+static DtwLibrary	*library = 0;
+
+static void ClearLibrary(void)
+{
+	dtwfreelibrary(library);
+	library = 0;
+}
+
+static void LibraryUsage(void)
+{
+	printf("Incorrect calling syntax:\n dtw('load',templates,radius)\n");
+	printf("	where templates is a cell array of KxN arrays\n");
+	printf(" [error,index,p1,p2] = dtw('search',s2,k)\n");
+	printf("	where s2 is KxM in size\n");
+	printf(" dtw('clear')\n");
+}
+
+static int LoadLibrary(int nrhs, const mxArray *prhs[])
+{
+	int	m, n, d = -1, *lengths;
+	DATA	**templates;
+	mxArray	*a;
+
+	if (nrhs != 3 || !mxIsCell(prhs[1])){
+		LibraryUsage();
+		return 1;
+	}
+	n = mxGetNumberOfElements(prhs[1]);
+	templates = (DATA **)mxCalloc(n > 0 ? n : 1, sizeof(*templates));
+	lengths = (int *)mxCalloc(n > 0 ? n : 1, sizeof(*lengths));
+	for (m=0; m<n; m++){
+		a = mxGetCell(prhs[1], m);
+		if (!a || !mxIsDouble(a) || mxGetN(a) == 0 || 
+		    (d >= 0 && (int)mxGetM(a) != d)){
+			printf("The templates must be KxN arrays, "
+				"all of the same height\n");
+			mxFree(templates); mxFree(lengths);
+			return 1;
+		}
+		d = mxGetM(a);
+		templates[m] = mxGetPr(a);
+		lengths[m] = mxGetN(a);
+	}
+	if (mxGetScalar(prhs[2]) < 0){
+		printf("The radius can't be negative\n");
+		mxFree(templates); mxFree(lengths);
+		return 1;
+	}
+	ClearLibrary();
+	library = dtwlibrary(templates, lengths, n, d < 0 ? 0 : d, 
+		(int)mxGetScalar(prhs[2]));
+	mxFree(templates); mxFree(lengths);
+	if (!library)
+		mexErrMsgTxt("dtw: out of memory.");
+	mexAtExit(ClearLibrary);
+	return 0;
+}
+
+static int SearchLibrary(int nlhs, mxArray *plhs[], 
+				int nrhs, const mxArray *prhs[])
+{
+	int	i, m, k, found, l2, *index;
+	DATA	*error;
+	INDEX	**p1, **p2;
+	double	*rp;
+
+	if (nrhs != 3){
+		LibraryUsage();
+		return 1;
+	}
+	if (!library){
+		printf("No templates: dtw('load',templates,radius) first\n");
+		return 1;
+	}
+	if ((int)mxGetM(prhs[1]) != library->d || mxGetN(prhs[1]) == 0){
+		printf("The query must be %d high, like the templates\n",
+			library->d);
+		return 1;
+	}
+	k = (int)mxGetScalar(prhs[2]);
+	if (k < 1){
+		printf("k must be at least 1\n");
+		return 1;
+	}
+	if (k > library->nTemplates)
+		k = library->nTemplates;
+	l2 = mxGetN(prhs[1]);
+	index = (int *)mxCalloc(k > 0 ? k : 1, sizeof(*index));
+	error = (DATA *)mxCalloc(k > 0 ? k : 1, sizeof(*error));
+	p1 = (INDEX **)mxCalloc(k > 0 ? k : 1, sizeof(*p1));
+	p2 = (INDEX **)mxCalloc(k > 0 ? k : 1, sizeof(*p2));
+	found = dtwsearch(library, mxGetPr(prhs[1]), l2, k, index, error,
+		nlhs > 2 ? p1 : 0, nlhs > 3 ? p2 : 0);
+	if (found < 0)
+		mexErrMsgTxt("dtw: out of memory.");
+
+	plhs[0] = mxCreateDoubleMatrix(1, found, mxREAL);
+	rp = mxGetPr(plhs[0]);
+	for (m=0; m<found; m++)
+		rp[m] = error[m];
+	if (nlhs > 1){
+		plhs[1] = mxCreateDoubleMatrix(1, found, mxREAL);
+		rp = mxGetPr(plhs[1]);
+		for (m=0; m<found; m++)
+			rp[m] = index[m] + 1;
+	}
+	if (nlhs > 2){
+		plhs[2] = mxCreateCellMatrix(1, found);
+		for (m=0; m<found; m++){
+			int	l1 = library->length[index[m]];
+			mxArray	*mp = mxCreateDoubleMatrix(1, l1, mxREAL);
+
+			rp = mxGetPr(mp);
+			for (i=0; i<l1; i++)
+				rp[i] = p1[m][i];
+			mxSetCell(plhs[2], m, mp);
+			free(p1[m]);
+		}
+	}
+	if (nlhs > 3){
+		plhs[3] = mxCreateCellMatrix(1, found);
+		for (m=0; m<found; m++){
+			mxArray	*mp = mxCreateDoubleMatrix(1, l2, mxREAL);
+
+			rp = mxGetPr(mp);
+			for (i=0; i<l2; i++)
+				rp[i] = p2[m][i];
+			mxSetCell(plhs[3], m, mp);
+			free(p2[m]);
+		}
+	}
+	mxFree(index); mxFree(error); mxFree(p1); mxFree(p2);
+	return 0;
+}
+
+static int LibraryCommand(int nlhs, mxArray *plhs[], 
+				int nrhs, const mxArray *prhs[])
+{
+	char	command[20];
+
+	mxGetString(prhs[0], command, sizeof(command));
+	if (strcmp(command, "load") == 0)
+		return LoadLibrary(nrhs, prhs);
+	if (strcmp(command, "search") == 0)
+		return SearchLibrary(nlhs, plhs, nrhs, prhs);
+	if (strcmp(command, "clear") == 0){
+		ClearLibrary();
+		return 0;
+	}
+	LibraryUsage();
+	return 1;
+}
+
 /* =====================================================================*/
 /*	Function to determine if arguments are valid. 			*/
 /*	Also fill in some pointers we will need later.			*/
 
 static  int CheckArguments(int nlhs, mxArray *plhs[], 
-				int nrhs, const mxArray *prhs[])
+				int nrhs, const mxArray *prhs[], 
+				char *mode, int *radius)
 {     
 	int	k;
 
-	if (nrhs < 2 || nlhs < 1){
+	if (nrhs < 2 || nrhs > 4 || nlhs < 1){
 		printf("Incorrect calling syntax:\n [error,p1,p2] = ");
-		printf("dtw(s1,s2)\n");
+		printf("dtw(s1,s2[,mode,radius])\n");
 		printf("	where s1 is KxN and S2 is KxM in size\n");
+		printf("	and mode is 'full', 'itakura', 'sakoe' or "
+			"'fast'\n");
+		LibraryUsage();
 		return 1;
 	}
 
@@ -352,6 +1146,30 @@ static  int CheckArguments(int nlhs, mxArray *plhs[],
 		printf("Two input arrays are not the same height\n");
 		return 1;
 	}
+	if (mxGetN(pS1) == 0 || mxGetN(pS2) == 0){
+		printf("Input arrays are empty\n");
+		return 1;
+	}
+
+/*------------ Get the search mode -------------------------------------- */
+	strcpy(mode, "full");
+	if (nrhs > 2 && (!mxIsChar(pMODE) || mxGetString(pMODE, mode, 20))){
+		printf("The mode must be 'full', 'itakura', 'sakoe' or "
+			"'fast'\n");
+		return 1;
+	}
+	*radius = -1;
+	if (nrhs > 3)
+		*radius = (int)mxGetScalar(pRADIUS);
+	if (strcmp(mode, "sakoe") == 0 && *radius < 0){
+		printf("The 'sakoe' mode needs the radius of the band\n");
+		return 1;
+	}
+	if (strcmp(mode, "full") && strcmp(mode, "itakura") && 
+	    strcmp(mode, "sakoe") && strcmp(mode, "fast")){
+		printf("Unknown mode %s\n", mode);
+		return 1;
+	}
 	return 0;
 }
 
@@ -360,30 +1178,53 @@ static  int CheckArguments(int nlhs, mxArray *plhs[],
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])  
 { 	
-	int	i;
+	int	i, radius;
+	char	mode[kCommandSize];
 	register double	error;
 	mxArray	*mp1 = 0, *mp2 = 0, *ep = 0;
 	INDEX	*md1, *md2;	
+	DATA	*v1, *v2;
+	int	l1, l2, d;
 
-	if (CheckArguments(nlhs, plhs, nrhs, prhs) ){
+	if (nrhs >= 1 && mxIsChar(pS1)){
+		if (LibraryCommand(nlhs, plhs, nrhs, prhs))
+			mexErrMsgTxt("dtw argument checking failed.");
+		return ;
+	}
+
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, mode, &radius) ){
 		mexErrMsgTxt("dtw argument checking failed.");
 		return ;
 	}
+	v1 = mxGetPr(pS1);
+	v2 = mxGetPr(pS2);
+	l1 = mxGetN(pS1);
+	l2 = mxGetN(pS2);
+	d = mxGetM(pS1);
+
+	if (strcmp(mode, "itakura") == 0)
+		error = dtwitakura(v1, l1, v2, l2, d, &md1, &md2);
+	else if (strcmp(mode, "sakoe") == 0)
+		error = dtwsakoe(v1, l1, v2, l2, d, radius, &md1, &md2);
+	else if (strcmp(mode, "fast") == 0)
+		error = dtwfast(v1, l1, v2, l2, d, radius, &md1, &md2);
+	else
+		error = dtw(v1, l1, v2, l2, d, &md1, &md2);
+	if (error < 0){
+		mexErrMsgTxt("dtw: out of memory.");
+		return ;
+	}
 
 	if (nlhs > 1){
-		mp1 = mxCreateDoubleMatrix(1, mxGetN(pS1), mxREAL);
+		mp1 = mxCreateDoubleMatrix(1, l1, mxREAL);
 		plhs[1] = mp1;
 	}
 
 	if (nlhs > 2){
-		mp2 = mxCreateDoubleMatrix(1, mxGetN(pS2), mxREAL);
+		mp2 = mxCreateDoubleMatrix(1, l2, mxREAL);
 		plhs[2] = mp2;
 	}
 
-	error = dtw(mxGetPr(pS1), mxGetN(pS1), 
-		    mxGetPr(pS2), mxGetN(pS2), mxGetM(pS1),
-		    &md1, &md2);
-
 	if (nlhs > 0){
 		plhs[0] = mxCreateDoubleMatrix(1, 1, mxREAL);
 		if (plhs[0])
@@ -392,18 +1233,18 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
 	if (mp1){
 		double	*rp = mxGetPr(mp1);
-		int	len = mxGetN(pS1);
 
-		for (i=0;i<len;i++)
-			*rp++ = *md1++;
+		for (i=0;i<l1;i++)
+			*rp++ = md1[i];
 	}
 
 	if (mp2){
 		double	*rp = mxGetPr(mp2);
-		int	len = mxGetN(pS2);
 
-		for (i=0;i<len;i++)
-			*rp++ = *md2++;
+		for (i=0;i<l2;i++)
+			*rp++ = md2[i];
 	}
+	free(md1);
+	free(md2);
 }
 #endif
@@ -0,0 +1,487 @@
+/* =======================================================================
+*		invlyonear.c	Invert a cochleagram in one pass: the
+*				inverse AGC stages (inverseagc) and then
+*				the inverse of the filter cascade
+*				(invsoscascade), a block of samples at
+*				a time, without a full matrix between
+*				the two.
+*
+*		(c) 1998 Interval Research Corporation
+*		[output,state] = invlyonear(input, Coeffs, agcParms,
+*					gains, state)
+* ========================================================================*/
+
+/*
+ *	input is the C x N cochleagram, Coeffs the C x 5 cascade (from
+ *	DesignLyonFilters), agcParms the [targets; epsilons] of the AGC
+ *	(2 x S, or [] if there was none), gains the C gains of the
+ *	channels (or [] for none).  The stages are undone last first, as
+ *	inverseagc does, and then the channels are summed back through
+ *	the cascade, as invsoscascade does, with the same arithmetic; so
+ *	the output is the same as
+ *	>> invsoscascade(inverseagc(input, agcParms), Coeffs, gains)
+ *
+ *	The state is C x (S+2), the AGC state and then the cascade state.
+ *	An input cut into pieces (of any length) gives the same output as
+ *	the whole when the state is passed on
+ *	>> [y1,s] = invlyonear(c(:,1:500), f, p, []);
+ *	>> [y1 invlyonear(c(:,501:end), f, p, [], s)]
+ *
+ *	A single precision input is inverted in single precision, and
+ *	gives a single output and state.
+ *
+ *	The inverse cascade runs as a wavefront over the channels (see
+ *	RunInverse), so with optimization (e.g. -O3 -mavx2) the channels
+ *	of a step run in SIMD lanes.
+ */
+
+#define	pINPUTM			prhs[0]
+#define	pCOEFFSM		prhs[1]
+#define	pAGCM			prhs[2]
+#define	pGAINM			prhs[3]
+#define	pSTATEM			prhs[4]
+
+#define	kNumStateVars		2
+#define	kBlockSamples		256	/* Steps between the two stages */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include 	<math.h>
+#include	"mex.h"
+
+#ifndef	DOUBLE
+#define	DOUBLE	double
+#endif
+
+#ifndef	INT
+#define	INT	int
+#endif
+
+#define	mxGetSize(m)	(mxGetN(m) * mxGetM(m))
+
+#define	EPS	(1e-1)			/* As in agc.c */
+
+					/* The arrays of one step never overlap;
+					 * without saying so the compiler does
+					 * not vectorize the lanes.
+					 */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define	RESTRICT	restrict
+#elif defined(__GNUC__) || defined(_MSC_VER)
+#define	RESTRICT	__restrict
+#else
+#define	RESTRICT
+#endif
+
+					/* Everything the inverse needs, filled
+					 * in by CheckArguments().
+					 */
+typedef struct {
+	void	*inputData, *outputData, *stateData;	/* DOUBLE or float */
+	DOUBLE	*a0, *a1, *a2, *b1, *b2, *gains, *agcParms;
+	int	isSingle;
+	INT	nSamples, nChannels, nStages;
+	mxArray	*outputMatrix, *stateMatrix;
+} InvLyonEar;
+
+/* =====================================================================*/
+/*	Function to determine if arguments are valid. 			*/
+/*	Also fill in some pointers we will need later.			*/
+
+static int CheckArguments(int nlhs, mxArray *plhs[],
+			int nrhs, const mxArray *prhs[], InvLyonEar *p)
+{
+	mxClassID	classID;
+	INT	nStates;
+
+	if (nrhs < 3 || nrhs > 5 || nlhs > 2){
+		mexPrintf("Incorrect calling syntax:\n [output, state] = ");
+		mexPrintf("invlyonear(input, Coeffs, agcParms, gains, "
+			"state)\n");
+		mexPrintf("   input has C x N samples\n");
+		mexPrintf("   Coeffs is C x 5 where C is the number of "
+			"channels\n");
+		mexPrintf("   agcParms is 2 x S (targets;epsilons) or []\n");
+		mexPrintf("   gains is a C x 1 array of channel gains or []\n");
+		mexPrintf("   state is C x (S+2)\n");
+		mexPrintf("   output is 1 x N\n");
+		return 1;
+	}
+
+/*------------ Check input is not empty ------------------------------ */
+	p->nSamples = mxGetN(pINPUTM);
+	p->nChannels = mxGetM(pINPUTM);
+	if(p->nSamples == 0 || p->nChannels == 0) {
+		mexPrintf("Input array is empty.\n");
+		return 1;
+	}
+	if (!(mxIsDouble(pINPUTM) || mxIsSingle(pINPUTM))){
+		mexPrintf("Input must be double or single.\n");
+		return 1;
+	}
+	p->isSingle = mxIsSingle(pINPUTM);
+	p->inputData = mxGetData(pINPUTM);
+
+/*------------ Check to See if Coeffs Matrix Is the right Size ------- */
+	if ( mxGetN(pCOEFFSM) != 5 || mxGetM(pCOEFFSM) != p->nChannels) {
+		mexPrintf("Coefficient Matrix Must have 5 Columns: ");
+		mexPrintf("Coeffs=[A0 A1 A2 B1 B2], and a row for each "
+			"channel\n");
+		return 1;
+	}
+	p->a0 = &(mxGetPr(pCOEFFSM)[0*p->nChannels]);
+	p->a1 = &(mxGetPr(pCOEFFSM)[1*p->nChannels]);
+	p->a2 = &(mxGetPr(pCOEFFSM)[2*p->nChannels]);
+	p->b1 = &(mxGetPr(pCOEFFSM)[3*p->nChannels]);
+	p->b2 = &(mxGetPr(pCOEFFSM)[4*p->nChannels]);
+
+	if (mxGetSize(pAGCM) == 0)
+		p->nStages = 0;
+	else if (mxGetM(pAGCM) != 2){
+		mexPrintf("agcParms must have 2 rows: [target;epsilon]\n");
+		return 1;
+	} else
+		p->nStages = mxGetN(pAGCM);
+	p->agcParms = mxGetPr(pAGCM);
+
+	p->gains = 0;
+	if ( nrhs > 3 && mxGetSize(pGAINM) > 0 ){
+		if (mxGetSize(pGAINM) != p->nChannels){
+			mexPrintf("Number of gain terms must be same as "
+				"number of filter channels (rows).\n");
+			return 1;
+		}
+		p->gains = mxGetPr(pGAINM);
+	}
+
+/*------------ Allocate the output matrix ------------------------------- */
+	classID = p->isSingle ? mxSINGLE_CLASS : mxDOUBLE_CLASS;
+	p->outputMatrix = mxCreateNumericMatrix((INT)1, p->nSamples,
+		classID, mxREAL);
+	p->outputData = mxGetData(p->outputMatrix);
+
+/*---- Create the state matrix, fill in the input values if specified --*/
+	nStates = p->nStages + kNumStateVars;
+	p->stateMatrix = mxCreateNumericMatrix(p->nChannels, nStates,
+		classID, mxREAL);
+	p->stateData = mxGetData(p->stateMatrix);
+	if ( nrhs >= 5 && mxGetSize(pSTATEM) > 0 ) {
+		int	i;
+
+		if ( mxGetM(pSTATEM) != p->nChannels ||
+		     mxGetN(pSTATEM) != nStates ||
+		     !(mxIsDouble(pSTATEM) || mxIsSingle(pSTATEM))){
+			mexPrintf("MEX file invlyonear got a bad state "
+				"input. Should be size %dx%d.\n",
+				p->nChannels, nStates);
+			return 1;
+		}
+		for (i=0; i<mxGetSize(pSTATEM); i++){
+			DOUBLE	v = mxIsSingle(pSTATEM) ?
+				((float *)mxGetData(pSTATEM))[i] :
+				mxGetPr(pSTATEM)[i];
+			if (p->isSingle)
+				((float *)p->stateData)[i] = (float)v;
+			else
+				((DOUBLE *)p->stateData)[i] = v;
+		}
+	}
+
+	return 0;
+}
+
+/* =======================================================================*/
+/*	One inverse AGC stage across the channels of a sample, as agc()	*/
+/*	in agc.c compiled with INVERSE.  The new states use the old	*/
+/*	states of the neighbours, so they go to newState first.		*/
+
+static void InverseAgcStage(const DOUBLE *x, DOUBLE *y, DOUBLE *state,
+	DOUBLE *newState, double epsilon, double target, INT n)
+{
+	INT	i;
+	DOUBLE	f, StateLimit = 1.-EPS;
+	DOUBLE	OneMinusEpsOverThree = (1.0 - epsilon)/3.0;
+	DOUBLE	EpsOverTarget = epsilon/target;
+
+	if (n == 1){
+		f = x[0] * EpsOverTarget +
+		    OneMinusEpsOverThree*(state[0] + state[0] + state[0]);
+		y[0] = fabs(x[0] / (1.0 - state[0]));
+		state[0] = (f > StateLimit) ? StateLimit : f;
+		return;
+	}
+	f = x[0] * EpsOverTarget +
+	    OneMinusEpsOverThree*(state[0] + state[0] + state[1]);
+	newState[0] = (f > StateLimit) ? StateLimit : f;
+	for (i=1; i<n-1; i++){
+		f = x[i] * EpsOverTarget +
+		    OneMinusEpsOverThree*(state[i-1] + state[i] + state[i+1]);
+		newState[i] = (f > StateLimit) ? StateLimit : f;
+	}
+	f = x[i] * EpsOverTarget +
+	    OneMinusEpsOverThree*(state[i-1] + state[i] + state[i]);
+	newState[i] = (f > StateLimit) ? StateLimit : f;
+	for (i=0; i<n; i++){
+		y[i] = fabs(x[i] / (1.0 - state[i]));
+		state[i] = newState[i];
+	}
+}
+
+/*	The same in single precision.					*/
+
+static void InverseAgcStageSingle(const float *x, float *y, float *state,
+	float *newState, double epsilon, double target, INT n)
+{
+	INT	i;
+	float	f, StateLimit = (float)(1.-EPS);
+	float	OneMinusEpsOverThree = (float)((1.0 - epsilon)/3.0);
+	float	EpsOverTarget = (float)(epsilon/target);
+
+	if (n == 1){
+		f = x[0] * EpsOverTarget +
+		    OneMinusEpsOverThree*(state[0] + state[0] + state[0]);
+		y[0] = (float)fabs(x[0] / (1.0f - state[0]));
+		state[0] = (f > StateLimit) ? StateLimit : f;
+		return;
+	}
+	f = x[0] * EpsOverTarget +
+	    OneMinusEpsOverThree*(state[0] + state[0] + state[1]);
+	newState[0] = (f > StateLimit) ? StateLimit : f;
+	for (i=1; i<n-1; i++){
+		f = x[i] * EpsOverTarget +
+		    OneMinusEpsOverThree*(state[i-1] + state[i] + state[i+1]);
+		newState[i] = (f > StateLimit) ? StateLimit : f;
+	}
+	f = x[i] * EpsOverTarget +
+	    OneMinusEpsOverThree*(state[i-1] + state[i] + state[i]);
+	newState[i] = (f > StateLimit) ? StateLimit : f;
+	for (i=0; i<n; i++){
+		y[i] = (float)fabs(x[i] / (1.0f - state[i]));
+		state[i] = newState[i];
+	}
+}
+
+/* =======================================================================*/
+/*	The inverse cascade runs as a wavefront, as soscascade does but	*/
+/*	from the last channel down: lane r is channel C-1-r and at step	*/
+/*	t it adds sample t-r of its channel to the output of lane r-1	*/
+/*	from step t-1.  The lanes of a step are independent, so they	*/
+/*	run in SIMD; lane C-1 (channel 0) gives output sample t-C+1.	*/
+/*	The coefficients and states are kept in lane order.  Each	*/
+/*	channel does the same arithmetic as the loop in invsoscascade.	*/
+/*	The block holds the inverse AGC outputs (times the gains) of	*/
+/*	the samples the steps of a chunk need, a row per sample.	*/
+
+static void CascadeStep(INT lo, INT hi,
+		const DOUBLE *RESTRICT a0, const DOUBLE *RESTRICT a1,
+		const DOUBLE *RESTRICT a2, const DOUBLE *RESTRICT b1,
+		const DOUBLE *RESTRICT b2, DOUBLE *RESTRICT state1,
+		DOUBLE *RESTRICT state2, const DOUBLE *RESTRICT x, long stride,
+		const DOUBLE *RESTRICT y, DOUBLE *RESTRICT yn)
+{
+	INT	r;
+	DOUBLE	in, output;
+
+	for (r=lo; r<=hi; r++){
+		in = y[r] + x[r*stride];
+		output    = a0[r] * in                  + state1[r];
+		state1[r] = a1[r] * in - b1[r] * output + state2[r];
+		state2[r] = a2[r] * in - b2[r] * output;
+		yn[r+1] = output;
+	}
+}
+
+static void RunInverse(InvLyonEar *p)
+{
+	INT	nChannels = p->nChannels, nStages = p->nStages;
+	INT	nSteps = p->nSamples + nChannels - 1;
+	INT	i, k, n, r, t, t0, t1, lo, hi, base;
+	DOUBLE	*state = (DOUBLE *)p->stateData;
+	DOUBLE	*s1 = &state[nStages*nChannels], *s2 = s1 + nChannels;
+	const DOUBLE	*input = (const DOUBLE *)p->inputData;
+	DOUBLE	*lanes, *a0, *a1, *a2, *b1, *b2, *l1, *l2, *y, *yn, *swap;
+	DOUBLE	*block, *scratch, *x;
+
+	lanes = (DOUBLE *)mxCalloc((size_t)10*nChannels + 2, sizeof(DOUBLE));
+	a0 = lanes; a1 = a0 + nChannels; a2 = a1 + nChannels;
+	b1 = a2 + nChannels; b2 = b1 + nChannels;
+	l1 = b2 + nChannels; l2 = l1 + nChannels;
+	scratch = l2 + nChannels;
+	y = scratch + nChannels; yn = y + nChannels + 1;
+	for (r=0; r<nChannels; r++){
+		i = nChannels-1-r;
+		a0[r] = p->a0[i]; a1[r] = p->a1[i]; a2[r] = p->a2[i];
+		b1[r] = p->b1[i]; b2[r] = p->b2[i];
+		l1[r] = s1[i]; l2[r] = s2[i];
+	}
+					/* Row j of the block is sample
+					 * base+j; a chunk needs the C-1
+					 * samples before it too.
+					 */
+	block = (DOUBLE *)mxCalloc((size_t)(kBlockSamples+nChannels-1)*
+		nChannels, sizeof(DOUBLE));
+	base = -(nChannels-1);
+
+	for (t0=0; t0<nSteps; t0=t1){
+		t1 = t0 + kBlockSamples;
+		if (t1 > nSteps) t1 = nSteps;
+		if (t0 > 0)	/* Keep the last C-1 samples */
+			memmove(block, &block[(size_t)(t0-nChannels+1-base)*
+				nChannels], (size_t)(nChannels-1)*nChannels*
+				sizeof(DOUBLE));
+		base = t0 - nChannels + 1;
+					/* Inverse AGC, last stage first */
+		for (n=t0; n<t1 && n<p->nSamples; n++){
+			x = &block[(size_t)(n-base)*nChannels];
+			if (nStages == 0)
+				for (i=0; i<nChannels; i++)
+					x[i] = input[(size_t)n*nChannels + i];
+			for (k=nStages-1; k>=0; k--)
+				InverseAgcStage((k == nStages-1) ?
+					&input[(size_t)n*nChannels] : x, x,
+					state + k*nChannels, scratch,
+					p->agcParms[1+k*2], p->agcParms[0+k*2],
+					nChannels);
+			if (p->gains)
+				for (i=0; i<nChannels; i++)
+					x[i] = p->gains[i]*x[i];
+		}
+					/* Inverse cascade */
+		for (t=t0; t<t1; t++){
+			lo = t - p->nSamples + 1;
+			if (lo < 0) lo = 0;
+			hi = (t < nChannels-1) ? t : nChannels-1;
+			CascadeStep(lo, hi, a0, a1, a2, b1, b2, l1, l2,
+				&block[(size_t)(t-base)*nChannels + nChannels-1],
+				-(long)(nChannels+1), y, yn);
+			if (t >= nChannels-1)
+				((DOUBLE *)p->outputData)[t-nChannels+1] =
+					yn[nChannels];
+			swap = y; y = yn; yn = swap;
+		}
+	}
+
+	for (r=0; r<nChannels; r++){
+		s1[nChannels-1-r] = l1[r];
+		s2[nChannels-1-r] = l2[r];
+	}
+	mxFree(block);
+	mxFree(lanes);
+}
+
+/*	The same in single precision.					*/
+
+static void CascadeStepSingle(INT lo, INT hi,
+		const float *RESTRICT a0, const float *RESTRICT a1,
+		const float *RESTRICT a2, const float *RESTRICT b1,
+		const float *RESTRICT b2, float *RESTRICT state1,
+		float *RESTRICT state2, const float *RESTRICT x, long stride,
+		const float *RESTRICT y, float *RESTRICT yn)
+{
+	INT	r;
+	float	in, output;
+
+	for (r=lo; r<=hi; r++){
+		in = y[r] + x[r*stride];
+		output    = a0[r] * in                  + state1[r];
+		state1[r] = a1[r] * in - b1[r] * output + state2[r];
+		state2[r] = a2[r] * in - b2[r] * output;
+		yn[r+1] = output;
+	}
+}
+
+static void RunInverseSingle(InvLyonEar *p)
+{
+	INT	nChannels = p->nChannels, nStages = p->nStages;
+	INT	nSteps = p->nSamples + nChannels - 1;
+	INT	i, k, n, r, t, t0, t1, lo, hi, base;
+	float	*state = (float *)p->stateData;
+	float	*s1 = &state[nStages*nChannels], *s2 = s1 + nChannels;
+	const float	*input = (const float *)p->inputData;
+	float	*lanes, *a0, *a1, *a2, *b1, *b2, *l1, *l2, *y, *yn, *swap;
+	float	*block, *scratch, *x;
+
+	lanes = (float *)mxCalloc((size_t)10*nChannels + 2, sizeof(float));
+	a0 = lanes; a1 = a0 + nChannels; a2 = a1 + nChannels;
+	b1 = a2 + nChannels; b2 = b1 + nChannels;
+	l1 = b2 + nChannels; l2 = l1 + nChannels;
+	scratch = l2 + nChannels;
+	y = scratch + nChannels; yn = y + nChannels + 1;
+	for (r=0; r<nChannels; r++){
+		i = nChannels-1-r;
+		a0[r] = (float)p->a0[i]; a1[r] = (float)p->a1[i];
+		a2[r] = (float)p->a2[i];
+		b1[r] = (float)p->b1[i]; b2[r] = (float)p->b2[i];
+		l1[r] = s1[i]; l2[r] = s2[i];
+	}
+	block = (float *)mxCalloc((size_t)(kBlockSamples+nChannels-1)*
+		nChannels, sizeof(float));
+	base = -(nChannels-1);
+
+	for (t0=0; t0<nSteps; t0=t1){
+		t1 = t0 + kBlockSamples;
+		if (t1 > nSteps) t1 = nSteps;
+		if (t0 > 0)	/* Keep the last C-1 samples */
+			memmove(block, &block[(size_t)(t0-nChannels+1-base)*
+				nChannels], (size_t)(nChannels-1)*nChannels*
+				sizeof(float));
+		base = t0 - nChannels + 1;
+		for (n=t0; n<t1 && n<p->nSamples; n++){
+			x = &block[(size_t)(n-base)*nChannels];
+			if (nStages == 0)
+				for (i=0; i<nChannels; i++)
+					x[i] = input[(size_t)n*nChannels + i];
+			for (k=nStages-1; k>=0; k--)
+				InverseAgcStageSingle((k == nStages-1) ?
+					&input[(size_t)n*nChannels] : x, x,
+					state + k*nChannels, scratch,
+					p->agcParms[1+k*2], p->agcParms[0+k*2],
+					nChannels);
+			if (p->gains)
+				for (i=0; i<nChannels; i++)
+					x[i] = (float)p->gains[i]*x[i];
+		}
+		for (t=t0; t<t1; t++){
+			lo = t - p->nSamples + 1;
+			if (lo < 0) lo = 0;
+			hi = (t < nChannels-1) ? t : nChannels-1;
+			CascadeStepSingle(lo, hi, a0, a1, a2, b1, b2, l1, l2,
+				&block[(size_t)(t-base)*nChannels + nChannels-1],
+				-(long)(nChannels+1), y, yn);
+			if (t >= nChannels-1)
+				((float *)p->outputData)[t-nChannels+1] =
+					yn[nChannels];
+			swap = y; y = yn; yn = swap;
+		}
+	}
+
+	for (r=0; r<nChannels; r++){
+		s1[nChannels-1-r] = l1[r];
+		s2[nChannels-1-r] = l2[r];
+	}
+	mxFree(block);
+	mxFree(lanes);
+}
+
+/* =======================================================================*/
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	InvLyonEar	inverse, *p = &inverse;
+
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, p) ){
+		mexErrMsgTxt("invlyonear argument checking failed.");
+		return ;
+	}
+	if (p->isSingle)
+		RunInverseSingle(p);
+	else
+		RunInverse(p);
+						/* Assign output pointers */
+	plhs[0] = p->outputMatrix;
+	if (nlhs > 1)
+		plhs[1] = p->stateMatrix;
+	else
+		mxDestroyArray(p->stateMatrix);
+}
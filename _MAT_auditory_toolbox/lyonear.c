@@ -0,0 +1,307 @@
+/* =======================================================================
+*		lyonear.c	Lyon's passive ear in one pass: the
+*				filter cascade, half wave rectification,
+*				the AGC stages, the channel differences
+*				and the decimation filter, one sample at
+*				a time, keeping only every df'th output.
+*				This is the loop of LyonPassiveEar.m, so
+*				that long inputs need no full rate
+*				matrices.
+*
+*		(c) 1998 Interval Research Corporation
+*		[output,state] = lyonear(input, earFilters, agcParms,
+*					decFilter, df, differ, state)
+* ========================================================================*/
+
+/*
+ *	earFilters comes from DesignLyonFilters (C x 5, [A0 A1 A2 B1 B2]),
+ *	agcParms is [targets; epsilons] as for agc (2 x S, or [] for no
+ *	AGC), decFilter is the 1 x 5 decimation filter (used when df > 1)
+ *	and differ is nonzero to take the differences between channels.
+ *	The output is C x floor(N/df), all the channels (LyonPassiveEar
+ *	drops the first two).  Each stage does the same arithmetic as
+ *	soscascade, agc and sosfilters, so the output is the same as that
+ *	of the loop in LyonPassiveEar.m.
+ *
+ *	The state is C x (2+S+2): the cascade state, the AGC state and the
+ *	decimation filter state, as the three MEX files return them.  To
+ *	filter a long input in pieces, cut it on multiples of df and pass
+ *	the state on.  These two give the same result
+ *	>> f = DesignLyonFilters(16000);
+ *	>> d = [0 0 1 -1.99 .99];
+ *	>> p = [.0032 .0016; .0014 .0057];
+ *	>> x = randn(1,4000);
+ *	>> lyonear(x, f, p, d, 20, 1)
+ *	and
+ *	>> [y1,s] = lyonear(x(1:2000), f, p, d, 20, 1);
+ *	>> [y1 lyonear(x(2001:4000), f, p, d, 20, 1, s)]
+ *
+ *	All the work on a sample is done on one column of C values and the
+ *	states, which stay in the cache; the loops over the channels other
+ *	than the cascade itself vectorize.
+ */
+
+#define	pINPUTM			prhs[0]
+#define	pFILTERSM		prhs[1]
+#define	pAGCM			prhs[2]
+#define	pDECM			prhs[3]
+#define	pDFM			prhs[4]
+#define	pDIFFERM		prhs[5]
+#define	pSTATEM			prhs[6]
+
+#define	kNumCascadeStates	2
+#define	kNumDecStates		2
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include 	<math.h>
+#include	"mex.h"
+
+#ifndef	DOUBLE
+#define	DOUBLE	double
+#endif
+
+#ifndef	INT
+#define	INT	int
+#endif
+
+#define	mxGetSize(m)	(mxGetN(m) * mxGetM(m))
+
+#define	EPS	(1e-1)			/* As in agc.c */
+
+					/* Everything the ear needs, filled
+					 * in by CheckArguments().
+					 */
+typedef struct {
+	DOUBLE	*inputData, *outputData;
+	DOUBLE	*a0, *a1, *a2, *b1, *b2;	/* Cascade */
+	DOUBLE	*agcParms;
+	DOUBLE	*decFilter;
+	DOUBLE	*sosState1, *sosState2, *agcState, *decState1, *decState2;
+	INT	nSamples, nOutputSamples, nChannels, nStages, df;
+	int	differ;
+	mxArray	*outputMatrix, *stateMatrix;
+} LyonEar;
+
+/* =====================================================================*/
+/*	Function to determine if arguments are valid. 			*/
+/*	Also fill in some pointers we will need later.			*/
+
+static int CheckArguments(int nlhs, mxArray *plhs[],
+				int nrhs, const mxArray *prhs[], LyonEar *p)
+{
+	DOUBLE	*stateData;
+	INT	nStates;
+
+	if (nrhs < 6 || nrhs > 7 || nlhs > 2){
+		mexPrintf("Incorrect calling syntax:\n [output,state] = ");
+		mexPrintf("lyonear(input, earFilters, agcParms, decFilter, "
+			"df, differ, state)\n");
+		mexPrintf("        input has N samples\n");
+		mexPrintf("        earFilters is C x 5\n");
+		mexPrintf("        agcParms is 2 x S (targets;epsilons) "
+			"or []\n");
+		mexPrintf("        decFilter is 1 x 5\n");
+		mexPrintf("        state is C x (2+S+2)\n");
+		mexPrintf("        output is C x floor(N/df)\n");
+		return 1;
+	}
+
+/*------------ Check the input and the decimation ------------------- */
+	p->nSamples = mxGetSize(pINPUTM);
+	p->inputData = mxGetPr(pINPUTM);
+	p->df = (INT)mxGetScalar(pDFM);
+	if (p->df < 1)
+		p->df = 1;
+	p->nOutputSamples = p->nSamples/p->df;
+	p->differ = mxGetScalar(pDIFFERM) > 0;
+
+/*------------ Check the filters ------------------------------------ */
+	if ( mxGetN(pFILTERSM) != 5 || mxGetM(pFILTERSM) < 1) {
+		mexPrintf("earFilters must have 5 Columns: ");
+		mexPrintf("[A0 A1 A2 B1 B2]\n");
+		return 1;
+	}
+	p->nChannels = mxGetM(pFILTERSM);
+	p->a0 = &(mxGetPr(pFILTERSM)[0*p->nChannels]);
+	p->a1 = &(mxGetPr(pFILTERSM)[1*p->nChannels]);
+	p->a2 = &(mxGetPr(pFILTERSM)[2*p->nChannels]);
+	p->b1 = &(mxGetPr(pFILTERSM)[3*p->nChannels]);
+	p->b2 = &(mxGetPr(pFILTERSM)[4*p->nChannels]);
+
+	if (mxGetSize(pAGCM) == 0)
+		p->nStages = 0;
+	else if (mxGetM(pAGCM) != 2){
+		mexPrintf("agcParms must have 2 rows: "
+			"[target;epsilon]\n");
+		return 1;
+	} else
+		p->nStages = mxGetN(pAGCM);
+	p->agcParms = mxGetPr(pAGCM);
+
+	if (mxGetSize(pDECM) != 5){
+		mexPrintf("decFilter must be [A0 A1 A2 B1 B2]\n");
+		return 1;
+	}
+	p->decFilter = mxGetPr(pDECM);
+
+/*-------------------- Create the output matrix ----------------------- */
+	p->outputMatrix = mxCreateDoubleMatrix(p->nChannels,
+		p->nOutputSamples, mxREAL);
+	p->outputData = mxGetPr(p->outputMatrix);
+
+/*---- Create the state matrix, fill in the input values if specified --*/
+	nStates = kNumCascadeStates + p->nStages + kNumDecStates;
+	p->stateMatrix = mxCreateDoubleMatrix(p->nChannels, nStates, mxREAL);
+	stateData = mxGetPr(p->stateMatrix);
+	if ( nrhs >= 7 && mxGetSize(pSTATEM) > 0 ) {
+		DOUBLE	*inputStateArray;
+		int	i;
+
+		if ( mxGetM(pSTATEM) != p->nChannels ||
+		     mxGetN(pSTATEM) != nStates){
+			mexPrintf("MEX file lyonear got a bad state "
+				"input. Should be size %dx%d.\n",
+				p->nChannels, nStates);
+			return 1;
+		}
+		inputStateArray = mxGetPr(pSTATEM);
+		for (i=0; i<mxGetSize(pSTATEM); i++)
+			stateData[i] = inputStateArray[i];
+	}
+	p->sosState1 = &stateData[0*p->nChannels];
+	p->sosState2 = &stateData[1*p->nChannels];
+	p->agcState = &stateData[2*p->nChannels];
+	p->decState1 = &stateData[(2+p->nStages)*p->nChannels];
+	p->decState2 = &stateData[(3+p->nStages)*p->nChannels];
+
+	return 0;
+}
+
+/* =======================================================================*/
+/*	One AGC stage across the channels of a sample, as agc() in	*/
+/*	agc.c.  Each channel is smoothed with the old states of its	*/
+/*	neighbours, so the new states go to newState first.		*/
+
+static void AgcStage(DOUBLE *x, DOUBLE *state, DOUBLE *newState,
+	double epsilon, double target, INT n)
+{
+	INT	i;
+	DOUBLE	f, StateLimit = 1.-EPS;
+	DOUBLE	OneMinusEpsOverThree = (1.0 - epsilon)/3.0;
+	DOUBLE	EpsOverTarget = epsilon/target;
+
+	for (i=0; i<n; i++)
+		x[i] = fabs(x[i] * (1.0 - state[i]));
+	if (n == 1){
+		f = x[0] * EpsOverTarget +
+		    OneMinusEpsOverThree*(state[0] + state[0] + state[0]);
+		state[0] = (f > StateLimit) ? StateLimit : f;
+		return;
+	}
+	f = x[0] * EpsOverTarget +
+	    OneMinusEpsOverThree*(state[0] + state[0] + state[1]);
+	newState[0] = (f > StateLimit) ? StateLimit : f;
+	for (i=1; i<n-1; i++){
+		f = x[i] * EpsOverTarget +
+		    OneMinusEpsOverThree*(state[i-1] + state[i] + state[i+1]);
+		newState[i] = (f > StateLimit) ? StateLimit : f;
+	}
+	f = x[i] * EpsOverTarget +
+	    OneMinusEpsOverThree*(state[i-1] + state[i] + state[i]);
+	newState[i] = (f > StateLimit) ? StateLimit : f;
+	for (i=0; i<n; i++)
+		state[i] = newState[i];
+}
+
+/* =======================================================================*/
+/*	Run the whole ear over the input.				*/
+
+static void RunEar(LyonEar *p, DOUBLE *x, DOUBLE *scratch)
+{
+	INT	nChannels = p->nChannels, n, i, k, nUsed;
+	DOUBLE	in, out;
+	DOUBLE	*a0 = p->a0, *a1 = p->a1, *a2 = p->a2, *b1 = p->b1, *b2 = p->b2;
+	DOUBLE	*s1 = p->sosState1, *s2 = p->sosState2;
+	DOUBLE	*d1 = p->decState1, *d2 = p->decState2;
+	DOUBLE	da0 = p->decFilter[0], da1 = p->decFilter[1],
+		da2 = p->decFilter[2], db1 = p->decFilter[3],
+		db2 = p->decFilter[4];
+
+	nUsed = p->nOutputSamples*p->df;
+	for (n=0; n<nUsed; n++){
+					/* Filter cascade (soscascade) */
+		in = p->inputData[n];
+		for (i=0; i<nChannels; i++){
+			out   = a0[i] * in               + s1[i];
+			s1[i] = a1[i] * in - b1[i] * out + s2[i];
+			s2[i] = a2[i] * in - b2[i] * out;
+			x[i] = in = out;
+		}
+					/* Half wave rectify, and zero the
+					 * first two channels so that the
+					 * ear can be inverted.  The loop of
+					 * LyonPassiveEar.m zeroes only the
+					 * first sample of each block of df.
+					 */
+		for (i=0; i<nChannels; i++)
+			x[i] = (x[i] > 0) ? x[i] : 0;
+		if (n % p->df == 0)
+			for (i=0; i<2 && i<nChannels; i++)
+				x[i] = 0;
+					/* AGC (agc) */
+		for (k=0; k<p->nStages; k++)
+			AgcStage(x, p->agcState + k*nChannels, scratch,
+				p->agcParms[1+k*2], p->agcParms[0+k*2],
+				nChannels);
+					/* Differences between channels */
+		if (p->differ){
+			for (i=nChannels-1; i>0; i--){
+				out = x[i-1] - x[i];
+				x[i] = (out > 0) ? out : 0;
+			}
+			x[0] = (x[0] > 0) ? x[0] : 0;
+		}
+					/* Decimation filter (sosfilters) */
+		if (p->df > 1){
+			for (i=0; i<nChannels; i++){
+				in = x[i];
+				out   = da0 * in               + d1[i];
+				d1[i] = da1 * in - db1 * out + d2[i];
+				d2[i] = da2 * in - db2 * out;
+				x[i] = out;
+			}
+		}
+		if (n % p->df == p->df-1){
+			DOUBLE	*output = &p->outputData[
+					(size_t)(n/p->df)*nChannels];
+			for (i=0; i<nChannels; i++)
+				output[i] = x[i];
+		}
+	}
+}
+
+/* =======================================================================*/
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	LyonEar	ear, *p = &ear;
+	DOUBLE	*buffers;
+
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, p) ){
+		mexErrMsgTxt("lyonear argument checking failed.");
+		return ;
+	}
+					/* The sample being worked on, and
+					 * the new AGC states.
+					 */
+	buffers = (DOUBLE *)mxCalloc(2*p->nChannels, sizeof(DOUBLE));
+	RunEar(p, buffers, buffers + p->nChannels);
+	mxFree(buffers);
+						/* Assign output pointers */
+	plhs[0] = p->outputMatrix;
+	if (nlhs > 1)
+		plhs[1] = p->stateMatrix;
+	else
+		mxDestroyArray(p->stateMatrix);
+}
@@ -0,0 +1,279 @@
+/* =======================================================================
+*		meddishaircellmex.c	Ray Meddis' hair cell model,
+*					the transmitter reservoirs of
+*					MeddisHairCell.m for all the
+*					channels at once, with the state
+*					of the reservoirs explicit.
+*
+*		[y, state] = meddishaircellmex(data, sampleRate,
+*				subtractSpont, state)
+* ========================================================================*/
+
+/*
+ *	data has one channel per row, as for MeddisHairCell, and y is
+ *	the same as
+ *	>> y = MeddisHairCell(data, sampleRate, subtractSpont)
+ *	(subtractSpont defaults to 0).  The state is the free transmitter
+ *	(c), the cleft (q) and the reprocessing store (w) of each channel,
+ *	channels x 3, [c q w].  Without a state the reservoirs start at
+ *	their spontaneous levels, as in MeddisHairCell, so to check the
+ *	state compare
+ *	>> x = rand(4, 200);
+ *	>> y = meddishaircellmex(x, 16000);
+ *	and
+ *	>> [y1, s] = meddishaircellmex(x(:,1:100), 16000);
+ *	>> y - [y1 meddishaircellmex(x(:,101:200), 16000, 0, s)]
+ *
+ *	The name is not meddishaircell, which differs from MeddisHairCell.m
+ *	only by case and so is the same file on Windows and macOS.
+ *
+ *	The channels are independent, so the channel loop runs in SIMD
+ *	lanes (with optimization, e.g. -O3 -march=native); the reservoirs
+ *	of a block of channels are kept in local arrays while the block
+ *	goes through all the samples.  Compiled with OpenMP (CFLAGS=
+ *	'$CFLAGS -fopenmp' LDFLAGS='$LDFLAGS -fopenmp'), the blocks of
+ *	long inputs run on several threads.
+ */
+
+#define	pDATAM			prhs[0]
+#define	pRATEM			prhs[1]
+#define	pSUBTRACTM		prhs[2]
+#define	pSTATEM			prhs[3]
+
+#define	kNumStateVars		3
+
+#define	kBlockChannels		256	/* Channels in the local arrays */
+#define	kChannelAlign		8	/* Blocks start on a cache line */
+#define	kMinChannelsPerThread	8
+#define	kMinThreadedSize	(1<<18)	/* Channels x samples to use threads */
+
+/* Parameters from Meddis' April 1990 JASA paper, as in MeddisHairCell.m */
+#define	kM		1.0
+#define	kA		5.0
+#define	kB		300.0
+#define	kG		2000.0
+#define	kY		5.05
+#define	kL		2500.0
+#define	kR		6580.0
+#define	kX		66.31
+#define	kH		50000.0		/* Scales the discharge rate */
+
+#include	<stdio.h>
+#include 	<math.h>
+#include	"mex.h"
+#ifdef	_OPENMP
+#include	<omp.h>
+#endif
+
+#ifndef	DOUBLE
+#define	DOUBLE	double
+#endif
+
+#ifndef	INT
+#define	INT	int
+#endif
+
+#define	mxGetSize(m)	(mxGetN(m) * mxGetM(m))
+
+					/* Everything the model needs, filled
+					 * in by CheckArguments().
+					 */
+typedef struct {
+	const DOUBLE	*inputData;
+	DOUBLE	*outputData, *stateData;
+	DOUBLE	dt, spont;
+	int	subtractSpont;
+	INT	nChannels, nSamples;
+	mxArray	*outputMatrix, *stateMatrix;
+} HairCell;
+
+/* =====================================================================*/
+/*	Function to determine if arguments are valid. 			*/
+/*	Also fill in some pointers we will need later.			*/
+
+static int CheckArguments(int nlhs, mxArray *plhs[],
+				int nrhs, const mxArray *prhs[], HairCell *p){
+	DOUBLE	kt, sampleRate;
+	INT	i;
+
+	if (nrhs < 2 || nrhs > 4 || nlhs > 2){
+		printf("Incorrect calling syntax:\n [y, state] = ");
+		printf("meddishaircellmex(data, sampleRate, subtractSpont, "
+			"state)\n");
+		printf("        data is C x N\n");
+		printf("        state is C x 3\n");
+		printf("        y is C x N\n");
+		return 1;
+	}
+
+/*------------ Check input is not empty ------------------------------ */
+	if (!mxIsDouble(pDATAM) || mxIsComplex(pDATAM) ||
+	    mxGetSize(pDATAM) == 0){
+		printf("Data must be a real, non empty array\n");
+		return 1;
+	}
+	p->nChannels = mxGetM(pDATAM);
+	p->nSamples = mxGetN(pDATAM);
+	p->inputData = mxGetPr(pDATAM);
+	sampleRate = mxGetScalar(pRATEM);
+	if (sampleRate <= 0){
+		printf("The sample rate must be positive\n");
+		return 1;
+	}
+	p->dt = 1/sampleRate;
+	p->subtractSpont = nrhs > 2 && !mxIsEmpty(pSUBTRACTM) &&
+		mxGetScalar(pSUBTRACTM) > 0;
+
+/*-------------------- Create the output matrix -----------------------*/
+	p->outputMatrix = mxCreateDoubleMatrix(p->nChannels, p->nSamples,
+		mxREAL);
+	p->outputData = mxGetPr(p->outputMatrix);
+
+/*---- Create the state matrix, fill in the input values if specified --*/
+	kt = kG*kA/(kA+kB);
+	p->spont = kM*kY*kt/(kL*kt+kY*(kL+kR));
+	p->stateMatrix = mxCreateDoubleMatrix(p->nChannels, kNumStateVars,
+		mxREAL);
+	p->stateData = mxGetPr(p->stateMatrix);
+	if (nrhs > 3 && !mxIsEmpty(pSTATEM)){
+		const DOUBLE	*inputStateArray;
+
+		if (mxGetM(pSTATEM) != p->nChannels ||
+		    mxGetN(pSTATEM) != kNumStateVars ||
+		    !mxIsDouble(pSTATEM)){
+			mexPrintf("MEX file meddishaircellmex got a bad state "
+				"input. Should be size %dx%d.\n",
+				p->nChannels, kNumStateVars);
+			return 1;
+		}
+		inputStateArray = mxGetPr(pSTATEM);
+		for (i=0; i<mxGetSize(pSTATEM); i++)
+			p->stateData[i] = inputStateArray[i];
+	} else {			/* The spontaneous levels */
+		for (i=0; i<p->nChannels; i++){
+			p->stateData[i] = p->spont;
+			p->stateData[p->nChannels + i] =
+				p->spont*(kL+kR)/kt;
+			p->stateData[2*p->nChannels + i] = p->spont*kR/kX;
+		}
+	}
+
+	return 0;
+}
+
+/* =======================================================================*/
+/*	Channels c0..c1-1 (at most kBlockChannels) over all the		*/
+/*	samples, the reservoirs in local arrays so that the channel	*/
+/*	loop vectorizes.  The arithmetic is that of MeddisHairCell.m.	*/
+
+static void HairCellBlock(HairCell *p, INT c0, INT c1)
+{
+	DOUBLE	c[kBlockChannels], q[kBlockChannels], w[kBlockChannels];
+	DOUBLE	gdt = kG*p->dt, ydt = kY*p->dt, ldt = kL*p->dt;
+	DOUBLE	rdt = kR*p->dt, xdt = kX*p->dt, spont = p->spont;
+	DOUBLE	*stateData = p->stateData, *output;
+	const DOUBLE	*input;
+	INT	nc = c1 - c0, C = p->nChannels, i, n;
+
+	for (i=0; i<nc; i++){
+		c[i] = stateData[0*C + c0 + i];
+		q[i] = stateData[1*C + c0 + i];
+		w[i] = stateData[2*C + c0 + i];
+	}
+
+	for (n=0; n<p->nSamples; n++){
+		input = &p->inputData[(size_t)n*C + c0];
+		output = &p->outputData[(size_t)n*C + c0];
+		for (i=0; i<nc; i++){
+			DOUBLE	limitedSt, kt, replenish, eject, loss;
+			DOUBLE	reuptake, reprocess;
+
+			limitedSt = input[i] + kA;
+			limitedSt = limitedSt > 0 ? limitedSt : 0;
+			kt = gdt*limitedSt/(limitedSt + kB);
+			replenish = ydt*(kM - q[i]);
+			replenish = replenish > 0 ? replenish : 0;
+			eject = kt*q[i];
+			loss = ldt*c[i];
+			reuptake = rdt*c[i];
+			reprocess = xdt*w[i];
+
+			q[i] = q[i] + replenish - eject + reprocess;
+			c[i] = c[i] + eject - loss - reuptake;
+			w[i] = w[i] + reuptake - reprocess;
+			output[i] = kH*c[i];
+		}
+		if (p->subtractSpont)
+			for (i=0; i<nc; i++)
+				output[i] = (output[i] - spont > 0) ?
+					output[i] - spont : 0;
+	}
+
+	for (i=0; i<nc; i++){
+		stateData[0*C + c0 + i] = c[i];
+		stateData[1*C + c0 + i] = q[i];
+		stateData[2*C + c0 + i] = w[i];
+	}
+}
+
+/* =======================================================================*/
+/*	Split the channels into nBlocks blocks (on kChannelAlign	*/
+/*	boundaries, so two threads never write the same cache line of	*/
+/*	the output) and run block b.					*/
+
+static void RunBlock(HairCell *p, int b, int nBlocks)
+{
+	INT	c0, c1;
+
+	c0 = (INT)((long)p->nChannels*b/nBlocks);
+	c1 = (INT)((long)p->nChannels*(b+1)/nBlocks);
+	if (b > 0)
+		c0 -= c0 % kChannelAlign;
+	if (b < nBlocks-1)
+		c1 -= c1 % kChannelAlign;
+	HairCellBlock(p, c0, c1);
+}
+
+/* =======================================================================*/
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+	HairCell	hairCell, *p = &hairCell;
+	int	b, nBlocks;
+#ifdef	_OPENMP
+	int	nThreads = 1;
+#endif
+
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, p) ){
+		mexErrMsgTxt("meddishaircellmex argument checking failed.");
+		return ;
+	}
+
+					/* Each block fits the local arrays,
+					 * and each thread gets one at least.
+					 * RunBlock() may widen a block by up
+					 * to kChannelAlign-1 channels, so the
+					 * even split leaves room for that.
+					 */
+	nBlocks = (p->nChannels + kBlockChannels - kChannelAlign - 1)/
+		(kBlockChannels - kChannelAlign);
+#ifdef	_OPENMP
+	if ((long)p->nChannels*p->nSamples >= kMinThreadedSize){
+		nThreads = omp_get_max_threads();
+		if (nThreads > p->nChannels/kMinChannelsPerThread)
+			nThreads = p->nChannels/kMinChannelsPerThread;
+		if (nThreads < 1)
+			nThreads = 1;
+	}
+	if (nBlocks < nThreads)
+		nBlocks = nThreads;
+#pragma omp parallel for schedule(static) num_threads(nThreads) if(nThreads > 1)
+#endif
+	for (b=0; b<nBlocks; b++)
+		RunBlock(p, b, nBlocks);
+						/* Assign output pointers */
+	plhs[0] = p->outputMatrix;
+	if (nlhs > 1)
+		plhs[1] = p->stateMatrix;
+	else
+		mxDestroyArray(p->stateMatrix);
+}
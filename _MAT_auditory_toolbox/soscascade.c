@@ -36,15 +36,39 @@
  *	>>soscascade([0 0 0 0 0],[1 0 0 -.9 0;1 1 0 0 0], s)
  */
 
+/*
+ *	The cascade is run as a wavefront: channel i filters sample n-i
+ *	while channel 0 filters sample n.  At each step the input of
+ *	channel i is the output of channel i-1 from the step before, so
+ *	all the channels of a step are independent and the channel loop
+ *	runs in SIMD lanes (compile with optimization, e.g. -O3 -mavx2).
+ *	Each channel does the same arithmetic on the same samples as the
+ *	plain sample-by-channel loop, so the output and the state are the
+ *	same.  Compiled with OpenMP (e.g. CFLAGS='$CFLAGS -fopenmp'
+ *	LDFLAGS='$LDFLAGS -fopenmp'), long inputs are also split into
+ *	blocks of channels, one per thread; a block starts on each chunk
+ *	of samples as soon as the block before it has finished that chunk
+ *	of its last channel.
+ */
+
 #define	pINPUTM			prhs[0]
 #define	pCOEFFSM		prhs[1]
 #define pSTATEM			prhs[2]
 
 #define	kNumStateVars		2
 
+#define	kStepsPerChunk		64	/* Samples handed from block to block */
+#define	kMaxBlockChannels	128
+#define	kMinChannelsPerThread	16
+#define	kMinThreadedSize	(1<<18)	/* Channels x samples to use threads */
+
 #include	<stdio.h>
+#include	<stdlib.h>
 #include 	<math.h>
 #include	"mex.h"
+#ifdef	_OPENMP
+#include	<omp.h>
+#endif
 
 #ifndef	DOUBLE
 #define	DOUBLE	double
@@ -56,24 +80,35 @@
 
 #define	mxGetSize(m)	(mxGetN(m) * mxGetM(m))
 
-					/* OK, this is sleazy.... but
-					 * we only want to save this 
-					 * information between the CheckArgs()
-					 * function and the main program.  This
-					 * works as long as we aren't multi-
-					 * threaded.
+					/* The arrays of one step never overlap;
+					 * without saying so the compiler does
+					 * not vectorize the channel loop.
 					 */
-static DOUBLE	*inputData, *outputData, *state1, *state2;
-static DOUBLE	*a0, *a1, *a2, *b1, *b2;
-static INT	nSamples, nChannels;
-static mxArray	*outputMatrix = 0, *stateMatrix =0;
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define	RESTRICT	restrict
+#elif defined(__GNUC__) || defined(_MSC_VER)
+#define	RESTRICT	__restrict
+#else
+#define	RESTRICT
+#endif
+
+					/* Everything the filter needs, filled
+					 * in by CheckArguments(), so that
+					 * calls do not share any state.
+					 */
+typedef struct {
+	DOUBLE	*inputData, *outputData, *state1, *state2;
+	DOUBLE	*a0, *a1, *a2, *b1, *b2;
+	INT	nSamples, nChannels;
+	mxArray	*outputMatrix, *stateMatrix;
+} SosCascade;
 
 /* =====================================================================*/
 /*	Function to determine if arguments are valid. 			*/
 /*	Also fill in some pointers we will need later.			*/
 
 static  int CheckArguments(int nlhs, mxArray *plhs[], 
-				int nrhs, const mxArray *prhs[])
+				int nrhs, const mxArray *prhs[], SosCascade *p)
 {     
 	DOUBLE	*stateData;
 
@@ -90,12 +125,12 @@ static  int CheckArguments(int nlhs, mxArray *plhs[],
 	}
 
 /*------------ Check input is not empty ------------------------------ */	
-	nSamples = mxGetSize(pINPUTM);
-	if(nSamples == 0)   {
+	p->nSamples = mxGetSize(pINPUTM);
+	if(p->nSamples == 0)   {
 		printf("Input array is empty\n");
 		return 1;
 	}
-	inputData = mxGetPr(pINPUTM);
+	p->inputData = mxGetPr(pINPUTM);
 	
 /*------------ Check to See if Coeffs Matrix Is the right Size ------- */
 	if ( mxGetN(pCOEFFSM) != 5) {
@@ -103,41 +138,220 @@ static  int CheckArguments(int nlhs, mxArray *plhs[],
 		printf("Coeffs=[A0 A1 A2 B1 B2]\n");
 		return 1;
 	}
-	nChannels = mxGetM(pCOEFFSM);
-	a0 = &(mxGetPr(pCOEFFSM)[0*nChannels]);
-	a1 = &(mxGetPr(pCOEFFSM)[1*nChannels]);
-	a2 = &(mxGetPr(pCOEFFSM)[2*nChannels]);
-	b1 = &(mxGetPr(pCOEFFSM)[3*nChannels]);
-	b2 = &(mxGetPr(pCOEFFSM)[4*nChannels]);
+	p->nChannels = mxGetM(pCOEFFSM);
+	p->a0 = &(mxGetPr(pCOEFFSM)[0*p->nChannels]);
+	p->a1 = &(mxGetPr(pCOEFFSM)[1*p->nChannels]);
+	p->a2 = &(mxGetPr(pCOEFFSM)[2*p->nChannels]);
+	p->b1 = &(mxGetPr(pCOEFFSM)[3*p->nChannels]);
+	p->b2 = &(mxGetPr(pCOEFFSM)[4*p->nChannels]);
 	
 /*-------------------- Create the output matrix ----------------------- */
-	outputMatrix = mxCreateDoubleMatrix(nChannels, nSamples, mxREAL);
-	outputData = mxGetPr(outputMatrix);
+	p->outputMatrix = mxCreateDoubleMatrix(p->nChannels, p->nSamples, 
+		mxREAL);
+	p->outputData = mxGetPr(p->outputMatrix);
 
 /*---- Create the state matrix, fill in the input values if specified --*/
-	stateMatrix = mxCreateDoubleMatrix(nChannels, kNumStateVars, mxREAL);
-	stateData = mxGetPr(stateMatrix);
+	p->stateMatrix = mxCreateDoubleMatrix(p->nChannels, kNumStateVars, 
+		mxREAL);
+	stateData = mxGetPr(p->stateMatrix);
 	if ( nrhs >= 3 ) {
 		DOUBLE	*inputStateArray;
 		int	i;
 
-		if ( mxGetM(pSTATEM) != nChannels || 
+		if ( mxGetM(pSTATEM) != p->nChannels || 
 		     mxGetN(pSTATEM) != kNumStateVars){
 			mexPrintf("MEX file soscascade got a bad state "
 				"input. Should be size %dx%d.\n", 
-				nChannels, kNumStateVars);
+				p->nChannels, kNumStateVars);
 			return 1;
 		}
 		inputStateArray = mxGetPr(pSTATEM);
 		for (i=0; i<mxGetSize(pSTATEM); i++)
 			stateData[i] = inputStateArray[i];
 	}
-	state1 = &stateData[0*nChannels];
-	state2 = &stateData[1*nChannels];
+	p->state1 = &stateData[0*p->nChannels];
+	p->state2 = &stateData[1*p->nChannels];
 
 	return 0;
 }  
 
+/* =======================================================================*/
+/*	One step of the wavefront for channels lo..hi (of a block).	*/
+
+static void CascadeStep(INT lo, INT hi, 
+		const DOUBLE *RESTRICT a0, const DOUBLE *RESTRICT a1, 
+		const DOUBLE *RESTRICT a2, const DOUBLE *RESTRICT b1, 
+		const DOUBLE *RESTRICT b2, DOUBLE *RESTRICT state1, 
+		DOUBLE *RESTRICT state2, const DOUBLE *RESTRICT x, 
+		DOUBLE *RESTRICT xn)
+{
+	INT	j;
+	DOUBLE	xin, out;
+
+	for (j=lo; j<=hi; j++){
+		xin = x[j];
+		out       = a0[j] * xin               + state1[j];
+		state1[j] = a1[j] * xin - b1[j] * out + state2[j];
+		state2[j] = a2[j] * xin - b2[j] * out;
+		xn[j+1] = out;
+	}
+}
+
+/* =======================================================================*/
+/*	A block of channels c0..c1-1 and where its wavefront is.  At	*/
+/*	step t channel c0+j filters sample t-j.  Row t of the ring	*/
+/*	holds in [j+1] the output of channel c0+j at step t, which is	*/
+/*	also the input of channel c0+j+1 at step t+1; [0] gets the	*/
+/*	input of channel c0 for step t+1.  Sample n of the block is	*/
+/*	complete after step n+c1-c0-1, and is then copied from the 	*/
+/*	diagonal of the ring into the output, a column at a time.	*/
+
+typedef struct {
+	INT	c0, c1;
+	const DOUBLE	*in;		/* Input of channel c0 */
+	INT	inStride;
+	DOUBLE	*ring;
+	INT	nRows;			/* Rows in the ring, a power of 2 */
+	INT	t;			/* Next step */
+	INT	flushed;		/* Samples copied to the output */
+} CascadeBlock;
+
+static int InitBlock(SosCascade *p, CascadeBlock *b, INT c0, INT c1)
+{
+	b->c0 = c0;
+	b->c1 = c1;
+	if (c0 == 0){
+		b->in = p->inputData;
+		b->inStride = 1;
+	} else {			/* Last channel of the block before */
+		b->in = &p->outputData[c0-1];
+		b->inStride = p->nChannels;
+	}
+	for (b->nRows=1; b->nRows < kStepsPerChunk + c1 - c0 + 1; b->nRows*=2)
+		;
+	b->ring = (DOUBLE *)calloc((size_t)b->nRows*(c1-c0+1), 
+		sizeof(DOUBLE));
+	b->t = 0;
+	b->flushed = 0;
+	return b->ring == 0;
+}
+
+/*	Run the steps of block b up to t1 (at most kStepsPerChunk more)	*/
+/*	and copy the samples that are complete into the output.		*/
+
+static void RunBlock(SosCascade *p, CascadeBlock *b, INT t1)
+{
+	INT	width = b->c1 - b->c0 + 1, mask = b->nRows - 1;
+	INT	nSamples = p->nSamples, nChannels = p->nChannels;
+	INT	c0 = b->c0, t, j, n, lo, hi, nEnd;
+	DOUBLE	*x, *xn, *output;
+
+	for (t=b->t; t<t1; t++){
+		x = &b->ring[(size_t)((t+mask)&mask)*width];	/* Row t-1 */
+		xn = &b->ring[(size_t)(t&mask)*width];
+		if (t < nSamples)
+			x[0] = b->in[(size_t)t*b->inStride];
+		lo = t - nSamples + 1;		/* Channels with a sample */
+		if (lo < 0) lo = 0;
+		hi = width - 2;
+		if (hi > t) hi = t;
+		CascadeStep(lo, hi, p->a0+c0, p->a1+c0, p->a2+c0, p->b1+c0, 
+			p->b2+c0, p->state1+c0, p->state2+c0, x, xn);
+	}
+	b->t = t1;
+
+	nEnd = t1 - width + 2;
+	if (nEnd > nSamples) nEnd = nSamples;
+	for (n=b->flushed; n<nEnd; n++){
+		output = &p->outputData[(size_t)n*nChannels + c0];
+		for (j=0; j<width-1; j++)
+			output[j] = b->ring[(size_t)((n+j)&mask)*width + j+1];
+	}
+	if (nEnd > b->flushed)
+		b->flushed = nEnd;
+}
+
+/* =======================================================================*/
+/*	The whole cascade on one thread, kMaxBlockChannels channels	*/
+/*	at a time.							*/
+
+static int RunCascade(SosCascade *p)
+{
+	CascadeBlock	b;
+	INT	c0, c1, t, nSteps;
+
+	for (c0=0; c0<p->nChannels; c0=c1){
+		c1 = c0 + kMaxBlockChannels;
+		if (c1 > p->nChannels) c1 = p->nChannels;
+		if (InitBlock(p, &b, c0, c1))
+			return 1;
+		nSteps = p->nSamples + c1 - c0 - 1;
+		for (t=0; t<nSteps; t+=kStepsPerChunk)
+			RunBlock(p, &b, (t+kStepsPerChunk < nSteps) ? 
+				t+kStepsPerChunk : nSteps);
+		free(b.ring);
+	}
+	return 0;
+}
+
+/* =======================================================================*/
+/*	The cascade split into blocks of channels over the threads,	*/
+/*	thread k runs blocks k, k+nThreads, ...  Block k filters the	*/
+/*	output of the last channel of block k-1 kStepsPerChunk samples	*/
+/*	at a time, as soon as done[k-1] (the samples of block k-1 in	*/
+/*	the output) says they are there.				*/
+
+#ifdef	_OPENMP
+static int RunCascadeThreaded(SosCascade *p, int nThreads)
+{
+	volatile INT	*done;
+	int	nBlocks, failed = 0;
+
+	nBlocks = (p->nChannels + kMaxBlockChannels - 1)/kMaxBlockChannels;
+	if (nBlocks < nThreads)
+		nBlocks = nThreads;
+	done = (volatile INT *)calloc(nBlocks, sizeof(INT));
+	if (!done)
+		return 1;
+#pragma omp parallel num_threads(nThreads)
+	{
+		int	k, nt = omp_get_num_threads();
+		INT	c0, c1, t, t1, ready, nSteps;
+		CascadeBlock	b;
+
+		for (k=omp_get_thread_num(); k<nBlocks; k+=nt){
+			c0 = (INT)((long)p->nChannels*k/nBlocks);
+			c1 = (INT)((long)p->nChannels*(k+1)/nBlocks);
+			if (InitBlock(p, &b, c0, c1)){
+#pragma omp atomic
+				failed |= 1;
+			}
+			nSteps = p->nSamples + c1 - c0 - 1;
+			for (t=0; t<nSteps; t=t1){
+				t1 = t + kStepsPerChunk;
+				if (t1 > nSteps) t1 = nSteps;
+				if (k > 0){	/* Wait for the input */
+					ready = (t1 < p->nSamples) ? 
+						t1 : p->nSamples;
+					while (done[k-1] < ready){
+#pragma omp flush
+					}
+#pragma omp flush
+				}
+				if (b.ring)
+					RunBlock(p, &b, t1);
+#pragma omp flush
+				done[k] = b.ring ? b.flushed : p->nSamples;
+#pragma omp flush
+			}
+			free(b.ring);
+		}
+	}
+	free((void *)done);
+	return failed;
+}
+#endif
+
 /* =======================================================================*/
 
 
@@ -145,40 +359,43 @@ static  int CheckArguments(int nlhs, mxArray *plhs[],
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])  
 { 	
-	register int	i, n;
-	register double	in, *output;
+	SosCascade	cascade, *p = &cascade;
+	int	failed;
+#ifdef	_OPENMP
+	int	nThreads = 1;
+#endif
 
 	if (nrhs >= 1 && mxIsChar(prhs[0])){
 						/* Obsolete commands ignored */
 		return;
 	}
 
-	if (CheckArguments(nlhs, plhs, nrhs, prhs) ){
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, p) ){
 		mexErrMsgTxt("soscascade argument checking failed.");
 		return ;
 	}
 
-	for (n=0; n<0*nChannels; n++){
-		printf(" Channel %d: %g %g %g, %g %d\n", n, a0[n], a1[n], 
-			a2[n], b1[n], b2[n]);
-		printf("    state1 is %g, state2 is %g.\n", state1[n], 
-			state2[n]);
+#ifdef	_OPENMP
+	if ((long)p->nChannels*p->nSamples >= kMinThreadedSize){
+		nThreads = omp_get_max_threads();
+		if (nThreads > p->nChannels/kMinChannelsPerThread)
+			nThreads = p->nChannels/kMinChannelsPerThread;
 	}
-
-	for (n=0; n<nSamples; n++){
-		in = inputData[n];
-		output = &outputData[n*nChannels];
-		for (i=0; i<nChannels; i++){
-			output[i] = a0[i] * in                     + state1[i];
-			state1[i] = a1[i] * in - b1[i] * output[i] + state2[i];
-			state2[i] = a2[i] * in - b2[i] * output[i];
-			in = output[i];
-		}
+	if (nThreads > 1)
+		failed = RunCascadeThreaded(p, nThreads);
+	else
+#endif
+	failed = RunCascade(p);
+	if (failed){
+		mxDestroyArray(p->outputMatrix);
+		mxDestroyArray(p->stateMatrix);
+		mexErrMsgTxt("soscascade: out of memory.");
+		return ;
 	}
 						/* Assign output pointers */
-	plhs[0] = outputMatrix; 
+	plhs[0] = p->outputMatrix; 
 	if (nlhs > 1)
-		plhs[1] = stateMatrix;
+		plhs[1] = p->stateMatrix;
 	else
-		mxDestroyArray(stateMatrix);
+		mxDestroyArray(p->stateMatrix);
 }
@@ -48,15 +48,41 @@
  *	>> sosfilters(zeros(1,5), [1 0 0 -.9 0; 1 0 0 -.8 0], s)
  */
 
+/*
+ *	The channels are independent, so the channel loop runs in SIMD
+ *	lanes (compile with optimization, e.g. -O3 -mavx2 or -march=native
+ *	for 4 to 16 channels per instruction).  The coefficients and state
+ *	of a block of channels are kept in local arrays while the block
+ *	goes through all the samples.  Each channel does the same
+ *	arithmetic as the plain loop, so the output and the state are the
+ *	same.  Compiled with OpenMP (e.g. CFLAGS='$CFLAGS -fopenmp'
+ *	LDFLAGS='$LDFLAGS -fopenmp'), the blocks of long inputs are
+ *	filtered on several threads.
+ *
+ *	A single precision input is filtered in single precision, twice
+ *	as many channels per instruction, and gives a single output and
+ *	state.  The coefficients and the state passed in can be single or
+ *	double either way.
+ *	>> sosfilters(single([1 0 0 0 0 0]), [1 0 0 -.9 0; 1 0 0 -.8 0])
+ */
+
 #define	pINPUTM			prhs[0]
 #define	pCOEFFSM		prhs[1]
 #define pSTATEM			prhs[2]
 
 #define	kNumStateVars		2
 
+#define	kBlockChannels		256	/* Channels in the local arrays */
+#define	kChannelAlign		8	/* Blocks start on a cache line */
+#define	kMinChannelsPerThread	8
+#define	kMinThreadedSize	(1<<18)	/* Channels x samples to use threads */
+
 #include	<stdio.h>
 #include 	<math.h>
 #include	"mex.h"
+#ifdef	_OPENMP
+#include	<omp.h>
+#endif
 
 #ifndef	DOUBLE
 #define	DOUBLE	double
@@ -69,24 +95,36 @@
 #define	mxGetSize(m)	(mxGetN(m) * mxGetM(m))
 #define max(a,b)	((a) > (b)? (a) : (b))
 
-					/* OK, this is sleazy.... but
-					 * we only want to save this 
-					 * information between the CheckArgs()
-					 * function and the main program.
+					/* Everything the filters need, filled
+					 * in by CheckArguments(), so that
+					 * calls do not share any state.
 					 */
-static DOUBLE	*inputData, *outputData, *state1, *state2;
-static DOUBLE	*a0, *a1, *a2, *b1, *b2;
-static INT	nSamples, nInputChannels, nFilterChannels, nOutputChannels;
-static mxArray	*outputMatrix, *stateMatrix;
+typedef struct {
+	void	*inputData, *outputData, *stateData;	/* DOUBLE or float */
+	void	*coeffData;
+	int	isSingle, coeffsSingle;
+	INT	nSamples, nInputChannels, nFilterChannels, nOutputChannels;
+	mxArray	*outputMatrix, *stateMatrix;
+} SosFilters;
+
+/* =====================================================================*/
+/*	Element k of a double or single array.				*/
+
+static DOUBLE GetValue(const void *data, int isSingle, INT k)
+{
+	if (isSingle)
+		return ((const float *)data)[k];
+	return ((const DOUBLE *)data)[k];
+}
 
 /* =====================================================================*/
 /*	Function to determine if arguments are valid. 			*/
 /*	Also fill in some pointers we will need later.			*/
 
 static int CheckArguments(int nlhs, mxArray *plhs[], 
-				int nrhs, const mxArray *prhs[]){
+				int nrhs, const mxArray *prhs[], SosFilters *p){
 	int	n, m;
-	DOUBLE	*stateData;
+	mxClassID	classID;
 
 	if (nrhs < 2 || nrhs > 4 || nlhs > 2){
 		printf("Incorrect calling syntax:\n [output, state] = ");
@@ -106,13 +144,19 @@ static int CheckArguments(int nlhs, mxArray *plhs[],
 		return 1;
 	}
 	if (n == 1){
-		nSamples = m;
-		nInputChannels = 1;
+		p->nSamples = m;
+		p->nInputChannels = 1;
 	} else {
-		nSamples = n;
-		nInputChannels = m;
+		p->nSamples = n;
+		p->nInputChannels = m;
+	}
+	if (!(mxIsDouble(pINPUTM) || mxIsSingle(pINPUTM)) || 
+	    !(mxIsDouble(pCOEFFSM) || mxIsSingle(pCOEFFSM))){
+		printf("Input and Coeffs must be double or single\n");
+		return 1;
 	}
-	inputData = mxGetPr(pINPUTM);
+	p->isSingle = mxIsSingle(pINPUTM);
+	p->inputData = mxGetData(pINPUTM);
 	
 /*------------ Check to See if Coeffs Matrix Is the right Size ------- */
 	if ( mxGetN(pCOEFFSM) != 5) {
@@ -120,104 +164,236 @@ static int CheckArguments(int nlhs, mxArray *plhs[],
 		printf("Coeffs=[A0 A1 A2 B1 B2]\n");
 		return 1;
 	}
-	nFilterChannels = mxGetM(pCOEFFSM);
-	if (nInputChannels > 1 && nFilterChannels > 1 &&
-	    nInputChannels != nFilterChannels){
+	p->nFilterChannels = mxGetM(pCOEFFSM);
+	if (p->nInputChannels > 1 && p->nFilterChannels > 1 &&
+	    p->nInputChannels != p->nFilterChannels){
 		printf("Number of input channels and filter channels must be");
 		printf(" compatible.\n");
 		printf("  One or the other equals one and or both are the ");
 		printf("same.\n");
 		return 1;
 	}
-	nOutputChannels = max(nInputChannels, nFilterChannels);
-	a0 = &(mxGetPr(pCOEFFSM)[0*nFilterChannels]);
-	a1 = &(mxGetPr(pCOEFFSM)[1*nFilterChannels]);
-	a2 = &(mxGetPr(pCOEFFSM)[2*nFilterChannels]);
-	b1 = &(mxGetPr(pCOEFFSM)[3*nFilterChannels]);
-	b2 = &(mxGetPr(pCOEFFSM)[4*nFilterChannels]);
+	p->nOutputChannels = max(p->nInputChannels, p->nFilterChannels);
+	p->coeffData = mxGetData(pCOEFFSM);
+	p->coeffsSingle = mxIsSingle(pCOEFFSM);
 	
 /*-------------------- Create the output matrix -----------------------*/
-	outputMatrix = mxCreateDoubleMatrix(nOutputChannels, nSamples, mxREAL);
-	outputData = mxGetPr(outputMatrix);
+	classID = p->isSingle ? mxSINGLE_CLASS : mxDOUBLE_CLASS;
+	p->outputMatrix = mxCreateNumericMatrix(p->nOutputChannels, 
+		p->nSamples, classID, mxREAL);
+	p->outputData = mxGetData(p->outputMatrix);
 
 /*---- Create the state matrix, fill in the input values if specified --*/
-	stateMatrix = mxCreateDoubleMatrix(nOutputChannels, kNumStateVars, 
-		mxREAL);
-	stateData = mxGetPr(stateMatrix);
+	p->stateMatrix = mxCreateNumericMatrix(p->nOutputChannels, 
+		kNumStateVars, classID, mxREAL);
+	p->stateData = mxGetData(p->stateMatrix);
 	if ( nrhs >= 3 ) {
-		DOUBLE	*inputStateArray;
-		int	i;
+		const void	*inputStateArray;
+		int	i, stateSingle;
 
-		if ( mxGetM(pSTATEM) != nOutputChannels || 
-		     mxGetN(pSTATEM) != kNumStateVars){
+		if ( mxGetM(pSTATEM) != p->nOutputChannels || 
+		     mxGetN(pSTATEM) != kNumStateVars ||
+		     !(mxIsDouble(pSTATEM) || mxIsSingle(pSTATEM))){
 			mexPrintf("MEX file sosfilters got a bad state "
 				"input. Should be size %dx%d.\n", 
-				nOutputChannels, kNumStateVars);
+				p->nOutputChannels, kNumStateVars);
 			return 1;
 		}
-		inputStateArray = mxGetPr(pSTATEM);
-		for (i=0; i<mxGetSize(pSTATEM); i++)
-			stateData[i] = inputStateArray[i];
+		inputStateArray = mxGetData(pSTATEM);
+		stateSingle = mxIsSingle(pSTATEM);
+		for (i=0; i<mxGetSize(pSTATEM); i++){
+			if (p->isSingle)
+				((float *)p->stateData)[i] = (float)GetValue(
+					inputStateArray, stateSingle, i);
+			else
+				((DOUBLE *)p->stateData)[i] = GetValue(
+					inputStateArray, stateSingle, i);
+		}
 	}
-	state1 = &stateData[0*nOutputChannels];
-	state2 = &stateData[1*nOutputChannels];
 
 	return 0;
 }  
 
+/* =======================================================================*/
+/*	Filter channels c0..c1-1 (at most kBlockChannels) over all the	*/
+/*	samples.  The coefficients and the state are copied into local	*/
+/*	arrays, which the compiler knows do not overlap the input and	*/
+/*	the output, so the channel loops vectorize.			*/
+
+static void FilterBlock(SosFilters *p, INT c0, INT c1)
+{
+	DOUBLE	a0[kBlockChannels], a1[kBlockChannels], a2[kBlockChannels];
+	DOUBLE	b1[kBlockChannels], b2[kBlockChannels];
+	DOUBLE	state1[kBlockChannels], state2[kBlockChannels];
+	DOUBLE	*stateData = (DOUBLE *)p->stateData, in, out, *output;
+	const DOUBLE	*inputData = (const DOUBLE *)p->inputData, *input;
+	INT	nc = c1 - c0, nOut = p->nOutputChannels, nf = p->nFilterChannels;
+	INT	i, k, n;
+
+	for (i=0; i<nc; i++){
+		k = (nf == 1) ? 0 : c0 + i;
+		a0[i] = GetValue(p->coeffData, p->coeffsSingle, k + 0*nf);
+		a1[i] = GetValue(p->coeffData, p->coeffsSingle, k + 1*nf);
+		a2[i] = GetValue(p->coeffData, p->coeffsSingle, k + 2*nf);
+		b1[i] = GetValue(p->coeffData, p->coeffsSingle, k + 3*nf);
+		b2[i] = GetValue(p->coeffData, p->coeffsSingle, k + 4*nf);
+		state1[i] = stateData[0*nOut + c0 + i];
+		state2[i] = stateData[1*nOut + c0 + i];
+	}
+
+	if (p->nInputChannels == 1){
+	    for (n=0; n<p->nSamples; n++){
+	        in = inputData[n];
+	        output = &((DOUBLE *)p->outputData)[(size_t)n*nOut + c0];
+	        for (i=0; i<nc; i++){
+	    	    out       = a0[i] * in               + state1[i];
+	    	    state1[i] = a1[i] * in - b1[i] * out + state2[i];
+	    	    state2[i] = a2[i] * in - b2[i] * out;
+	    	    output[i] = out;
+	        }
+	    }
+	} else {
+	    for (n=0; n<p->nSamples; n++){
+	        input = &inputData[(size_t)n*p->nInputChannels + c0];
+	        output = &((DOUBLE *)p->outputData)[(size_t)n*nOut + c0];
+	        for (i=0; i<nc; i++){
+	            in = input[i];
+	    	    out       = a0[i] * in               + state1[i];
+	    	    state1[i] = a1[i] * in - b1[i] * out + state2[i];
+	    	    state2[i] = a2[i] * in - b2[i] * out;
+	    	    output[i] = out;
+	        }
+	    }
+	}
+
+	for (i=0; i<nc; i++){
+		stateData[0*nOut + c0 + i] = state1[i];
+		stateData[1*nOut + c0 + i] = state2[i];
+	}
+}
+
+/*	The same in single precision.					*/
+
+static void FilterBlockSingle(SosFilters *p, INT c0, INT c1)
+{
+	float	a0[kBlockChannels], a1[kBlockChannels], a2[kBlockChannels];
+	float	b1[kBlockChannels], b2[kBlockChannels];
+	float	state1[kBlockChannels], state2[kBlockChannels];
+	float	*stateData = (float *)p->stateData, in, out, *output;
+	const float	*inputData = (const float *)p->inputData, *input;
+	INT	nc = c1 - c0, nOut = p->nOutputChannels, nf = p->nFilterChannels;
+	INT	i, k, n;
+
+	for (i=0; i<nc; i++){
+		k = (nf == 1) ? 0 : c0 + i;
+		a0[i] = (float)GetValue(p->coeffData, p->coeffsSingle, k + 0*nf);
+		a1[i] = (float)GetValue(p->coeffData, p->coeffsSingle, k + 1*nf);
+		a2[i] = (float)GetValue(p->coeffData, p->coeffsSingle, k + 2*nf);
+		b1[i] = (float)GetValue(p->coeffData, p->coeffsSingle, k + 3*nf);
+		b2[i] = (float)GetValue(p->coeffData, p->coeffsSingle, k + 4*nf);
+		state1[i] = stateData[0*nOut + c0 + i];
+		state2[i] = stateData[1*nOut + c0 + i];
+	}
+
+	if (p->nInputChannels == 1){
+	    for (n=0; n<p->nSamples; n++){
+	        in = inputData[n];
+	        output = &((float *)p->outputData)[(size_t)n*nOut + c0];
+	        for (i=0; i<nc; i++){
+	    	    out       = a0[i] * in               + state1[i];
+	    	    state1[i] = a1[i] * in - b1[i] * out + state2[i];
+	    	    state2[i] = a2[i] * in - b2[i] * out;
+	    	    output[i] = out;
+	        }
+	    }
+	} else {
+	    for (n=0; n<p->nSamples; n++){
+	        input = &inputData[(size_t)n*p->nInputChannels + c0];
+	        output = &((float *)p->outputData)[(size_t)n*nOut + c0];
+	        for (i=0; i<nc; i++){
+	            in = input[i];
+	    	    out       = a0[i] * in               + state1[i];
+	    	    state1[i] = a1[i] * in - b1[i] * out + state2[i];
+	    	    state2[i] = a2[i] * in - b2[i] * out;
+	    	    output[i] = out;
+	        }
+	    }
+	}
+
+	for (i=0; i<nc; i++){
+		stateData[0*nOut + c0 + i] = state1[i];
+		stateData[1*nOut + c0 + i] = state2[i];
+	}
+}
+
+/* =======================================================================*/
+/*	Split the channels into nBlocks blocks (on kChannelAlign	*/
+/*	boundaries, so two threads never write the same cache line of	*/
+/*	the output) and filter block b.					*/
+
+static void RunBlock(SosFilters *p, int b, int nBlocks)
+{
+	INT	c0, c1;
+
+	c0 = (INT)((long)p->nOutputChannels*b/nBlocks);
+	c1 = (INT)((long)p->nOutputChannels*(b+1)/nBlocks);
+	if (b > 0)
+		c0 -= c0 % kChannelAlign;
+	if (b < nBlocks-1)
+		c1 -= c1 % kChannelAlign;
+	if (p->isSingle)
+		FilterBlockSingle(p, c0, c1);
+	else
+		FilterBlock(p, c0, c1);
+}
+
 /* =======================================================================*/
 
 #define	kCommandSize	20
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
-	register int	i, n;
-	register DOUBLE	in, *output;
+	SosFilters	filters, *p = &filters;
+	int	b, nBlocks;
+#ifdef	_OPENMP
+	int	nThreads = 1;
+#endif
 
 	if (nrhs >= 1 && mxIsChar(prhs[0])){
 						/* Ignore obsolete cmds */
 		return;
 	}
 
-	if (CheckArguments(nlhs, plhs, nrhs, prhs) ){
+	if (CheckArguments(nlhs, plhs, nrhs, prhs, p) ){
 		mexErrMsgTxt("sosfilters argument checking failed.");
 		return ;
 	}
 
-	if (nInputChannels == 1){
-	    for (n=0; n<nSamples; n++){
-	        in = inputData[n];
-	        output = &outputData[n*nOutputChannels];
-	        for (i=0; i<nOutputChannels; i++){
-	    	    output[i] = a0[i] * in                     + state1[i];
-	    	    state1[i] = a1[i] * in - b1[i] * output[i] + state2[i];
-	    	    state2[i] = a2[i] * in - b2[i] * output[i];
-	        }
-	    }
-	} else if (nFilterChannels == 1){
-	    for (n=0; n<nSamples; n++){
-	        output = &outputData[n*nOutputChannels];
-	        for (i=0; i<nOutputChannels; i++){
-	            in = inputData[n*nInputChannels + i];
-	    	    output[i] = a0[0] * in                     + state1[i];
-	    	    state1[i] = a1[0] * in - b1[0] * output[i] + state2[i];
-	    	    state2[i] = a2[0] * in - b2[0] * output[i];
-	        }
-	    }
-	} else {
-	    for (n=0; n<nSamples; n++){
-	        output = &outputData[n*nOutputChannels];
-	        for (i=0; i<nOutputChannels; i++){
-	            in = inputData[n*nInputChannels + i];
-	    	    output[i] = a0[i] * in                     + state1[i];
-	    	    state1[i] = a1[i] * in - b1[i] * output[i] + state2[i];
-	    	    state2[i] = a2[i] * in - b2[i] * output[i];
-	        }
-	    }
+					/* Each block fits the local arrays,
+					 * and each thread gets one at least.
+					 * RunBlock() may widen a block by up
+					 * to kChannelAlign-1 channels, so the
+					 * even split leaves room for that.
+					 */
+	nBlocks = (p->nOutputChannels + kBlockChannels - kChannelAlign - 1)/
+		(kBlockChannels - kChannelAlign);
+#ifdef	_OPENMP
+	if ((long)p->nOutputChannels*p->nSamples >= kMinThreadedSize){
+		nThreads = omp_get_max_threads();
+		if (nThreads > p->nOutputChannels/kMinChannelsPerThread)
+			nThreads = p->nOutputChannels/kMinChannelsPerThread;
+		if (nThreads < 1)
+			nThreads = 1;
 	}
+	if (nBlocks < nThreads)
+		nBlocks = nThreads;
+#pragma omp parallel for schedule(static) num_threads(nThreads) if(nThreads > 1)
+#endif
+	for (b=0; b<nBlocks; b++)
+		RunBlock(p, b, nBlocks);
 						/* Assign output pointers */
-	plhs[0] = outputMatrix; 
+	plhs[0] = p->outputMatrix; 
 	if (nlhs > 1)
-		plhs[1] = stateMatrix;
+		plhs[1] = p->stateMatrix;
 	else
-		mxDestroyArray(stateMatrix);
+		mxDestroyArray(p->stateMatrix);
 }
@@ -80,6 +80,14 @@ if strcmp(test,'CorrelogramPitch') | strcmp(test,'all')
 	plot(sal); if pausetest, pause, end;
 end
 
+if strcmp(test,'correlogram') | strcmp(test,'all')
+	disp('correlogram test');
+	c = rand(4, 1000);
+	pic = CorrelogramFrame(c, 64, 101, 256);
+	mov = correlogram(c, 64, 100, 256, 2);
+	max(max(abs(pic - reshape(mov, 4, 64))))
+end
+
 if strcmp(test,'DesignLyonFilters') | strcmp(test,'all')
 	disp('DesignLyonFilters test');
 	filts=DesignLyonFilters(16000);
@@ -129,6 +137,25 @@ if strcmp(test,'LyonPassiveEar') | strcmp(test,'all')
 	imagesc(coch/max(max(coch))); if pausetest, pause, end;;
 end
 
+if strcmp(test,'lyonear') | strcmp(test,'all')
+	disp('lyonear test');
+	% The loop of LyonPassiveEar.m with the three MEX files, at df > 1;
+	% lyonear should give the same output (the difference is 0).
+	f = DesignLyonFilters(16000); c = size(f,1);
+	p = [.0032 .0016; .0014 .0057]; d = [0 0 .0025 -1.9 .9025]; df = 20;
+	x = randn(1,4000);
+	y = zeros(c, 200); s1 = zeros(c,2); s2 = zeros(c,2); s3 = zeros(c,2);
+	for i=0:size(y,2)-1
+		[o s1] = soscascade(x(i*df+1:i*df+df), f, s1);
+		o = max(0, o); o(1) = 0; o(2) = 0;
+		[o s2] = agc(o, p, s2);
+		o = max(0, [o(1,:); o(1:c-1,:) - o(2:c,:)]);
+		[o s3] = sosfilters(o, d, s3);
+		y(:,i+1) = o(:,df);
+	end
+	max(max(abs(y - lyonear(x, f, p, d, df, 1))))
+end
+
 if strcmp(test,'MakeERBFilters') | strcmp(test,'all')
 	disp('MakeERBFilters test');
 	fcoefs = MakeERBFilters(16000,10,100);
@@ -182,6 +209,20 @@ if strcmp(test,'MeddisHairCell') | strcmp(test,'all')
 	plot((1:90000)/20000,y(1:90000)); if pausetest, pause, end;
 end
 
+if strcmp(test,'meddishaircellmex') | strcmp(test,'all')
+	disp('meddishaircellmex test');
+	x = rand(4, 200);
+	[y1, s] = meddishaircellmex(x(:,1:100), 16000);
+	meddishaircellmex(x, 16000) - [y1 meddishaircellmex(x(:,101:200), 16000, 0, s)]
+	% 511 channels do not fill the channel blocks evenly.
+	x = rand(511, 50);
+	y = meddishaircellmex(x, 16000);
+	k = [1 248 249 256 257 511];
+	yk = zeros(length(k), 50);
+	for j=1:length(k), yk(j,:) = meddishaircellmex(x(k(j),:), 16000); end
+	max(max(abs(y(k,:) - yk)))
+end
+
 if strcmp(test,'mfcc') | strcmp(test,'all')
 	disp('mfcc test');
 	set_window_size(348, 188);
@@ -272,6 +313,12 @@ if strcmp(test,'sosfilters') | strcmp(test,'all')
 	sosfilters([1 0 0 0 0 0;2 0 0 0 0 0], ...
 	            [1 0 0 -.9 0;1 0 0 -.8 0])
 	sosfilters([1 0 0 0 0 0;2 0 0 0 0 0],[1 0 0 -.9 0])
+	sosfilters(single([1 0 0 0 0 0]),[1 0 0 -.9 0;1 0 0 -.8 0])
+	% 511 channels do not fill the channel blocks evenly; each row is an
+	% exponential, so this should be zero.
+	a = linspace(.5, .9, 511)';
+	y = sosfilters([1 zeros(1,9)], [ones(511,1) zeros(511,2) -a zeros(511,1)]);
+	max(max(abs(y - repmat(a, 1, 10).^repmat(0:9, 511, 1))))
 end
 
 if strcmp(test,'spectrogram') | strcmp(test,'all')
@@ -13,13 +13,9 @@ echo on;
 
 %Make sptcorrmex.dll
 
-%Making object file for the miscellaneous functions.
-mex -c miscfnc.c;
-
-%Making object file for the vector functions.
-mex -c vectorfnc.c;
-
-%Making mex file for sptcorrmex utility.
-mex sptcorrmex.c vectorfnc.obj miscfnc.obj;
+%Making mex file for sptcorrmex utility. The vector and spiketrain functions
+%are in the header mexutils.h, which is shared with the HHmodel and SNModel
+%MEX files and sptdist.
+mex sptcorrmex.c;
 
 echo off
\ No newline at end of file
@@ -1,4 +1,4 @@
-#include "vectorfnc.h"
+#include "mexutils.h"
 
 /******************************************************************************
  *  H = SPTCORRMEX(SPT1, SPT2, MAXLAG, BINWIDTH), where SPT1 and SPT2 are     *
@@ -11,12 +11,31 @@
  *  The convention of time order matches that of XCORR: if t1 and t2 are      *
  *  spike times from SPT1 and SPT2, respectively, then t1>t2 will count as    *
  *  a positive interval.                                                      *
- *                                                                            *
+ *                                                                            *  
  *  [H, BC] = SPTCORRMEX(...) also returns the position of the bin centers    *
  *  in H.                                                                     *
+ *                                                                            *  
+ *  If SPT1 and SPT2 are cell arrays, their elements are the repetitions of   *
+ *  a recording and the histogram is that of the merged repetitions (XAC).    *
+ *  H = SPTCORRMEX(SPT, 'nodiag', MAXLAG, BINWIDTH), where SPT is a cell      *
+ *  array, returns the shuffled autocorrelogram (SAC): only spike pairs from  *
+ *  different repetitions are counted. The repetitions are merged into one    *
+ *  sorted train, labelled by repetition, and the window around each spike is *
+ *  swept once, so all the pairs of repetitions are done in one call.         *
+ *  Spiketimes on a grid of 1 us (in ms), as from SGSR, are sorted as integer *
+ *  counts of the time base.                                                  *
+ *                                                                            *  
+ *  [H, BC, NORM] = SPTCORRMEX(SPT1, SPT2, MAXLAG, BINWIDTH, DUR), with cell  *
+ *  arrays, divides H by NORM, the 'DriesNorm' normalization of SPTCORR, for  *
+ *  an analysis window of duration DUR.                                       *
  ******************************************************************************/
 
-vector* getSpkIn(mxArray* args[], long n);
+SpikeTrain* getSpkIn(mxArray* args[], long n);
+SpikeTrain* getTrialsIn(const mxArray* a, long* nTrials);
+void countPairs(SpikeTrain spk1, SpikeTrain spk2, long n, double binWidth,
+                double maxLag, double* nIntervals);
+void countShuffledPairs(SpikeTrain spk, long n, double binWidth,
+                        double maxLag, double* nIntervals);
 
 /******************************************************************************
  *                               MEX Interface                                *
@@ -24,19 +43,20 @@ vector* getSpkIn(mxArray* args[], long n);
 void mexFunction(int nlhs,       mxArray *plhs[], 
                  int nrhs, const mxArray *prhs[])
 {
-    vector *spkIn;
+    SpikeTrain *spkIn;
     double maxLag;
     double binWidth;
-    vector binCenters = {0, 0, NULL};
-    vector nIntervals;
+    Vector binCenters = {0, 0, NULL};
+    Vector nIntervals;
     long n;
     long i;
-    long j;
-    long indexOfLastSmaller;
-    double effMaxLag;
-    
+    int isTrials;
+    int isShuffled;
+
     //Check input arguments and retrieve spike times and parameters.
-    if (nrhs != 4){
+    isTrials = (nrhs >= 2) && mxIsCell(prhs[0]);
+    isShuffled = isTrials && mxIsChar(prhs[1]);
+    if ((nrhs != 4) && !(isTrials && (nrhs == 5))){
         mexErrMsgTxt("Wrong number of input arguments.");
     }
     if (!mxIsNumeric(prhs[2]) || (mxGetNumberOfElements(prhs[2]) != 1) || 
@@ -49,85 +69,138 @@ void mexFunction(int nlhs,       mxArray *plhs[],
     {
         mexErrMsgTxt("Binwidth must be positive scalar.");
     }
-    spkIn = getSpkIn(prhs, 2);
-    
+
     //Creating bincenters.
     n = floor(maxLag/binWidth);
+    VectorReserve(&binCenters, 2*n+1);
     for (i = 0; i <= 2*n; i++){ // 2*n because we go from -maxLag to maxLag
-        vectorAddScalar(&binCenters, (-n+i)*binWidth);
+        VectorAddScalar(&binCenters, (-n+i)*binWidth);
     }
-    nIntervals = vectorScalarInit(2*n+1, 0.0);
-    
-    //When one of the input spiketrains is empty, we don't have to search for coincidences
-    if ((spkIn[0].n != 0) && (spkIn[1].n != 0)){
-        //Sorting both input spiketrains.
+    nIntervals = VectorScalarInit(2*n+1, 0.0);
+
+    if (isTrials){
+        SpikeTrain *trials[2];
+        long nTrials[2];
+        double norm = 1.0;
+
+        //Repetitions are given as cell arrays of spiketrains, the second argument
+        //is either a cell array too or the string 'nodiag'.
+        if (isShuffled){
+            char option[7];
+            if ((mxGetString(prhs[1], option, sizeof(option)) != 0) ||
+                (strcmp(option, "nodiag") != 0))
+            {
+                mexErrMsgTxt("If SPT1 is a cell array, SPT2 must be either a cell array or the string 'nodiag'.");
+            }
+        }
+        else if (!mxIsCell(prhs[1])){
+            mexErrMsgTxt("If SPT1 is a cell array, SPT2 must be either a cell array or the string 'nodiag'.");
+        }
+
+        //Merging the repetitions of each set into one sorted spiketrain, in which
+        //the label of each spike is its repetition.
+        spkIn = (SpikeTrain*)mxMalloc(2*sizeof(SpikeTrain));
+        trials[0] = getTrialsIn(prhs[0], nTrials);
+        spkIn[0] = SpikeTrainMerge(trials[0], nTrials[0]);
+        if (isShuffled){
+            spkIn[1] = SpikeTrainInit(0, NULL, 0.0);
+            trials[1] = NULL;
+            nTrials[1] = nTrials[0];
+            countShuffledPairs(spkIn[0], n, binWidth, maxLag, nIntervals.data);
+        }
+        else{
+            trials[1] = getTrialsIn(prhs[1], nTrials+1);
+            spkIn[1] = SpikeTrainMerge(trials[1], nTrials[1]);
+            countPairs(spkIn[0], spkIn[1], n, binWidth, maxLag, nIntervals.data);
+        }
         for (i = 0; i < 2; i++){
-            vectorSort(spkIn+i, NULL);
+            long j;
+            for (j = 0; (trials[i] != NULL) && (j < nTrials[i]); j++){
+                SpikeTrainFree(trials[i]+j);
+            }
+            mxFree(trials[i]);
         }
-    
-        //Counting coincidences: bins are centered around zero delay. A spiketime
-        //interval that falls on an edge between two bins is counted as a coincidence
-        //for the right adjacent bin.
-        effMaxLag = maxLag+binWidth/2;
-        indexOfLastSmaller = 0L;
-        for (i = 0; i < spkIn[0].n; i++){ //Go through all the spikes in spkIn[0]
-            double spk = spkIn[0].data[i];
-            double interval;
-            
-            //indexOfLastSmaller is the index of the last element in spkIn[1] that's < spk
-            //We preserve the previous value and search further from there
-            indexOfLastSmaller += binSearch(spkIn[1].data+indexOfLastSmaller,
-                    spkIn[1].n-indexOfLastSmaller, spk) - 1;
-
-            //Run through spkIn[1] once up and once down, starting at indexOfLastSmaller,
-            //and check whether the spikes coincide
-            j = indexOfLastSmaller;
-            while ((++j < spkIn[1].n) && ((interval = spkIn[1].data[j]-spk) <= effMaxLag)){
-                nIntervals.data[(long)(n-(interval/binWidth)+0.5)]++;
+
+        //Normalization of the coincidence counts as 'DriesNorm' in SPTCORR, i.e. by
+        //the number of pairs of repetitions times the product of the mean rates of
+        //both sets, times the duration of the analysis window and the binwidth.
+        if (nrhs == 5){
+            double dur;
+            double rate1;
+            double rate2;
+            double nf;
+
+            if (!mxIsNumeric(prhs[4]) || (mxGetNumberOfElements(prhs[4]) != 1) ||
+                ((dur = mxGetScalar(prhs[4])) <= 0))
+            {
+                mexErrMsgTxt("Duration must be positive scalar.");
             }
-            j = indexOfLastSmaller;
-            while ((j >= 0) && ((interval = spk-spkIn[1].data[j--]) < effMaxLag)){
-                nIntervals.data[(long)(n+(interval/binWidth)+0.5)]++;
+            //Innocent 1e-10 to prevent divide by zero, as in SPTCORR.
+            rate1 = (1e-10+spkIn[0].n)/dur/nTrials[0];
+            rate2 = (1e-10+(isShuffled ? spkIn[0].n : spkIn[1].n))/dur/nTrials[1];
+            if (isShuffled){
+                nf = dur*(nTrials[0]*(nTrials[0]-1.0));
+            }
+            else{
+                nf = dur*nTrials[0]*(double)nTrials[1];
+            }
+            norm = nf*rate1*rate2*binWidth;
+            for (i = 0; i <= 2*n; i++){
+                nIntervals.data[i] /= norm;
             }
         }
+        if (nlhs > 2){
+            plhs[2] = mxCreateDoubleScalar(norm);
+        }
     }
-    
+    else{
+        spkIn = getSpkIn(prhs, 2);
+
+        //When one of the input spiketrains is empty, we don't have to search for coincidences
+        if ((spkIn[0].n != 0) && (spkIn[1].n != 0)){
+            //Sorting both input spiketrains, unless they are sorted already.
+            for (i = 0; i < 2; i++){
+                SpikeTrainSort(spkIn+i);
+            }
+            countPairs(spkIn[0], spkIn[1], n, binWidth, maxLag, nIntervals.data);
+        }
+    }
+
     //Create output arguments.
-    nlhs = 2;
-    plhs[0] = vector2mxArray(nIntervals);
-    plhs[1] = vector2mxArray(binCenters);
-    
+    plhs[0] = Vector2mxArray(nIntervals);
+    plhs[1] = Vector2mxArray(binCenters);
+
     //Free dynamic memory.
     for (i = 0; i < 2; i++){
-        vectorFree(spkIn+i);
+        SpikeTrainFree(spkIn+i);
     }
     mxFree(spkIn);
-    vectorFree(&binCenters);
-    vectorFree(&nIntervals);
+    VectorFree(&binCenters);
+    VectorFree(&nIntervals);
 }
 
 /******************************************************************************
  *                               Local Functions                              *
  ******************************************************************************/
-vector* getSpkIn(mxArray* args[], long n)
+SpikeTrain* getSpkIn(mxArray* args[], long n)
 {
-    vector* spkIn;
+    SpikeTrain* spkIn;
     long i;
     
-    spkIn = (vector*)mxMalloc(n*sizeof(vector));
+    spkIn = (SpikeTrain*)mxMalloc(n*sizeof(SpikeTrain));
     for (i = 0; i < n; i++){
         if (mxIsEmpty(args[i])){
-            spkIn[i] = vectorPtrInit(0, NULL);
+            spkIn[i] = SpikeTrainInit(0, NULL, SPIKETRAIN_TICK);
         }
         else if (mxIsNumeric(args[i]) && (mxGetM(args[i]) == 1) || 
            (mxGetN(args[i]) == 1))
         {
-            spkIn[i] = mxArray2Vector(args[i]);
+            spkIn[i] = mxArray2SpikeTrain(args[i], SPIKETRAIN_TICK);
         }
         else{
             long j;
             for (j = 0; j < i; j++){
-                vectorFree(spkIn+j);
+                SpikeTrainFree(spkIn+j);
             }
             mxFree(spkIn);
             mexErrMsgTxt("Spiketrains must be given as numerical vectors.");
@@ -136,3 +209,146 @@ vector* getSpkIn(mxArray* args[], long n)
     return spkIn;
 }
 
+/**
+ * Retrieve the repetitions from a cell array of spiketrains.
+ *
+ * @param a
+ *      An mxArray object that represents a MATLAB cell array, every cell
+ *      containing the spiketimes of one repetition as a numerical vector.
+ * @param nTrials
+ *      A pointer to a long integer.
+ * @return An array of spiketrains, one for every cell. The number of
+ *      repetitions is stored in nTrials.
+ */
+SpikeTrain* getTrialsIn(const mxArray* a, long* nTrials)
+{
+    SpikeTrain* trials;
+    long i;
+
+    *nTrials = mxGetNumberOfElements(a);
+    if (*nTrials == 0){
+        mexErrMsgTxt("At least one repetition must be given.");
+    }
+    trials = (SpikeTrain*)mxMalloc(*nTrials*sizeof(SpikeTrain));
+    for (i = 0; i < *nTrials; i++){
+        mxArray* c = mxGetCell(a, i);
+
+        if ((c == NULL) || mxIsEmpty(c)){
+            trials[i] = SpikeTrainInit(0, NULL, SPIKETRAIN_TICK);
+        }
+        else if (mxIsNumeric(c) && ((mxGetM(c) == 1) || (mxGetN(c) == 1))){
+            trials[i] = mxArray2SpikeTrain(c, SPIKETRAIN_TICK);
+        }
+        else{
+            mexErrMsgTxt("Spiketrains must be given as numerical vectors.");
+        }
+    }
+    return trials;
+}
+
+/**
+ * Count the coincidences between two spiketrains.
+ *
+ * @param spk1
+ *      The first spiketrain, sorted in ascending order.
+ * @param spk2
+ *      The second spiketrain, sorted in ascending order.
+ * @param n
+ *      The number of bins on each side of the middle bin.
+ * @param binWidth
+ *      The binwidth of the histogram.
+ * @param maxLag
+ *      The maximum lag of the histogram.
+ * @param nIntervals
+ *      An array of 2*n+1 doubles.
+ * @post For every pair of spikes the interval is counted in the bin of
+ *      nIntervals that it falls in. Bins are centered around zero delay. A
+ *      spiketime interval that falls on an edge between two bins is counted
+ *      as a coincidence for the right adjacent bin.
+ */
+void countPairs(SpikeTrain spk1, SpikeTrain spk2, long n, double binWidth,
+                double maxLag, double* nIntervals)
+{
+    double effMaxLag = maxLag+binWidth/2;
+    long first = 0;
+    long i;
+    long j;
+    long k;
+
+    for (i = 0; i < spk1.n; i++){ //Go through all the spikes in spk1
+        double spk = spk1.t[i];
+        double interval;
+
+        //first is the index of the first element in spk2 that is within the
+        //window of spk, and only moves on because both trains are sorted.
+        while ((first < spk2.n) && (spk-spk2.t[first] >= effMaxLag)){
+            first++;
+        }
+        for (j = first; j < spk2.n; j++){
+            if (spk2.t[j] > spk){
+                if ((interval = spk2.t[j]-spk) > effMaxLag){
+                    break;
+                }
+                k = (long)(n-(interval/binWidth)+0.5);
+            }
+            else{
+                interval = spk-spk2.t[j];
+                k = (long)(n+(interval/binWidth)+0.5);
+            }
+            if (k <= 2*n){
+                nIntervals[k]++;
+            }
+        }
+    }
+}
+
+/**
+ * Count the coincidences between the spikes of different repetitions.
+ *
+ * @param spk
+ *      The spiketrain of all the repetitions merged, sorted in ascending order,
+ *      with the repetition of each spike as its label.
+ * @param n
+ *      The number of bins on each side of the middle bin.
+ * @param binWidth
+ *      The binwidth of the histogram.
+ * @param maxLag
+ *      The maximum lag of the histogram.
+ * @param nIntervals
+ *      An array of 2*n+1 doubles.
+ * @post Every pair of spikes from different repetitions is counted in
+ *      nIntervals as by countPairs() called with the spiketrain as both
+ *      arguments; pairs from the same repetition are left out. The window
+ *      after each spike is swept once and each pair is counted in both
+ *      orders.
+ */
+void countShuffledPairs(SpikeTrain spk, long n, double binWidth,
+                        double maxLag, double* nIntervals)
+{
+    double effMaxLag = maxLag+binWidth/2;
+    long i;
+    long j;
+    long k;
+
+    for (i = 0; i < spk.n; i++){
+        double interval;
+
+        for (j = i+1; (j < spk.n) && ((interval = spk.t[j]-spk.t[i]) <= effMaxLag); j++){
+            double lag;
+
+            if (spk.label[j] == spk.label[i]){
+                continue;
+            }
+            lag = interval/binWidth;
+            //Spike j before spike i, only counted within the open window ...
+            if (interval < effMaxLag){
+                k = (long)(n+lag+0.5);
+                if (k <= 2*n){
+                    nIntervals[k]++;
+                }
+            }
+            //... and spike i before spike j.
+            nIntervals[(long)(n-lag+0.5)]++;
+        }
+    }
+}
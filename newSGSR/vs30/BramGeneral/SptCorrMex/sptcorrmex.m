@@ -3,5 +3,12 @@
 %    This function is not intended for direct use, but is called by SPTCORR.
 %
 %    For details, see SPTCORR.
+%
+%    H = SPTCORRMEX(SPT, 'nodiag', MAXLAG, BINWIDTH), where SPT is a cell
+%    array of repetitions, returns the shuffled autocorrelogram in a single
+%    sweep of the merged repetitions; with cell arrays SPT1 and SPT2 it
+%    returns the cross-correlogram of the merged repetitions.
+%    [H, BC, NORM] = SPTCORRMEX(..., DUR) divides H by the 'DriesNorm'
+%    normalization of SPTCORR, which is returned in NORM.
 
 % Empty help file, shadowed by binary MEX file.
\ No newline at end of file
@@ -60,6 +60,76 @@ vector vectorScalarInit(long n, double scalar)
     return v;
 }
 
+/**
+ * Create a new empty vector whose values are stored in memory from an arena.
+ *
+ * @param a
+ *      A pointer to an arena.
+ * @param n
+ *      The number of values for which memory is allocated beforehand.
+ * @return An empty vector with memory for n values. The memory of the vector
+ *      is released with the arena, vectorFree() only resets the vector.
+ */
+vector vectorInArena(vectorArena* a, long n)
+{
+    vector v = {0, 0, NULL, NULL};
+
+    if (n < 0){
+        mexErrMsgTxt("vectorInArena: Dimension of a vector cannot be negative.");
+    }
+    v.arena = a;
+    vectorReserve(&v, n);
+    return v;
+}
+
+/**
+ * Make room for a number of values in a vector, e.g. when the final dimension
+ * of the vector is known or can be estimated beforehand.
+ *
+ * @param v
+ *      A pointer to an initialized vector.
+ * @param n
+ *      The number of values for which memory is needed.
+ * @post The vector has memory for at least n values, its dimension and values
+ *      are unchanged. A vector in an arena gets its memory from that arena.
+ */
+void vectorReserve(vector* v, long n)
+{
+    double* data;
+
+    if (n <= v->alloc_n){
+        return;
+    }
+    if (v->arena != NULL){
+        arenaChunk* c = v->arena->top;
+        size_t extra = (n-v->alloc_n)*sizeof(double);
+
+        //The vector allocated last from the arena grows in place if the chunk has room.
+        if ((c != NULL) && (v->data != NULL) && (v->data+v->alloc_n == (double*)((char*)c->data+c->used)) &&
+            (c->size-c->used >= extra))
+        {
+            c->used += extra;
+            v->alloc_n = n;
+            return;
+        }
+        data = (double*)vectorArenaAlloc(v->arena, n*sizeof(double));
+        if (v->n > 0){
+            memcpy(data, v->data, v->n*sizeof(double));
+        }
+    }
+    else if (v->data == NULL){
+        data = (double*)mxMalloc(n*sizeof(double));
+    }
+    else{
+        data = (double*)mxRealloc(v->data, n*sizeof(double));
+    }
+    if (data == NULL){
+        mexErrMsgTxt("vectorReserve: Cannot allocate enough memory.");
+    }
+    v->data = data;
+    v->alloc_n = n;
+}
+
 /**
  * Reset a vector to the empty vector and release the dynamic memory allocated for
  * it.
@@ -67,13 +137,15 @@ vector vectorScalarInit(long n, double scalar)
  * @param v
  *      A pointer to the vector that needs to be destroyed.
  * @post The dynamic memory allocted to the supplied vector for storing its values
- *      is released. The vector is the empty vector.
+ *      is released, unless it belongs to an arena. The vector is the empty vector.
  */
 void vectorFree(vector *v)
 {
     v->n = 0;
     v->alloc_n = 0;
-    mxFree(v->data);
+    if (v->arena == NULL){
+        mxFree(v->data);
+    }
     v->data = NULL;
 }
 
@@ -108,18 +180,13 @@ void vectorDisplay(vector v)
  * @param scalar
  *      The scalar value that needs to be added to the supplied vector.
  * @post The dimension of the supplied vector is augmented by one and the value
- *      associated with this extra dimension is set to the supplied value.
+ *      associated with this extra dimension is set to the supplied value. The
+ *      memory of the vector grows geometrically.
  */
 void vectorAddScalar(vector* v, double scalar)
 {
-    if (v->alloc_n == 0){
-        v->data = (double*)mxMalloc((v->alloc_n = ALLOC_BLOCKLENGTH)*sizeof(double));
-    }
-    else if (v->n == v->alloc_n){
-        v->data = mxRealloc(v->data, (v->alloc_n += ALLOC_BLOCKLENGTH)*sizeof(double));
-        if (v->data == NULL){
-            mexErrMsgTxt("vectorAddScalar: Cannot allocate enough memory.");
-        }
+    if (v->n == v->alloc_n){
+        vectorReserve(v, (v->alloc_n < ALLOC_BLOCKLENGTH) ? ALLOC_BLOCKLENGTH : 2*v->alloc_n);
     }
     else if (v->n > v->alloc_n){
         mexErrMsgTxt("vectorAddScalar: More number of elements in vector than allowed by memory allocation.");
@@ -141,24 +208,15 @@ void vectorAddScalar(vector* v, double scalar)
  */
 void vectorConcatenate(vector* v1, const vector v2)
 {
-    long orig_n = v1->n, nbytes;
+    long orig_n = v1->n;
     
     if (v2.n == 0){
         return; //Adding the empty vector is trivial.
     }
-    if ((v1->n += v2.n) > v1->alloc_n){
-        v1->alloc_n = ((v1->n-1)/ALLOC_BLOCKLENGTH+1)*ALLOC_BLOCKLENGTH;
-        nbytes = v1->alloc_n*sizeof(double);
-        if (v1->data == NULL){
-            v1->data = mxMalloc(nbytes);
-        }
-        else{
-            v1->data = mxRealloc(v1->data, nbytes);
-            if (v1->data == NULL){
-                mexErrMsgTxt("vectorConcatenate: Cannot allocate enough memory.");
-            }
-        }
+    if (v1->n+v2.n > v1->alloc_n){
+        vectorReserve(v1, (v1->n+v2.n > 2*v1->alloc_n) ? v1->n+v2.n : 2*v1->alloc_n);
     }
+    v1->n += v2.n;
     memcpy(v1->data+orig_n, v2.data, v2.n*sizeof(double));
 }
 
@@ -193,14 +251,22 @@ void vectorSort(vector *v, long* perm)
  */
 void vectorPermute(vector *v, long* perm)
 {
-    double* buffer = mxMalloc(v->alloc_n*sizeof(double));
+    double* buffer;
     long i;
     
+    if (v->arena != NULL){
+        buffer = (double*)vectorArenaAlloc(v->arena, v->alloc_n*sizeof(double));
+    }
+    else{
+        buffer = (double*)mxMalloc(v->alloc_n*sizeof(double));
+    }
     for (i = 0; i < v->n; i++){
         buffer[i] = v->data[perm[i]];
     }
     
-    mxFree(v->data);
+    if (v->arena == NULL){
+        mxFree(v->data);
+    }
     v->data = buffer;
 }
 
@@ -242,3 +308,62 @@ mxArray* vector2mxArray(vector v)
     return a;
 }
 
+/******************************************************************************
+ *                               Arena Functions                              *
+ ******************************************************************************/
+
+/**
+ * Allocate memory from an arena. An arena is a list of chunks of dynamic memory
+ * from which memory is allocated in turn, and which are released all at once.
+ * An empty arena is initialized as vectorArena a = {NULL}.
+ *
+ * @param a
+ *      A pointer to an arena.
+ * @param nbytes
+ *      The number of bytes needed.
+ * @return A pointer to nbytes of memory, aligned for doubles.
+ */
+void* vectorArenaAlloc(vectorArena* a, size_t nbytes)
+{
+    arenaChunk* c = a->top;
+    void* p;
+
+    nbytes = (nbytes+sizeof(double)-1)/sizeof(double)*sizeof(double);
+    if ((c == NULL) || (c->size-c->used < nbytes)){
+        //A new chunk is at least twice as large as the previous one.
+        size_t size = (c == NULL) ? ARENA_CHUNKLENGTH : 2*c->size;
+
+        if (size < nbytes){
+            size = nbytes;
+        }
+        c = (arenaChunk*)mxMalloc(sizeof(arenaChunk)+size);
+        if (c == NULL){
+            mexErrMsgTxt("vectorArenaAlloc: Cannot allocate enough memory.");
+        }
+        c->prev = a->top;
+        c->size = size;
+        c->used = 0;
+        a->top = c;
+    }
+    p = (char*)c->data+c->used;
+    c->used += nbytes;
+    return p;
+}
+
+/**
+ * Release all the memory allocated from an arena.
+ *
+ * @param a
+ *      A pointer to an arena.
+ * @post All chunks of the arena are released, vectors in the arena must not be
+ *      used anymore. The arena is empty and can be used again.
+ */
+void vectorArenaFree(vectorArena* a)
+{
+    while (a->top != NULL){
+        arenaChunk* c = a->top;
+        a->top = c->prev;
+        mxFree(c);
+    }
+}
+
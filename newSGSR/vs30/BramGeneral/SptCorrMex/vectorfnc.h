@@ -4,14 +4,44 @@
 #include "mex.h"
 
 /**
- * The number of 8-byte elements of dynamic memory that are allocated at a time,
+ * The number of 8-byte elements of dynamic memory that are allocated at first,
  * once the dimension of a vector exceeds the amount of dynamic memory allocated
- * for storing its actual values. Memory is allocated in 8-byte units, becuase
- * this is the amount of bytes needed to store a double-precision floating point
- * value.
+ * for storing its actual values. After that the amount of memory is doubled
+ * each time, so that adding n values to a vector takes O(n) time. Memory is
+ * allocated in 8-byte units, becuase this is the amount of bytes needed to
+ * store a double-precision floating point value.
  */
 #define ALLOC_BLOCKLENGTH   500
 
+/**
+ * The minimum number of bytes in a chunk of an arena.
+ */
+#define ARENA_CHUNKLENGTH   65536
+
+/******************************************************************************
+ *                            Arena Type Definition                           *
+ ******************************************************************************/
+
+/**
+ * A chunk of dynamic memory in an arena. It stores a pointer to the chunk that
+ * was allocated before it, the number of bytes of data in the chunk and the
+ * number of those that are in use, followed by the data itself.
+ */
+typedef struct arenaChunk{
+    struct arenaChunk* prev;
+    size_t size;
+    size_t used;
+    double data[1];
+} arenaChunk;
+
+/**
+ * An arena stores a pointer to the last chunk that was allocated, from which
+ * memory is allocated until it is full. All chunks are released at once.
+ */
+typedef struct{
+    arenaChunk* top;
+} vectorArena;
+
 /******************************************************************************
  *                            Vector Type Definition                          *
  ******************************************************************************/
@@ -23,12 +53,14 @@
  * of double values for which space is allocated in dynamic memory. At all times,
  * n must be less than or equal to alloc_n. In addition a vector type stores a
  * pointer to an array of doubles in dynamic memory that actually contains the 
- * values in the vector.
+ * values in the vector. The last member is the arena from which this memory
+ * is allocated, or NULL if it is allocated by mxMalloc.
  */
 typedef struct{
     long n;
     long alloc_n;
     double* data;
+    vectorArena* arena;
 } vector;
 
 /******************************************************************************
@@ -65,6 +97,31 @@ vector vectorPtrInit(long n, double* data);
  */
 vector vectorScalarInit(long n, double scalar);
 
+/**
+ * Create a new empty vector whose values are stored in memory from an arena.
+ *
+ * @param a
+ *      A pointer to an arena.
+ * @param n
+ *      The number of values for which memory is allocated beforehand.
+ * @return An empty vector with memory for n values. The memory of the vector
+ *      is released with the arena, vectorFree() only resets the vector.
+ */
+vector vectorInArena(vectorArena* a, long n);
+
+/**
+ * Make room for a number of values in a vector, e.g. when the final dimension
+ * of the vector is known or can be estimated beforehand.
+ *
+ * @param v
+ *      A pointer to an initialized vector.
+ * @param n
+ *      The number of values for which memory is needed.
+ * @post The vector has memory for at least n values, its dimension and values
+ *      are unchanged. A vector in an arena gets its memory from that arena.
+ */
+void vectorReserve(vector* v, long n);
+
 /**
  * Reset a vector to the empty vector and release the dynamic memory allocated for
  * it.
@@ -72,7 +129,7 @@ vector vectorScalarInit(long n, double scalar);
  * @param v
  *      A pointer to the vector that needs to be destroyed.
  * @post The dynamic memory allocted to the supplied vector for storing its values
- *      is released. The vector is the empty vector.
+ *      is released, unless it belongs to an arena. The vector is the empty vector.
  */
 void vectorFree(vector *v);
 
@@ -159,3 +216,30 @@ mxArray* vector2mxArray(vector v);
  * @return A vector with the same dimension and values as the supplied mxArray.
  */
 vector mxArray2Vector(mxArray* a);
+
+/******************************************************************************
+ *                               Arena Functions                              *
+ ******************************************************************************/
+
+/**
+ * Allocate memory from an arena. An arena is a list of chunks of dynamic memory
+ * from which memory is allocated in turn, and which are released all at once.
+ * An empty arena is initialized as vectorArena a = {NULL}.
+ *
+ * @param a
+ *      A pointer to an arena.
+ * @param nbytes
+ *      The number of bytes needed.
+ * @return A pointer to nbytes of memory, aligned for doubles.
+ */
+void* vectorArenaAlloc(vectorArena* a, size_t nbytes);
+
+/**
+ * Release all the memory allocated from an arena.
+ *
+ * @param a
+ *      A pointer to an arena.
+ * @post All chunks of the arena are released, vectors in the arena must not be
+ *      used anymore. The arena is empty and can be used again.
+ */
+void vectorArenaFree(vectorArena* a);
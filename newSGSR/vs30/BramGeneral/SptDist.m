@@ -6,6 +6,8 @@ function dist = SptDist(Spt1, Spt2, CostPerTime)
 %   spiketrains for which the distance metric needs to be calculated. The 
 %   cost per unit of time for shifting spiketrains must be given as a third
 %   argument. This can be a scalar or a column- or rowvector.
+%   All costs of a vector are calculated in a single pass over the
+%   spiketrains, which is much faster than calling SPTDIST for each cost.
 %
 %   Further information: DIMITRIY ARONOV "Fast Algorithm for the Metric-Space
 %   Analysis of Simultaneous Responses of Multiple Single Neurons.", JOURNAL
@@ -1,18 +1,23 @@
 #include <math.h>
+#include <stdlib.h>
 #include "mex.h"
+#include "SptCorrMex/mexutils.h"
 
-#define ALGORITHM_TABLE_OPTIM
+#define ALGORITHM_TABLE_BANDED
 #define MIN(a, b)   ((a<b)?a:b)
+#define MAX(a, b)   ((a>b)?a:b)
 
 int isNumericRowVector(mxArray*);
 int getSizeOfVector(mxArray*);
 double calculateSptDist(double*, int, double*, int, double);
+void calculateSptDists(double*, int, double*, int, double*, int, double*);
 
 void mexFunction(int nlhs,       mxArray *plhs[], 
                  int nrhs, const mxArray *prhs[])
 {
     double *shiftCosts, *distances;
-    int nCosts, i;
+    SpikeTrain Spt1, Spt2;
+    int nCosts;
 
     /*Checking input arguments: D = SPTDIST(SPT1, SPT2, COST) */
     if (nrhs != 3) mexErrMsgTxt("Wrong number of input arguments.");
@@ -24,12 +29,17 @@ void mexFunction(int nlhs,       mxArray *plhs[],
     if (nlhs > 1) mexErrMsgTxt("To many output arguments.");
     nlhs = 1; plhs[0] = mxCreateDoubleMatrix(mxGetM(prhs[2]), mxGetN(prhs[2]), mxREAL);
     
+    /*The spreadsheet needs the spiketimes in ascending order; spiketrains that
+    are sorted already are not sorted again*/
+    Spt1 = mxArray2SpikeTrain(prhs[0], SPIKETRAIN_TICK); SpikeTrainSort(&Spt1);
+    Spt2 = mxArray2SpikeTrain(prhs[1], SPIKETRAIN_TICK); SpikeTrainSort(&Spt2);
+
     /*Calculating the spike time metric using spreadsheet*/
     nCosts = getSizeOfVector(prhs[2]);
     shiftCosts = mxGetPr(prhs[2]); distances = mxGetPr(plhs[0]);
-    for (i = 0; i < nCosts; i++)
-        distances[i] = calculateSptDist(mxGetPr(prhs[0]), getSizeOfVector(prhs[0]), 
-            mxGetPr(prhs[1]), getSizeOfVector(prhs[1]), shiftCosts[i]);
+    calculateSptDists(Spt1.t, Spt1.n, Spt2.t, Spt2.n, shiftCosts, nCosts, distances);
+
+    SpikeTrainFree(&Spt1); SpikeTrainFree(&Spt2);
 }
 
 int isNumericRowVector(mxArray* Vector)
@@ -40,41 +50,138 @@ int isNumericRowVector(mxArray* Vector)
 
 int getSizeOfVector(mxArray* Vector) { return mxGetM(Vector)*mxGetN(Vector); }
 
-#ifdef ALGORITHM_TABLE_OPTIM
-double calculateSptDist(double* Spt1, int n1, double* Spt2, int n2, double cost) 
+#ifdef ALGORITHM_TABLE_BANDED
+/*The distance is n1+n2 minus the largest gain of a set of non-crossing matches, where
+matching two spikes gains 2-cost*|t1-t2| (a deletion and an insertion are replaced by a
+shift). So the spreadsheet H of gains only changes where the gain is positive, i.e. in a
+band |t1-t2| < 2/cost around the diagonal: left of the band a row is a copy of the row
+above it and right of the band every value equals the last one in the band. Because the
+spiketimes are sorted, the band of each row is found by two pointers that only move
+forward and a row costs O(band) instead of O(n2).
+Costs are sorted and grouped so that the band of the smallest cost in a group is at most
+twice that of the largest. All groups are traversed at the same time, the costs of a
+group are handled together in the same band: H of a group is stored interleaved, the
+values of all its costs for a spike of the second spiketrain are next to each other.*/
+
+#define SPTDIST_GROUPRATIO  2.0 /*Maximum ratio of the largest and smallest cost in a group*/
+
+typedef struct{
+    int     first, n;   /*Index of the first sorted cost of the group and number of costs*/
+    double  width;      /*Half width of the band, in units of time*/
+    int     lo, hi;     /*Band of the current row, spikes lo up to hi-1 of 2nd spiketrain*/
+    int     valid;      /*H is filled in up to this column, right of it H is H[valid]*/
+    double* H;          /*Spreadsheet row of the group, (n2+1) x n interleaved*/
+} SptDistGroup;
+
+static double* Workspace = NULL;    /*Reused across calls, grows when needed*/
+static size_t WorkspaceSize = 0;
+
+static void freeWorkspace(void)
 {
-    double** G;
-    double d1, d2, d3, dist;
-    int i, j;
+    mxFree(Workspace); Workspace = NULL; WorkspaceSize = 0;
+}
 
-    /*Trivial cases*/
-    if (n1 == 0) return (double)n2;
-    if (n2 == 0) return (double)n1;
+static double* getWorkspace(size_t n)
+{
+    if (n > WorkspaceSize) {
+        if (Workspace == NULL) mexAtExit(freeWorkspace);
+        else mxFree(Workspace);
+        Workspace = (double*)mxMalloc(n*sizeof(double));
+        mexMakeMemoryPersistent(Workspace);
+        WorkspaceSize = n;
+    }
+    return Workspace;
+}
 
-    /*Initialization*/
-    G = (double**)mxCalloc(2, sizeof(double*));
-    for (i = 0; i < 2; i++) G[i] = (double*)mxCalloc(n2+1, sizeof(double));
-    for (i = 0; i <= n2; i++) G[0][i] = (double)i;
-    
-    /*Calculate values of spreadsheet, but only keep two rows in memory*/
-    for (i = 1; i <= n1; i++) {
-        G[1][0] = (double)i;
-        for (j = 1; j <= n2; j++) {
-            d1 = G[0][j-1] + cost*fabs(Spt1[i-1]-Spt2[j-1]);
-            d2 = G[0][j] + 1.0;
-            d3 = G[1][j-1] + 1.0;
-            G[1][j] = MIN(d1 , MIN(d2, d3));
+static int compareCosts(const void* a, const void* b)
+{
+    double c1 = **(const double**)a, c2 = **(const double**)b;
+    return (c1 < c2) ? -1 : ((c1 > c2) ? 1 : 0);
+}
+
+void calculateSptDists(double* Spt1, int n1, double* Spt2, int n2, double* costs, int nCosts, double* dists)
+{
+    double **order, *C, *D, *w, *H, gain;
+    SptDistGroup* G;
+    size_t size;
+    int nSorted, nGroups, i, j, k, m;
+
+    /*Infinite and NaN costs never shift a spike, the distance is the number of spikes*/
+    order = (double**)mxMalloc((nCosts+1)*sizeof(double*));
+    for (k = 0, nSorted = 0; k < nCosts; k++) {
+        if (costs[k] < HUGE_VAL) order[nSorted++] = costs+k;
+        else dists[k] = (double)(n1+n2);
+    }
+    if ((nSorted == 0) || (n1 == 0) || (n2 == 0)) {
+        for (k = 0; k < nSorted; k++) dists[order[k]-costs] = (double)(n1+n2);
+        mxFree(order); return;
+    }
+    qsort(order, nSorted, sizeof(double*), compareCosts);
+
+    /*Grouping costs, costs that are not positive have an unlimited band*/
+    G = (SptDistGroup*)mxMalloc(nSorted*sizeof(SptDistGroup));
+    for (k = 0, nGroups = 0; k < nSorted; nGroups++) {
+        double c = *order[k];
+        G[nGroups].first = k;
+        if (c <= 0.0) while ((k < nSorted) && (*order[k] <= 0.0)) k++;
+        else while ((k < nSorted) && (*order[k] <= SPTDIST_GROUPRATIO*c)) k++;
+        G[nGroups].n = k-G[nGroups].first;
+        G[nGroups].width = (c <= 0.0) ? HUGE_VAL : 2.0/c;
+        G[nGroups].lo = G[nGroups].hi = G[nGroups].valid = 0;
+    }
+
+    /*Workspace holds the sorted costs, the gains, the row above and the spreadsheets*/
+    size = 3*(size_t)nSorted + (size_t)(n2+1)*nSorted;
+    C = getWorkspace(size); w = C+nSorted; D = w+nSorted; H = D+nSorted;
+    for (k = 0; k < nSorted; k++) C[k] = *order[k];
+    for (m = 0; m < nGroups; m++) {
+        G[m].H = H; H += (size_t)(n2+1)*G[m].n;
+        for (k = 0; k < G[m].n; k++) G[m].H[k] = 0.0;
+    }
+
+    /*One traversal of the first spiketrain for all groups*/
+    for (i = 0; i < n1; i++) {
+        double t = Spt1[i];
+        for (m = 0; m < nGroups; m++) {
+            SptDistGroup* g = G+m;
+            int n = g->n;
+            double *c = C+g->first, *Hj;
+
+            while ((g->lo < n2) && (Spt2[g->lo] <= t-g->width)) g->lo++;
+            while ((g->hi < n2) && (Spt2[g->hi] < t+g->width)) g->hi++;
+            if (g->lo >= g->hi) continue;
+            for (j = g->valid+1; j <= g->hi; j++) /*Extending H to the right end of the band*/
+                for (k = 0; k < n; k++) g->H[(size_t)j*n+k] = g->H[(size_t)g->valid*n+k];
+            if (g->hi > g->valid) g->valid = g->hi;
+
+            /*H[j] is a spike of the 2nd spiketrain matched to this one, a spike of the
+            2nd spiketrain left unmatched, or this spike left unmatched*/
+            for (k = 0; k < n; k++) D[k] = g->H[(size_t)g->lo*n+k];
+            for (j = g->lo; j < g->hi; j++) {
+                double dt = fabs(t-Spt2[j]);
+                Hj = g->H+(size_t)(j+1)*n;
+                for (k = 0; k < n; k++) {
+                    w[k] = 2.0-c[k]*dt; w[k] = MAX(w[k], 0.0);
+                    gain = MAX(Hj[k], Hj[k-n]);
+                    w[k] += D[k]; D[k] = Hj[k];
+                    Hj[k] = MAX(gain, w[k]);
+                }
+            }
         }
-        G[0] = (double *)((int)(G[0])-(int)(G[1])); //Swapping pointer without
-        G[1] = (double *)((int)(G[0])+(int)(G[1])); //using an intermediate variable
-        G[0] = (double *)((int)(G[1])-(int)(G[0]));
     }
-    dist = G[0][n2];
-    
-    /*Free dynamic memory*/
-    for(i = 0; i < 2; i++) mxFree(G[i]); mxFree(G);
-    
-    return dist;
+    for (m = 0; m < nGroups; m++)
+        for (k = 0; k < G[m].n; k++)
+            dists[order[G[m].first+k]-costs] = (double)(n1+n2)-G[m].H[(size_t)G[m].valid*G[m].n+k];
+
+    mxFree(G); mxFree(order);
+}
+
+#undef SPTDIST_GROUPRATIO
+#else
+void calculateSptDists(double* Spt1, int n1, double* Spt2, int n2, double* costs, int nCosts, double* dists)
+{
+    int i;
+    for (i = 0; i < nCosts; i++) dists[i] = calculateSptDist(Spt1, n1, Spt2, n2, costs[i]);
 }
 #endif
 
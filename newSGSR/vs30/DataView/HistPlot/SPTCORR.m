@@ -58,8 +58,14 @@ NC2 = struct;
 % only executed when spt1 and/or spt2 is a cell array
 if iscell(spt1) && iscell(spt2)
    % grand correlogram: merge all spikes of each set
-   [x, BC, NC, x2, BC2, NC2] = SPTCORR([spt1{:}], [spt2{:}], maxlag, ...
-       binwidth, dur, '', isMashed);
+   if isMashed
+       [x, BC, NC, x2, BC2, NC2] = SPTCORR([spt1{:}], [spt2{:}], maxlag, ...
+           binwidth, dur, '', isMashed);
+   else % sptcorrmex merges the repetitions itself
+       [x, BC] = sptcorrmex(spt1, spt2, maxlag, binwidth);
+       NC.Nspike1 = sum(cellfun('length', spt1));
+       NC.Nspike2 = sum(cellfun('length', spt2));
+   end
    Nrep1 = length(spt1);
    Nrep2 = length(spt2);
    % evaluate normalization and apply if requested
@@ -81,18 +87,22 @@ elseif iscell(spt1)
            'array or the string "nodiag".' ]);
    end
    % non-diagonal autocorr; apply no normalization yet
-   [x, BC, NC, x2, BC2, NC2] = SPTCORR([spt1{:}], [spt1{:}], maxlag, ...
-       binwidth, dur, '', isMashed);
-   Nrep1 = length(spt1);
-   Nrep2 = nan;
-   for irep=1:length(spt1) % subtract diagonal terms
-      [xd, dummy, dummy, x2d] = SPTCORR(spt1{irep}, spt1{irep}, maxlag, ...
-          binwidth, dur, '', isMashed);
-      x = x - xd;
-      if isMashed
+   if isMashed
+       [x, BC, NC, x2, BC2, NC2] = SPTCORR([spt1{:}], [spt1{:}], maxlag, ...
+           binwidth, dur, '', isMashed);
+       for irep=1:length(spt1) % subtract diagonal terms
+          [xd, dummy, dummy, x2d] = SPTCORR(spt1{irep}, spt1{irep}, maxlag, ...
+              binwidth, dur, '', isMashed);
+          x = x - xd;
           x2 = x2 - x2d;
-      end
+       end
+   else % sptcorrmex skips the diagonal terms in a single sweep
+       [x, BC] = sptcorrmex(spt1, 'nodiag', maxlag, binwidth);
+       NC.Nspike1 = sum(cellfun('length', spt1));
+       NC.Nspike2 = NC.Nspike1;
    end
+   Nrep1 = length(spt1);
+   Nrep2 = nan;
    % evaluate normalization and apply if requested
    NC = localNormCoeff(NC.Nspike1, NC.Nspike2, binwidth, dur, Nrep1, Nrep2);
    x = localApplyNorm(x, NC, normStr);
@@ -71,7 +71,7 @@ estimation of the first stepsize.*/
 /*------------------------------------MEX---------------------------------------*/
 double*  GetRowVectorField(mxArray *S, char* FieldName, long N);
 double   GetScalarField(mxArray *S, char* FieldName);
-Vector*  GetSpkIn(mxArray* Args[], long N);
+SpikeTrain* GetSpkIn(mxArray* Args[], long N);
 
 /*---------------------------------HHModel---------------------------------------*/
 typedef struct{
@@ -100,19 +100,19 @@ typedef struct{
 } MdlData;
 
 double CorrectT(double cf, double T);
-MdlData MdlDataInit(MdlParam P, Vector* SpkIn);
+MdlData MdlDataInit(MdlParam P, SpikeTrain* SpkIn);
 void MdlDataFree(MdlData D);
 
 Vector V2Spk(double Th, Vector t, Vector Vmem);
 
 void HHODE(double t, double* f, double* dfdt, void* varargs);
-void HHModel(MdlParam P, Vector* SpkIn, Vector* SpkOut, Vector* t, Vector* V);
+void HHModel(MdlParam P, SpikeTrain* SpkIn, Vector* SpkOut, Vector* t, Vector* V);
                
 /*----------------------------MEX Interface--------------------------------------*/
 void mexFunction(int nlhs,       mxArray* plhs[],
                  int nrhs, const mxArray* prhs[])
 {
-    MdlParam P; Vector* SpkIn; 
+    MdlParam P; SpikeTrain* SpkIn; 
     Vector SpkOut = {0, 0, NULL}; Vector t = {0, 0, NULL}; Vector V = {0, 0, NULL};
     long i;
 
@@ -140,7 +140,7 @@ void mexFunction(int nlhs,       mxArray* plhs[],
         plhs[0] = Vector2mxArray(SpkOut); plhs[1] = Vector2mxArray(t); plhs[2] = Vector2mxArray(V);
     
         /*Free dynamic memory*/
-        for (i = 0; i < P.Ne; i++) VectorFree(SpkIn+i); mxFree(SpkIn);
+        for (i = 0; i < P.Ne; i++) SpikeTrainFree(SpkIn+i); mxFree(SpkIn);
         VectorFree(&SpkOut); VectorFree(&t); VectorFree(&V);
     }    
 }
@@ -328,18 +328,18 @@ double GetScalarField(mxArray *S, char* FieldName)
     else return mxGetScalar(FieldValue);
 }
 
-Vector* GetSpkIn(mxArray* Args[], long N)
+SpikeTrain* GetSpkIn(mxArray* Args[], long N)
 {
-    Vector* SpkIn; long i, j;
+    SpikeTrain* SpkIn; long i, j;
     
-    SpkIn = (Vector*)mxMalloc(N*sizeof(Vector));
+    SpkIn = (SpikeTrain*)mxMalloc(N*sizeof(SpikeTrain));
     for (i = 0; i < N; i++)
     {
-        if (mxIsEmpty(Args[i])) SpkIn[i] = VectorPtrInit(0, NULL);
-        else if (mxIsNumeric(Args[i]) && (mxGetM(Args[i]) == 1)) SpkIn[i] = VectorPtrInit(mxGetN(Args[i]), mxGetPr(Args[i])); 
+        if (mxIsEmpty(Args[i])) SpkIn[i] = SpikeTrainInit(0, NULL, SPIKETRAIN_TICK);
+        else if (mxIsNumeric(Args[i]) && (mxGetM(Args[i]) == 1)) SpkIn[i] = SpikeTrainInit(mxGetN(Args[i]), mxGetPr(Args[i]), SPIKETRAIN_TICK); 
         else
         {
-            for (j = 0; j < i; j++) VectorFree(SpkIn+j); mxFree(SpkIn);
+            for (j = 0; j < i; j++) SpikeTrainFree(SpkIn+j); mxFree(SpkIn);
             mexErrMsgTxt("Spiketrains must be given as numerical rowvectors.");
         }
     }
@@ -374,12 +374,12 @@ double CorrectT(double cf, double T)
     return pow(cf, (T-22.0)/10.0);
 }
 
-MdlData MdlDataInit(MdlParam P, Vector* SpkIn)
+MdlData MdlDataInit(MdlParam P, SpikeTrain* SpkIn)
 {
     MdlData D;
     double* A;
-    Vector SpkTmp = {0, 0, NULL};
-    long i, n;
+    SpikeTrain SpkTmp;
+    long i;
     
     /*Save model parameters*/
     D.De = P.De; D.Cs = P.Cs; D.Ep = P.Ep; D.Es = P.Es; D.El = P.El; D.Ee = P.Ee;
@@ -387,24 +387,18 @@ MdlData MdlDataInit(MdlParam P, Vector* SpkIn)
     /*Temperature correction factors*/
     D.Tc2 = CorrectT(2, P.Tc); D.Tc2_5 = CorrectT(2.5, P.Tc); D.Tc3 = CorrectT(3, P.Tc); D.Tc10 = CorrectT(10, P.Tc);
     
-    /*Concatenating all input spiketrains*/
-    for (i = 0; i < P.Ne; i++) VectorConcatenate(&SpkTmp, SpkIn[i]);
-    D.Nspk = SpkTmp.n; D.Spks = SpkTmp.data;
+    /*Merging all input spiketrains, the label of a spike is the input it came from*/
+    SpkTmp = SpikeTrainMerge(SpkIn, P.Ne);
+    D.Nspk = SpkTmp.n; D.Spks = SpkTmp.t;
     
     /*Creating array with associated amplitudes*/
     A = (double*)mxMalloc(D.Nspk*sizeof(double));
-    for (i = n = 0; i < P.Ne; n += SpkIn[i].n, i++)
-    { 
-        long j;
-        for (j = 0; j < SpkIn[i].n; j++) A[n+j] = P.Ae[i];
-    }
-    
-    /*Sorting concatenated spikes and their associated amplitudes*/
-    QuickSort(D.Spks, 0, D.Nspk-1, A);
+    for (i = 0; i < D.Nspk; i++) A[i] = P.Ae[SpkTmp.label[i]];
+    mxFree(SpkTmp.label);
     
     /*Calculating excitatory conductancy for spiketimes*/
     D.Gspk = (double*)mxMalloc(D.Nspk*sizeof(double));
-    D.Gspk[0] = A[0]; for (i = 1; i < D.Nspk; i++) D.Gspk[i] = D.Gspk[i-1]*exp((SpkTmp.data[i-1]-SpkTmp.data[i])/P.De)+A[i];
+    D.Gspk[0] = A[0]; for (i = 1; i < D.Nspk; i++) D.Gspk[i] = D.Gspk[i-1]*exp((D.Spks[i-1]-D.Spks[i])/P.De)+A[i];
     
     mxFree(A);
     
@@ -482,11 +476,12 @@ Vector V2Spk(double Th, Vector t, Vector Vmem)
     return V;
 }
 
-void HHModel(MdlParam P, Vector* SpkIn, Vector* SpkOut, Vector* t, Vector* V)
+void HHModel(MdlParam P, SpikeTrain* SpkIn, Vector* SpkOut, Vector* t, Vector* V)
 {
     MdlData D;
     double f0[HHODE_NEQ], aw0, bw0, an0, bn0, am0, bm0, ah0, bh0;
-    Vector *y;
+    Vector y[HHODE_NEQ];
+    VectorArena A = {NULL};
     long i;
     
     /*Initialize model and start values*/
@@ -501,8 +496,9 @@ void HHModel(MdlParam P, Vector* SpkIn, Vector* SpkOut, Vector* t, Vector* V)
     f0[3] = ah0 / (ah0 + bh0);
     f0[4] = P.V0;
     
-    y = (Vector*)mxMalloc(HHODE_NEQ*sizeof(Vector));
-    for (i = 0; i < HHODE_NEQ; i++) y[i] = VectorScalarInit(0, 0.0);
+    /*The state variables are only needed until the ODE is solved, so they all
+      grow in one arena that is released at once*/
+    for (i = 0; i < HHODE_NEQ; i++) y[i] = VectorInArena(&A, 0);
     
     /*Solve ODE*/
     ODESolve(HHODE, HHODE_NEQ, f0, P.aw[0], P.aw[1], HHODE_EPS, HHODE_MINH, HHODE_MINH, t, y, &D);
@@ -512,7 +508,7 @@ void HHModel(MdlParam P, Vector* SpkIn, Vector* SpkOut, Vector* t, Vector* V)
     *SpkOut = V2Spk(P.Th, *t, *V);
     
     /*Free dynamic memory*/
-    MdlDataFree(D); for (i = 0; i < HHODE_NEQ; i++) VectorFree(y+i); mxFree(y);
+    MdlDataFree(D); VectorArenaFree(&A);
 }
 
 #undef CHANNEL_H_ALPHA
@@ -13,9 +13,20 @@ long Partition(double* Data, long i, long j, double* P);
 void QuickSort(double* Data, long i, long j, double* P);
 
 /*------------------Vector datatype and operation functions-------------------------*/
+typedef struct VectorChunk{
+    struct VectorChunk* prev;   /*Chunk allocated before this one*/
+    size_t  size, used;         /*Number of bytes for data in the chunk and in use*/
+    double  data[1];            /*Start of the data*/
+} VectorChunk;
+
+typedef struct{
+    VectorChunk* top;           /*Last allocated chunk, NULL for an empty arena*/
+} VectorArena;
+
 typedef struct{
     long    n, alloc_n;
     double* data;
+    VectorArena* arena;         /*Arena the data is allocated from, NULL for mxMalloc*/
 } Vector;
 
 Vector VectorPtrInit(long N, double* Data);          /*Initialise vector*/
@@ -27,6 +38,30 @@ void VectorDisplay(Vector V);                        /*Display vector*/
 void VectorFree(Vector *V);                          /*Reset vector*/
 mxArray* Vector2mxArray(Vector V);                   /*Conversion to and from mxArray*/
 Vector mxArray2Vector(mxArray* A);
+void VectorReserve(Vector* V, long N);               /*Capacity hint*/
+Vector VectorInArena(VectorArena* A, long N);        /*Initialise vector in arena*/
+void* VectorArenaAlloc(VectorArena* A, size_t NBytes);
+void VectorArenaFree(VectorArena* A);                /*Release arena in one go*/
+
+/*-----------------Spiketrain datatype and operation functions----------------------*/
+#define SPIKETRAIN_TICK     1e-3    /*SGSR spiketimes in ms are integer microseconds*/
+
+typedef unsigned long long SpikeKey;
+
+typedef struct{
+    long    n;
+    double* t;          /*Spiketimes*/
+    long*   label;      /*Spiketrain each spike came from after a merge, or NULL*/
+    int     sorted;     /*Nonzero if the spiketimes are in ascending order*/
+    double  tick;       /*Integer time base, zero if the spiketimes aren't on a grid*/
+} SpikeTrain;
+
+SpikeTrain SpikeTrainInit(long N, const double* Data, double Tick); /*Initialise spiketrain*/
+SpikeTrain mxArray2SpikeTrain(const mxArray* A, double Tick);        /*Conversion from mxArray*/
+SpikeKey SpikeTrainKey(double x);                                   /*Sort key of a double*/
+void SpikeTrainSort(SpikeTrain* S);                                 /*Radix sort of spiketimes*/
+SpikeTrain SpikeTrainMerge(SpikeTrain* S, long K);                  /*Merge of K spiketrains*/
+void SpikeTrainFree(SpikeTrain* S);                                 /*Reset spiketrain*/
 
 /*----------------------------------------------------------------------------------*/
 long SeqSearch(double *Data, long n, double Scalar)
@@ -102,7 +137,7 @@ from which N elements are copied and stored into the newly created vector
 variable. For the creation of an empty vector variable use N = 0 and supply
 the NULL pointer.*/
 {
-    Vector V = {0, 0, NULL};
+    Vector V = {0, 0, NULL, NULL};
     
     if (N > 0)
     {
@@ -123,7 +158,7 @@ Vector VectorScalarInit(long N, double Scalar)
 and a scalar to which all elements are set. For the creation of an empty
 vector variable use N = 0.*/
 {
-    Vector V = {0, 0, NULL}; long i;
+    Vector V = {0, 0, NULL, NULL}; long i;
         
     if (N > 0)
     {
@@ -139,15 +174,11 @@ vector variable use N = 0.*/
 
 void VectorAddScalar(Vector* V, double Scalar)
 /*Appends a scalar to the end of a vector and augments the length of the vector
-by one. The supplied vector must already be initialised!*/
+by one. The supplied vector must already be initialised! The allocated memory
+grows geometrically, so appending N scalars one by one takes O(N) time.*/
 {
-    if (V->alloc_n == 0)
-        V->data = (double*)mxMalloc((V->alloc_n = ALLOC_BLOCKLENGTH)*sizeof(double));
-    else if (V->n == V->alloc_n)
-    {
-        V->data = mxRealloc(V->data, (V->alloc_n += ALLOC_BLOCKLENGTH)*sizeof(double));
-        if (V->data == NULL) mexErrMsgTxt("VectorAddScalar: Cannot allocate enough memory.");
-    }    
+    if (V->n == V->alloc_n)
+        VectorReserve(V, (V->alloc_n < ALLOC_BLOCKLENGTH) ? ALLOC_BLOCKLENGTH : 2*V->alloc_n);
     else if (V->n > V->alloc_n)    
         mexErrMsgTxt("VectorAddScalar: More number of elements in vector than allowed by memory allocation.");
     V->data[(V->n)++] = Scalar;
@@ -156,20 +187,12 @@ by one. The supplied vector must already be initialised!*/
 void VectorConcatenate(Vector* V1, const Vector V2)
 /*Concatenate two vectors. The supplied vectors must already be initialised!*/
 {
-    long orig_n = V1->n, nbytes;
+    long orig_n = V1->n;
     
     if (V2.n == 0) return; /*Adding the empty vector*/
-    if ((V1->n += V2.n) > V1->alloc_n)
-    {
-        V1->alloc_n = ((V1->n-1)/ALLOC_BLOCKLENGTH+1)*ALLOC_BLOCKLENGTH;
-        nbytes = V1->alloc_n*sizeof(double);
-        if (V1->data == NULL) V1->data = mxMalloc(nbytes);
-        else
-        {
-            V1->data = mxRealloc(V1->data, nbytes);
-            if (V1->data == NULL) mexErrMsgTxt("VectorConcatenate: Cannot allocate enough memory.");
-        }    
-    }
+    if (V1->n+V2.n > V1->alloc_n)
+        VectorReserve(V1, (V1->n+V2.n > 2*V1->alloc_n) ? V1->n+V2.n : 2*V1->alloc_n);
+    V1->n += V2.n;
     memcpy(V1->data+orig_n, V2.data, V2.n*sizeof(double));
 }
 
@@ -197,9 +220,108 @@ void VectorFree(Vector* V)
 with the vector variable.*/
 {
     V->n = 0; V->alloc_n = 0;
-    mxFree(V->data); V->data = NULL;
+    if (V->arena == NULL) mxFree(V->data); /*Memory from an arena is released with the arena*/
+    V->data = NULL;
+}
+
+#define VECTOR_ARENA_CHUNK  65536   /*Minimal number of bytes in a chunk of an arena*/
+
+void VectorReserve(Vector* V, long N)
+/*Make room for at least N elements in a vector without changing its contents, e.g.
+when the final number of elements is known or can be estimated beforehand. A vector
+in an arena takes its memory from that arena; the vector that was allocated last
+from an arena grows in place as long as the chunk has room.*/
+{
+    double* Data;
+    
+    if (N <= V->alloc_n){
+        return;
+    }
+    if (V->arena != NULL){
+        VectorChunk* C = V->arena->top;
+        size_t Extra = (N-V->alloc_n)*sizeof(double);
+        
+        if ((C != NULL) && (V->data != NULL) && (V->data+V->alloc_n == (double*)((char*)C->data+C->used)) &&
+                (C->size-C->used >= Extra)){
+            C->used += Extra;
+            V->alloc_n = N;
+            return;
+        }
+        Data = (double*)VectorArenaAlloc(V->arena, N*sizeof(double));
+        if (V->n > 0){
+            memcpy(Data, V->data, V->n*sizeof(double));
+        }
+    }
+    else if (V->data == NULL){
+        Data = (double*)mxMalloc(N*sizeof(double));
+    }
+    else{
+        Data = (double*)mxRealloc(V->data, N*sizeof(double));
+    }
+    if (Data == NULL){
+        mexErrMsgTxt("VectorReserve: Cannot allocate enough memory.");
+    }
+    V->data = Data;
+    V->alloc_n = N;
 }
 
+Vector VectorInArena(VectorArena* A, long N)
+/*Initialisation of an empty vector whose data is allocated from an arena, with room
+for N elements. Such a vector needs no VectorFree(): all its memory is released with
+the arena. Vector2mxArray() copies the data, so a vector in an arena can be returned
+to MATLAB as any other vector.*/
+{
+    Vector V = {0, 0, NULL, NULL};
+    
+    if (N < 0){
+        mexErrMsgTxt("VectorInArena: Number of elements in vector cannot be negative.");
+    }
+    V.arena = A;
+    VectorReserve(&V, N);
+    return V;
+}
+
+void* VectorArenaAlloc(VectorArena* A, size_t NBytes)
+/*Allocate NBytes of memory, aligned for doubles, from an arena. An arena is a list
+of chunks of which only the last one is used for allocation; a new chunk is at
+least twice as large as the previous one. An empty arena is initialised as
+VectorArena A = {NULL}.*/
+{
+    VectorChunk* C = A->top;
+    void* P;
+    
+    NBytes = (NBytes+sizeof(double)-1)/sizeof(double)*sizeof(double);
+    if ((C == NULL) || (C->size-C->used < NBytes)){
+        size_t Size = (C == NULL) ? VECTOR_ARENA_CHUNK : 2*C->size;
+        
+        if (Size < NBytes){
+            Size = NBytes;
+        }
+        C = (VectorChunk*)mxMalloc(sizeof(VectorChunk)+Size);
+        if (C == NULL){
+            mexErrMsgTxt("VectorArenaAlloc: Cannot allocate enough memory.");
+        }
+        C->prev = A->top; C->size = Size; C->used = 0;
+        A->top = C;
+    }
+    P = (char*)C->data+C->used;
+    C->used += NBytes;
+    return P;
+}
+
+void VectorArenaFree(VectorArena* A)
+/*Release all memory allocated from an arena in one go. The vectors in the arena
+must not be used anymore, the arena itself can be used again.*/
+{
+    while (A->top != NULL){
+        VectorChunk* C = A->top;
+        A->top = C->prev;
+        mxFree(C);
+    }
+}
+
+#undef VECTOR_ARENA_CHUNK
+
 Vector mxArray2Vector(mxArray* A)
 /*Convert a MATLAB compatible numeric rowvector to a vector variable. The data
 is copied into the newly created rowvector.*/
@@ -222,6 +344,259 @@ of the vector is copied.*/
     return Var;
 }
 
+/*----------------------------------------------------------------------------------*/
+#define SPIKETRAIN_RADIXBITS    8
+#define SPIKETRAIN_MINRADIX     64
+
+SpikeTrain SpikeTrainInit(long N, const double* Data, double Tick)
+/*Initialisation of a spiketrain by copying N spiketimes from a double array. Whether
+the spiketimes are in ascending order is checked once and recorded, so that sorted
+spiketrains are never sorted again. Tick is the integer time base of the spiketimes,
+e.g. SPIKETRAIN_TICK, or zero if there is none.*/
+{
+    SpikeTrain S = {0, NULL, NULL, 1, 0.0};
+    long i;
+
+    if (N < 0){
+        mexErrMsgTxt("SpikeTrainInit: Number of spikes cannot be negative.");
+    }
+    S.tick = (Tick > 0.0) ? Tick : 0.0;
+    if (N > 0){
+        S.n = N;
+        S.t = (double*)mxMalloc(N*sizeof(double));
+        memcpy(S.t, Data, N*sizeof(double));
+        for (i = 1; (i < N) && S.sorted; i++){
+            S.sorted = (S.t[i-1] <= S.t[i]);
+        }
+    }
+    return S;
+}
+
+SpikeTrain mxArray2SpikeTrain(const mxArray* A, double Tick)
+/*Convert a MATLAB compatible numeric row- or columnvector to a spiketrain. The data
+is copied.*/
+{
+    SpikeTrain S;
+
+    if (mxIsEmpty(A)){
+        S = SpikeTrainInit(0, NULL, Tick);
+    }
+    else if (!mxIsNumeric(A) || ((mxGetM(A) != 1) && (mxGetN(A) != 1))){
+        mexErrMsgTxt("mxArray2SpikeTrain: Spiketrains must be given as numerical vectors.");
+    }
+    else{
+        S = SpikeTrainInit(mxGetNumberOfElements(A), mxGetPr(A), Tick);
+    }
+    return S;
+}
+
+SpikeKey SpikeTrainKey(double x)
+/*Map a double onto an unsigned integer with the same order: the sign bit is flipped
+for positive numbers and all bits are flipped for negative numbers.*/
+{
+    SpikeKey u;
+
+    memcpy(&u, &x, sizeof(SpikeKey));
+    return (u >> 63) ? ~u : (u | ((SpikeKey)1 << 63));
+}
+
+void SpikeTrainSort(SpikeTrain* S)
+/*Sort the spiketimes in ascending order, the labels, if any, along with them. Nothing
+is done for a spiketrain that is already sorted. The sort is a stable LSD radix sort,
+on the tick counts if all spiketimes are on the grid of the integer time base and on
+the bits of the doubles otherwise (the time base is then reset to zero). Only the
+digits in which the keys differ take a pass, so integer microseconds take three or
+four passes at most. Short spiketrains are sorted by insertion.*/
+{
+    SpikeKey *Key, *KeyTmp, *KeySwap, KeyOr = 0, KeyAnd = ~(SpikeKey)0;
+    double *T, *TTmp, *TSwap, KMin;
+    long *L, *LTmp = NULL, *LSwap, Count[1 << SPIKETRAIN_RADIXBITS];
+    long i, j, n = S->n;
+    int Shift, d;
+
+    if (S->sorted || (n < 2)){
+        S->sorted = 1;
+        return;
+    }
+    if (n < SPIKETRAIN_MINRADIX){
+        for (i = 1; i < n; i++){
+            double t = S->t[i];
+            long l = (S->label != NULL) ? S->label[i] : 0;
+            for (j = i; (j > 0) && (S->t[j-1] > t); j--){
+                S->t[j] = S->t[j-1];
+                if (S->label != NULL){
+                    S->label[j] = S->label[j-1];
+                }
+            }
+            S->t[j] = t;
+            if (S->label != NULL){
+                S->label[j] = l;
+            }
+        }
+        S->sorted = 1;
+        return;
+    }
+
+    /*Integer keys, relative to the earliest spike on the grid of the time base*/
+    Key = (SpikeKey*)mxMalloc(n*sizeof(SpikeKey));
+    if (S->tick > 0.0){
+        double PerTick = 1.0/S->tick;
+        for (i = 0, KMin = floor(S->t[0]*PerTick+0.5); i < n; i++){
+            double k = floor(S->t[i]*PerTick+0.5);
+            if (fabs(S->t[i]-k*S->tick) > 1e-6*S->tick){
+                S->tick = 0.0; /*Spiketime off the grid*/
+                break;
+            }
+            KMin = (k < KMin) ? k : KMin;
+            Key[i] = (SpikeKey)(long long)k;
+        }
+        for (i = 0; (i < n) && (S->tick > 0.0); i++){
+            Key[i] -= (SpikeKey)(long long)KMin;
+        }
+    }
+    if (S->tick <= 0.0){
+        for (i = 0; i < n; i++){
+            Key[i] = SpikeTrainKey(S->t[i]);
+        }
+    }
+    for (i = 0; i < n; i++){
+        KeyOr |= Key[i];
+        KeyAnd &= Key[i];
+    }
+
+    KeyTmp = (SpikeKey*)mxMalloc(n*sizeof(SpikeKey));
+    T = S->t;
+    TTmp = (double*)mxMalloc(n*sizeof(double));
+    L = S->label;
+    if (L != NULL){
+        LTmp = (long*)mxMalloc(n*sizeof(long));
+    }
+    for (Shift = 0; Shift < 64; Shift += SPIKETRAIN_RADIXBITS){
+        SpikeKey Mask = ((SpikeKey)1 << SPIKETRAIN_RADIXBITS)-1;
+
+        if ((((KeyOr ^ KeyAnd) >> Shift) & Mask) == 0){
+            continue; /*All keys have the same digit*/
+        }
+        for (d = 0; d < (1 << SPIKETRAIN_RADIXBITS); d++){
+            Count[d] = 0;
+        }
+        for (i = 0; i < n; i++){
+            Count[(Key[i] >> Shift) & Mask]++;
+        }
+        for (d = 0, j = 0; d < (1 << SPIKETRAIN_RADIXBITS); d++){
+            long c = Count[d];
+            Count[d] = j;
+            j += c;
+        }
+        for (i = 0; i < n; i++){
+            j = Count[(Key[i] >> Shift) & Mask]++;
+            KeyTmp[j] = Key[i];
+            TTmp[j] = T[i];
+            if (L != NULL){
+                LTmp[j] = L[i];
+            }
+        }
+        KeySwap = Key; Key = KeyTmp; KeyTmp = KeySwap;
+        TSwap = T; T = TTmp; TTmp = TSwap;
+        LSwap = L; L = LTmp; LTmp = LSwap;
+    }
+
+    S->t = T;
+    S->label = L;
+    S->sorted = 1;
+    mxFree(TTmp);
+    if (LTmp != NULL){
+        mxFree(LTmp);
+    }
+    mxFree(KeyTmp);
+    mxFree(Key);
+}
+
+SpikeTrain SpikeTrainMerge(SpikeTrain* S, long K)
+/*Merge K spiketrains into one sorted spiketrain, in which the label of every spike is
+the index of the spiketrain it came from. Spiketrains that aren't sorted are sorted
+first. The spiketrains are kept in a heap ordered by their next spike, so that every
+spike takes log(K) comparisons instead of a sort of the concatenated spiketrains.
+Equal spiketimes are ordered by spiketrain. The merged spiketrain keeps the integer
+time base if all spiketrains share it.*/
+{
+    SpikeTrain M;
+    long *Heap, *Next, NHeap = 0, N = 0, i, k;
+
+    for (i = 0; i < K; i++){
+        SpikeTrainSort(S+i);
+        N += S[i].n;
+    }
+    M = SpikeTrainInit(0, NULL, (K > 0) ? S[0].tick : 0.0);
+    for (i = 1; i < K; i++){
+        if (S[i].tick != M.tick){
+            M.tick = 0.0;
+        }
+    }
+    if (N == 0){
+        return M;
+    }
+    M.n = N;
+    M.t = (double*)mxMalloc(N*sizeof(double));
+    M.label = (long*)mxMalloc(N*sizeof(long));
+    Heap = (long*)mxMalloc(K*sizeof(long));
+    Next = (long*)mxCalloc(K, sizeof(long));
+
+    /*Heap[0] is the spiketrain whose next spike comes first, a spiketrain leaves
+    the heap once all its spikes are merged*/
+#define HEAD(r)         (S[r].t[Next[r]])
+#define BEFORE(r, s)    ((HEAD(r) < HEAD(s)) || ((HEAD(r) == HEAD(s)) && ((r) < (s))))
+    for (i = 0; i < K; i++){
+        if (S[i].n > 0){
+            long c = NHeap++;
+            while ((c > 0) && BEFORE(i, Heap[(c-1)/2])){
+                Heap[c] = Heap[(c-1)/2];
+                c = (c-1)/2;
+            }
+            Heap[c] = i;
+        }
+    }
+    for (k = 0; k < N; k++){
+        long r = Heap[0], c = 0;
+
+        M.t[k] = HEAD(r);
+        M.label[k] = r;
+        if (++Next[r] == S[r].n){
+            r = Heap[--NHeap];
+        }
+        while (2*c+1 < NHeap){ /*Sift r down from the root*/
+            long Child = 2*c+1;
+            if ((Child+1 < NHeap) && BEFORE(Heap[Child+1], Heap[Child])){
+                Child++;
+            }
+            if (!BEFORE(Heap[Child], r)){
+                break;
+            }
+            Heap[c] = Heap[Child];
+            c = Child;
+        }
+        Heap[c] = r;
+    }
+#undef BEFORE
+#undef HEAD
+
+    mxFree(Next);
+    mxFree(Heap);
+    return M;
+}
+
+void SpikeTrainFree(SpikeTrain* S)
+/*Reset the spiketrain to an empty spiketrain and free all dynamic memory associated
+with it.*/
+{
+    mxFree(S->t); S->t = NULL;
+    mxFree(S->label); S->label = NULL;
+    S->n = 0; S->sorted = 1;
+}
+
+#undef SPIKETRAIN_RADIXBITS
+#undef SPIKETRAIN_MINRADIX
+
 /*----------------------------------------------------------------------------------*/
 
 #undef ALLOC_BLOCKLENGTH
@@ -19,22 +19,22 @@ typedef struct{
     double *Ampl;
 } MdlStat;
 
-MdlStat InitMdlStat(MdlParam P, Vector* SpkIn);
+MdlStat InitMdlStat(MdlParam P, SpikeTrain* SpkIn);
 void FreeMdlStat(MdlStat S);
 void DispMdlStat(MdlStat S);
-Vector SNModel(MdlParam P, Vector* SpkIn);          /*Actual shot-noise coincidence model*/
+Vector SNModel(MdlParam P, SpikeTrain* SpkIn);      /*Actual shot-noise coincidence model*/
 
 /*------------------------------------MEX---------------------------------------*/
 double*  GetRowVectorField(mxArray *S, char* FieldName, long N);
 double   GetScalarField(mxArray *S, char* FieldName);
 MdlParam GetMdlParam(mxArray* S);
-Vector*  GetSpkIn(mxArray* Args[], long N);
+SpikeTrain* GetSpkIn(mxArray* Args[], long N);
 
 /*-------------------------------MEX Interface----------------------------------*/
 void mexFunction(int nlhs,       mxArray *plhs[], 
                  int nrhs, const mxArray *prhs[])
 {
-    MdlParam P; Vector* SpkIn; Vector SpkOut = {0, 0, NULL};
+    MdlParam P; SpikeTrain* SpkIn; Vector SpkOut = {0, 0, NULL};
 
     /*Check input arguments and retrieve model parameters*/
     if (nrhs == 0) mexErrMsgTxt("Wrong number of input arguments.");
@@ -61,7 +61,7 @@ void mexFunction(int nlhs,       mxArray *plhs[],
         nlhs = 1; plhs[0] = Vector2mxArray(SpkOut);
 
         /*Free dynamic memory*/
-        for (i = 0; i < P.Ninputs; i++) VectorFree(SpkIn+i); mxFree(SpkIn);
+        for (i = 0; i < P.Ninputs; i++) SpikeTrainFree(SpkIn+i); mxFree(SpkIn);
         VectorFree(&SpkOut);
     }    
 }
@@ -118,18 +118,18 @@ MdlParam GetMdlParam(mxArray* S)
     return P;
 }    
 
-Vector* GetSpkIn(mxArray* Args[], long N)
+SpikeTrain* GetSpkIn(mxArray* Args[], long N)
 {
-    Vector* SpkIn; long i, j;
+    SpikeTrain* SpkIn; long i, j;
     
-    SpkIn = (Vector*)mxMalloc(N*sizeof(Vector));
+    SpkIn = (SpikeTrain*)mxMalloc(N*sizeof(SpikeTrain));
     for (i = 0; i < N; i++)
     {
-        if (mxIsEmpty(Args[i])) SpkIn[i] = VectorPtrInit(0, NULL);
-        else if (mxIsNumeric(Args[i]) && (mxGetM(Args[i]) == 1)) SpkIn[i] = VectorPtrInit(mxGetN(Args[i]), mxGetPr(Args[i])); 
+        if (mxIsEmpty(Args[i])) SpkIn[i] = SpikeTrainInit(0, NULL, SPIKETRAIN_TICK);
+        else if (mxIsNumeric(Args[i]) && (mxGetM(Args[i]) == 1)) SpkIn[i] = SpikeTrainInit(mxGetN(Args[i]), mxGetPr(Args[i]), SPIKETRAIN_TICK); 
         else
         {
-            for (j = 0; j < i; j++) VectorFree(SpkIn+j); mxFree(SpkIn);
+            for (j = 0; j < i; j++) SpikeTrainFree(SpkIn+j); mxFree(SpkIn);
             mexErrMsgTxt("Spiketrains must be given as numerical rowvectors.");
         }
     }
@@ -139,26 +139,22 @@ Vector* GetSpkIn(mxArray* Args[], long N)
 #undef ERRMSG_MAXLENGTH
 
 /*-------------------------------------------------------------------------------*/
-MdlStat InitMdlStat(MdlParam P, Vector* SpkIn)
+MdlStat InitMdlStat(MdlParam P, SpikeTrain* SpkIn)
 {
     MdlStat S;
-    Vector SpkTmp = {0, 0, NULL};
-    long i, n;
+    SpikeTrain SpkTmp;
+    long i;
     
-    /*Concatenating all input spiketrains*/
-    for (i = 0; i < P.Ninputs; i++) VectorConcatenate(&SpkTmp, SpkIn[i]);
-    S.Nspk = SpkTmp.n; S.Spks = SpkTmp.data;
+    /*Merging all input spiketrains, the label of a spike is the input it came from*/
+    SpkTmp = SpikeTrainMerge(SpkIn, P.Ninputs);
+    S.Nspk = SpkTmp.n; S.Spks = SpkTmp.t;
     S.Vmem = (double*)mxMalloc(S.Nspk*sizeof(double));
     for (i = 0; i < S.Nspk; i++) S.Vmem[i] = 0.0;
-    S.Ampl = (double*)mxMalloc(S.Nspk*sizeof(double));
-    for (i = n = 0; i < P.Ninputs; n += SpkIn[i].n, i++)
-    { 
-        long j;
-        for (j = 0; j < SpkIn[i].n; j++) S.Ampl[n+j] = P.Ainputs[i];
-    }
     
-    /*Sorting concatenated spikes and their associated amplitudes*/
-    QuickSort(S.Spks, 0, S.Nspk-1, S.Ampl);
+    /*Amplitudes associated with the merged spikes*/
+    S.Ampl = (double*)mxMalloc(S.Nspk*sizeof(double));
+    for (i = 0; i < S.Nspk; i++) S.Ampl[i] = P.Ainputs[SpkTmp.label[i]];
+    mxFree(SpkTmp.label);
     
     return S;
 }
@@ -181,7 +177,7 @@ void DispMdlStat(MdlStat S)
     mexPrintf("\tAmplitude              : ["); for (i = 0; i < S.Nspk; i++) mexPrintf(" %.2f", S.Ampl[i]); mexPrintf(" ]\n");
 }
 
-Vector SNModel(MdlParam P, Vector* SpkIn)
+Vector SNModel(MdlParam P, SpikeTrain* SpkIn)
 {
     MdlStat S; Vector SpkOut = {0, 0, NULL};
     long i;